@@ -0,0 +1,275 @@
+// Host microbenchmark for the native x87 handlers, links against x87core.
+//
+//   x87bench [filter] [iterations]
+//
+// Every benchmark reloads its operands from a table of realistic values
+// before calling the handler, the "reload" row measures that overhead alone
+// and is always printed.
+
+#include "DoubleDouble.h"
+#include "FPRounding.h"
+#include "Profile.h"
+#include "Sample.h"
+#include "X87.h"
+#include "X87SoftFloat.h"
+#include "X87State.h"
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t kOperandCount = 4096;
+constexpr size_t kOperandMask = kOperandCount - 1;
+
+struct Operands {
+	std::vector<double> general;  // log-uniform magnitudes 1e-3 .. 1e6, random sign
+	std::vector<double> angle;    // [-2pi, 2pi]
+	std::vector<double> unit;     // [-1, 1]
+	std::vector<double> positive; // log-uniform 1e-3 .. 1e6
+	std::vector<int32_t> integer; // [-1e6, 1e6]
+	std::vector<X87Float80> wide; // general with all 64 mantissa bits set randomly
+
+	Operands() {
+		std::mt19937_64 rng(0x87);
+		std::uniform_real_distribution<double> exponent(-3.0, 6.0);
+		std::uniform_real_distribution<double> angleDist(-2 * M_PI, 2 * M_PI);
+		std::uniform_real_distribution<double> unitDist(-1.0, 1.0);
+		std::uniform_int_distribution<int32_t> integerDist(-1000000, 1000000);
+
+		for (size_t i = 0; i < kOperandCount; i++) {
+			const double magnitude = std::pow(10.0, exponent(rng));
+			general.push_back((rng() & 1) ? magnitude : -magnitude);
+			angle.push_back(angleDist(rng));
+			unit.push_back(unitDist(rng));
+			positive.push_back(std::pow(10.0, exponent(rng)));
+			integer.push_back(integerDist(rng));
+
+			int binaryExponent;
+			std::frexp(general.back(), &binaryExponent);
+			wide.push_back(X87Float80{.mantissa = rng() | 0x8000000000000000ULL,
+			                          .exponent = static_cast<uint16_t>((general.back() < 0 ? 0x8000 : 0) | (16382 + binaryExponent))});
+		}
+	}
+};
+
+uint64_t sink;
+
+auto consume(uint64_t value) -> void {
+	sink += value;
+}
+
+auto consume(X87ResultStatusWord value) -> void {
+	sink += value.result + value.statusWord;
+}
+
+auto consume(X87Float80StatusWordResult value) -> void {
+	sink += value.mantissa + value.exponent + value.statusWord;
+}
+
+// Fills all eight registers so that tags are valid and pops never underflow.
+auto freshState(X87State &state) -> void {
+	state = X87State();
+	for (int i = 0; i < 8; i++) {
+		state.push();
+		state.setSt(0, 1.0 + i);
+	}
+}
+
+struct Runner {
+	const char *filter;
+	size_t iterations;
+
+	template <typename Body>
+	auto run(const char *name, Body body, bool always = false) -> void {
+		if (!always && filter != nullptr && std::strstr(name, filter) == nullptr) {
+			return;
+		}
+
+		X87State state;
+		freshState(state);
+
+		// warm up caches and branch predictors
+		for (size_t i = 0; i < iterations / 16; i++) {
+			body(state, i & kOperandMask);
+		}
+
+		freshState(state);
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			body(state, i & kOperandMask);
+		}
+		const auto end = std::chrono::steady_clock::now();
+
+		const double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+		std::printf("%-20s %8.2f ns/op\n", name, ns);
+	}
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	Runner runner{argc > 1 && std::strcmp(argv[1], "all") != 0 ? argv[1] : nullptr, argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000};
+	const Operands ops;
+
+	const auto load1 = [](X87State &state, double a) { state.setStFast(0, a); };
+	const auto load2 = [](X87State &state, double a, double b) {
+		state.setStFast(0, a);
+		state.setStFast(1, b);
+	};
+
+	// baseline: the operand reload most benchmarks below pay for
+	runner.run("reload", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); consume(std::bit_cast<uint64_t>(s.getStFast(0))); }, true);
+
+	// arithmetic, ST(i) forms
+	runner.run("fadd_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fadd_ST_fast(&s, 0, 1, false); });
+	runner.run("faddp_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fadd_ST_fast(&s, 1, 0, true); s.push(); });
+	// the offsets of the other rows repeat and are learned by the branch
+	// predictor, these are random like the mix of call sites a program has
+	runner.run("fadd_ST_random", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fadd_ST_fast(&s, 0, 1 + (ops.integer[i] & 3), false); });
+	runner.run("fsub_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fsub_ST_fast(&s, 0, 1, false); });
+	runner.run("fsubr_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fsubr_ST_fast(&s, 0, 1, false); });
+	runner.run("fmul_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fmul_ST_fast(&s, 0, 1, false); });
+	runner.run("fdiv_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fdiv_ST_fast(&s, 0, 1, false); });
+	runner.run("fdivr_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fdivr_ST_fast(&s, 0, 1, false); });
+
+	// arithmetic, memory operand forms
+	runner.run("fadd_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fadd_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1]))); });
+	runner.run("fadd_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fadd_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fsub_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fsub_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1]))); });
+	runner.run("fsub_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fsub_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fsubr_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fsubr_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1]))); });
+	runner.run("fsubr_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fsubr_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fmul_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fmul_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1]))); });
+	runner.run("fmul_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fmul_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fdiv_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fdiv_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1]))); });
+	runner.run("fdiv_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fdiv_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fdivr_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fdivr_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1]))); });
+	runner.run("fdivr_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fdivr_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fiadd", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fiadd_fast(&s, ops.integer[i]); });
+	runner.run("fisub", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fisub_fast(&s, ops.integer[i]); });
+	runner.run("fisubr", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fisubr_fast(&s, ops.integer[i]); });
+	runner.run("fimul", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fimul_fast(&s, ops.integer[i]); });
+	runner.run("fidiv", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fidiv_fast(&s, ops.integer[i] | 1); });
+	runner.run("fidivr", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fidivr_fast(&s, ops.integer[i]); });
+
+	// unary
+	runner.run("fabs", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fabs_fast(&s); });
+	runner.run("fchs", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fchs_fast(&s); });
+	runner.run("fsqrt", [&](X87State &s, size_t i) { load1(s, ops.positive[i]); x87_fsqrt_fast(&s); });
+	runner.run("frndint", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_frndint_fast(&s); });
+	runner.run("fscale", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.integer[i] % 64); x87_fscale_fast(&s); });
+	runner.run("fxtract", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fxtract_fast(&s); s.pop(); });
+	runner.run("fxam", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fxam_fast(&s); });
+	runner.run("fprem", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.positive[i]); x87_fprem_fast(&s); });
+	runner.run("fprem1", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.positive[i]); x87_fprem1_fast(&s); });
+
+	// transcendental
+	runner.run("fsin", [&](X87State &s, size_t i) { load1(s, ops.angle[i]); x87_fsin_fast(&s); });
+	runner.run("fcos", [&](X87State &s, size_t i) { load1(s, ops.angle[i]); x87_fcos_fast(&s); });
+	runner.run("fsincos", [&](X87State &s, size_t i) { load1(s, ops.angle[i]); x87_fsincos_fast(&s); s.pop(); });
+	runner.run("fptan", [&](X87State &s, size_t i) { load1(s, ops.angle[i]); x87_fptan_fast(&s); s.pop(); });
+	runner.run("fpatan", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fpatan_fast(&s); s.push(); });
+	runner.run("f2xm1", [&](X87State &s, size_t i) { load1(s, ops.unit[i]); x87_f2xm1_fast(&s); });
+	runner.run("fyl2x", [&](X87State &s, size_t i) { load2(s, ops.positive[i], ops.general[i]); x87_fyl2x_fast(&s); s.push(); });
+	runner.run("fyl2xp1", [&](X87State &s, size_t i) { load2(s, ops.unit[i] * 0.29, ops.general[i]); x87_fyl2xp1_fast(&s); s.push(); });
+
+	// 24 bit precision control, as set by Direct3D 9 without D3DCREATE_FPU_PRESERVE
+	const auto pc24 = [](X87State &state) { state.controlWord = 0x007F; };
+	runner.run("fadd_f64_pc24", [&](X87State &s, size_t i) { pc24(s); load1(s, ops.general[i]); x87_fadd_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fmul_ST_pc24", [&](X87State &s, size_t i) { pc24(s); load2(s, ops.general[i], ops.general[i ^ 1]); x87_fmul_ST_fast(&s, 0, 1, false); });
+	runner.run("fdiv_f64_pc24", [&](X87State &s, size_t i) { pc24(s); load1(s, ops.general[i]); x87_fdiv_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fsqrt_pc24", [&](X87State &s, size_t i) { pc24(s); load1(s, ops.positive[i]); x87_fsqrt_fast(&s); });
+	runner.run("fsincos_pc24", [&](X87State &s, size_t i) { pc24(s); load1(s, ops.angle[i]); x87_fsincos_fast(&s); s.pop(); });
+	runner.run("f2xm1_pc24", [&](X87State &s, size_t i) { pc24(s); load1(s, ops.unit[i]); x87_f2xm1_fast(&s); });
+	runner.run("fyl2x_pc24", [&](X87State &s, size_t i) { pc24(s); load2(s, ops.positive[i], ops.general[i]); x87_fyl2x_fast(&s); s.push(); });
+	runner.run("fyl2xp1_pc24", [&](X87State &s, size_t i) { pc24(s); load2(s, ops.unit[i] * 0.29, ops.general[i]); x87_fyl2xp1_fast(&s); s.push(); });
+
+#if defined(X87_IEEE_EXCEPTIONS)
+	// handlers as dispatched with exception flags, FPSR save, clear and merge
+	runner.run("fadd_f64_exceptions", [&](X87State &s, size_t i) { load1(s, ops.general[i]); fpExceptionHandler<X87HandlerId::x87_fadd_f64, &x87_fadd_f64_fast>()(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fdiv_f64_exceptions", [&](X87State &s, size_t i) { load1(s, ops.general[i]); fpExceptionHandler<X87HandlerId::x87_fdiv_f64, &x87_fdiv_f64_fast>()(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fsqrt_exceptions", [&](X87State &s, size_t i) { load1(s, ops.positive[i]); fpExceptionHandler<X87HandlerId::x87_fsqrt, &x87_fsqrt_fast>()(&s); });
+	runner.run("fsin_exceptions", [&](X87State &s, size_t i) { load1(s, ops.angle[i]); fpExceptionHandler<X87HandlerId::x87_fsin, &x87_fsin_fast>()(&s); });
+#endif
+
+#if defined(X87_SAMPLE)
+	// handlers as dispatched while sampling, the countdown on every call and
+	// the timed call every kSamplePeriod calls
+	runner.run("fadd_f64_sampled", [&](X87State &s, size_t i) { load1(s, ops.general[i]); SampleHandler<X87HandlerId::x87_fadd_f64, &x87_fadd_f64_fast>::call(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+#endif
+
+#if defined(X87_ROUNDING_CONTROL)
+	// handlers as dispatched with rounding control, rounding to nearest only
+	// reads the FPCR, the directed modes set it around the call
+	const auto roundDown = [](X87State &state) { state.controlWord = 0x077F; };
+	runner.run("fadd_f64_rc", [&](X87State &s, size_t i) { load1(s, ops.general[i]); fpRoundingHandler<X87HandlerId::x87_fadd_f64, &x87_fadd_f64_fast>()(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("fadd_f64_rc_down", [&](X87State &s, size_t i) { roundDown(s); load1(s, ops.general[i]); fpRoundingHandler<X87HandlerId::x87_fadd_f64, &x87_fadd_f64_fast>()(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1])); });
+	runner.run("frndint_rc_down", [&](X87State &s, size_t i) { roundDown(s); load1(s, ops.general[i]); fpRoundingHandler<X87HandlerId::x87_frndint, &x87_frndint_fast>()(&s); });
+	runner.run("fist_i32_rc_down", [&](X87State &s, size_t i) { roundDown(s); load1(s, ops.general[i]); consume(fpRoundingHandler<X87HandlerId::x87_fist_i32, &x87_fist_i32_fast>()(&s)); });
+#endif
+
+	// the 80 bit engine behind the exact handlers and their double-double
+	// division and square root, on full width operands
+	const auto soft = [](X87Float80 value) { consume(value.mantissa + value.exponent); };
+	uint16_t softStatus = 0;
+	runner.run("soft80_add", [&](X87State &s, size_t i) { soft(softFloat80Add(ops.wide[i], ops.wide[i ^ 1], s.controlWord, &softStatus)); });
+	runner.run("soft80_sub", [&](X87State &s, size_t i) { soft(softFloat80Sub(ops.wide[i], ops.wide[i ^ 1], s.controlWord, &softStatus)); });
+	runner.run("soft80_mul", [&](X87State &s, size_t i) { soft(softFloat80Mul(ops.wide[i], ops.wide[i ^ 1], s.controlWord, &softStatus)); });
+	runner.run("soft80_div", [&](X87State &s, size_t i) { soft(softFloat80Div(ops.wide[i], ops.wide[i ^ 1], s.controlWord, &softStatus)); });
+	runner.run("soft80_sqrt", [&](X87State &s, size_t i) { soft(softFloat80Sqrt(X87Float80{.mantissa = ops.wide[i].mantissa, .exponent = static_cast<uint16_t>(ops.wide[i].exponent & 0x7FFF)}, s.controlWord, &softStatus)); });
+	runner.run("dd80_div", [&](X87State &s, size_t i) { soft(doubleDouble80Div(ops.wide[i], ops.wide[i ^ 1], s.controlWord, &softStatus)); });
+	runner.run("dd80_sqrt", [&](X87State &s, size_t i) { soft(doubleDouble80Sqrt(X87Float80{.mantissa = ops.wide[i].mantissa, .exponent = static_cast<uint16_t>(ops.wide[i].exponent & 0x7FFF)}, s.controlWord, &softStatus)); });
+	runner.run("soft80_compare", [&](X87State &, size_t i) { consume(static_cast<uint64_t>(softFloat80Compare(ops.wide[i], ops.wide[i ^ 1], false, &softStatus))); });
+	consume(softStatus);
+
+	// loads and stores
+	runner.run("fld_fp32", [&](X87State &s, size_t i) { x87_fld_fp32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i]))); });
+	runner.run("fld_fp64", [&](X87State &s, size_t i) { x87_fld_fp64_fast(&s, std::bit_cast<uint64_t>(ops.general[i])); });
+	runner.run("fld_fp80", [&](X87State &s, size_t i) { x87_fld_fp80_fast(&s, X87Float80{.mantissa = 0xC000000000000000ULL | (i << 20), .exponent = static_cast<uint16_t>(16383 + (i & 31))}); });
+	runner.run("fld_STi", [&](X87State &s, size_t i) { x87_fld_STi_fast(&s, 1 + (i & 3)); });
+	runner.run("fld_constant", [&](X87State &s, size_t i) { x87_fld_constant_fast(&s, static_cast<X87Constant>(i % 7)); });
+	runner.run("fild", [&](X87State &s, size_t i) { x87_fild_fast(&s, ops.integer[i]); });
+	runner.run("fbld", [&](X87State &s, size_t i) { x87_fbld_fast(&s, 0x0000001234567890ULL + i, 0); });
+	runner.run("fst_STi", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fst_STi_fast(&s, 1 + (i & 3), false); });
+	runner.run("fst_fp32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fst_fp32_fast(&s)); });
+	runner.run("fst_fp64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fst_fp64_fast(&s)); });
+	runner.run("fst_fp80", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fst_fp80_fast(&s)); });
+	runner.run("fbstp", [&](X87State &s, size_t i) { load1(s, ops.general[i]); auto bcd = x87_fbstp_fast(&s); consume(bcd.low ^ bcd.high); s.push(); });
+	runner.run("fist_i16", [&](X87State &s, size_t i) { load1(s, ops.unit[i] * 30000.0); consume(x87_fist_i16_fast(&s)); });
+	runner.run("fist_i32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fist_i32_fast(&s)); });
+	runner.run("fist_i64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fist_i64_fast(&s)); });
+	runner.run("fistt_i16", [&](X87State &s, size_t i) { load1(s, ops.unit[i] * 30000.0); consume(x87_fistt_i16_fast(&s)); });
+	runner.run("fistt_i32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fistt_i32_fast(&s)); });
+	runner.run("fistt_i64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); consume(x87_fistt_i64_fast(&s)); });
+
+	// compares
+	runner.run("fcom_ST", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fcom_ST_fast(&s, 1, 0); });
+	runner.run("fcom_f32", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fcom_f32_fast(&s, std::bit_cast<uint32_t>(static_cast<float>(ops.general[i ^ 1])), false); });
+	runner.run("fcom_f64", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_fcom_f64_fast(&s, std::bit_cast<uint64_t>(ops.general[i ^ 1]), false); });
+	runner.run("fcomi", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); consume(x87_fcomi_fast(&s, 1, false)); });
+	runner.run("fucom", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); x87_fucom_fast(&s, 1, 0); });
+	runner.run("fucomi", [&](X87State &s, size_t i) { load2(s, ops.general[i], ops.general[i ^ 1]); consume(x87_fucomi_fast(&s, 1, false)); });
+	runner.run("ficom", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_ficom_fast(&s, ops.integer[i], false); });
+
+	// stack manipulation
+	runner.run("fxch", [&](X87State &s, size_t i) { x87_fxch_fast(&s, 1 + (i & 3)); });
+	runner.run("fcmov", [&](X87State &s, size_t i) { x87_fcmov_fast(&s, i & 1, 1 + (i & 3)); });
+	runner.run("fdecstp", [&](X87State &s, size_t) { x87_fdecstp_fast(&s); });
+
+	// state transfer, as on signal delivery
+	X86FloatState64 floatState = {};
+	runner.run("state_to_x86", [&](X87State &s, size_t i) { load1(s, ops.general[i]); x87_state_to_x86_float_state(&s, &floatState); consume(floatState.stmm[0].value.mantissa); });
+	runner.run("state_from_x86", [&](X87State &s, size_t i) { floatState.stmm[i & 7].value.mantissa ^= i; x87_state_from_x86_float_state(&s, &floatState); });
+
+#if defined(X87_PROFILE)
+	profileReport();
+#endif
+
+	return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,321 @@
+// Replays handler traces recorded with ROSETTA_X87_TRACE on the host, links
+// against x87core.
+//
+//   x87replay <trace> [a] [b] [iterations]
+//
+// Every record is replayed on a state rebuilt from the record, once with
+// implementation a and once with b (default "trace" and "fast"). For every
+// handler in the trace the tool prints the number of calls, the time per call
+// of both implementations including the state rebuild, and how many results
+// or status words differ bit for bit, followed by the first difference of
+// each handler. The "trace" implementation is the result recorded in the
+// trace and has no timing. The "fast" implementation runs the native handlers
+// through the exception flag and rounding control wrappers the build enables,
+// like the dispatch slots. Builds with X87_CONVERT_TO_FP80 add the "exact"
+// implementation, the bit exact handlers of X87Exact.h and the fast ones for
+// handlers without an exact one. Registers captured in either format load into
+// either build, and results of void handlers in different formats are compared
+// as 80 bit values. Exits with 2 if any result differs.
+
+#include "FPRounding.h"
+#include "Trace.h"
+#include "X87.h"
+#include "X87Exact.h"
+#include "X87State.h"
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr size_t kHandlerCount = static_cast<size_t>(X87HandlerId::kCount);
+
+const char *const kHandlerNames[] = {
+#define X87_HANDLER_NAME(RETURN, NAME, ARGS) #NAME,
+	X87_HANDLER_LIST(X87_HANDLER_NAME)
+#undef X87_HANDLER_NAME
+};
+
+// Whether the result of a record is ST(0) rather than a returned value.
+constexpr bool kHandlerReturnsVoid[] = {
+#define X87_HANDLER_VOID(RETURN, NAME, ARGS) std::is_void_v<RETURN>,
+	X87_HANDLER_LIST(X87_HANDLER_VOID)
+#undef X87_HANDLER_VOID
+};
+
+// Rebuilds the state the handler saw from the record. Registers the record
+// does not hold are zero.
+auto loadState(X87State &state, const TraceRecord &record) -> void {
+	state = X87State();
+	state.controlWord = record.controlWord;
+	state.statusWord = record.statusWordIn;
+
+	const auto format = static_cast<TraceRegisterFormat>(record.registerFormat);
+	const auto [first, second] = traceStOffsets(static_cast<X87HandlerId>(record.handler), record.operands);
+	traceLoadRegister(&state, second, format, record.st[1], record.stExponent[1]);
+	traceLoadRegister(&state, first, format, record.st[0], record.stExponent[0]);
+	state.tagWord = record.tagWordIn;
+}
+
+// Calls the handler with the operands of the record and stores its result and
+// status word in output the same way the recorder does.
+template <typename Return, typename State, typename... Args>
+auto replayCall(Return (*handler)(State *, Args...), X87State &state, const TraceRecord &record, TraceRecord &output) -> void {
+	[[maybe_unused]] uint32_t slot = 0;
+	// braced initialization evaluates the operands left to right
+	std::tuple<Args...> args{traceLoadOperand<Args>(record.operands, slot)...};
+
+	if constexpr (std::is_void_v<Return>) {
+		std::apply([&](Args... unpacked) { handler(&state, unpacked...); }, args);
+		traceStoreResult(output, &state);
+	} else {
+		auto result = std::apply([&](Args... unpacked) { return handler(&state, unpacked...); }, args);
+		traceStoreResult(output, &state, result);
+	}
+	output.registerFormat = static_cast<uint8_t>(kTraceRegisterFormat);
+}
+
+using ReplayFunction = auto (*)(X87State &state, const TraceRecord &record, TraceRecord &output) -> void;
+
+template <auto kHandler>
+auto replay(X87State &state, const TraceRecord &record, TraceRecord &output) -> void {
+	replayCall(kHandler, state, record, output);
+}
+
+// Copies the recorded result.
+auto replayRecorded(X87State &, const TraceRecord &record, TraceRecord &output) -> void {
+	output.result = record.result;
+	output.resultExponent = record.resultExponent;
+	output.registerFormat = record.registerFormat;
+	output.statusWordOut = record.statusWordOut;
+}
+
+#if defined(X87_CONVERT_TO_FP80)
+// The exact replay of a handler, nullptr for handlers without an exact
+// implementation.
+template <X87HandlerId kId>
+struct ReplayExact {
+	static constexpr ReplayFunction function = nullptr;
+};
+
+#define X87_REPLAY_EXACT(RETURN, NAME, ARGS)                             \
+	template <>                                                      \
+	struct ReplayExact<X87HandlerId::NAME> {                         \
+		static constexpr ReplayFunction function = &replay<&NAME##_exact>; \
+	};
+X87_EXACT_HANDLER_LIST(X87_REPLAY_EXACT)
+#undef X87_REPLAY_EXACT
+#endif
+
+// Whether two outputs of the same handler hold the same result and status word.
+auto sameOutput(size_t id, const TraceRecord &a, const TraceRecord &b) -> bool {
+	if (a.statusWordOut != b.statusWordOut) {
+		return false;
+	}
+	if (!kHandlerReturnsVoid[id] || a.registerFormat == b.registerFormat) {
+		return a.result == b.result && a.resultExponent == b.resultExponent;
+	}
+	const auto resultA = traceRegisterFloat80(static_cast<TraceRegisterFormat>(a.registerFormat), a.result, a.resultExponent);
+	const auto resultB = traceRegisterFloat80(static_cast<TraceRegisterFormat>(b.registerFormat), b.result, b.resultExponent);
+	return resultA.mantissa == resultB.mantissa && resultA.exponent == resultB.exponent;
+}
+
+// Prints a register of a record, as sign, exponent and mantissa for 80 bit ones.
+auto formatRegister(char (&text)[32], TraceRegisterFormat format, uint64_t bits, uint16_t exponent) -> const char * {
+	if (format == TraceRegisterFormat::kFloat80) {
+		std::snprintf(text, sizeof(text), "0x%04x:%016llx", exponent, (unsigned long long)bits);
+	} else {
+		std::snprintf(text, sizeof(text), "%.17g", std::bit_cast<double>(bits));
+	}
+	return text;
+}
+
+struct Implementation {
+	const char *name;
+	ReplayFunction handlers[kHandlerCount];
+};
+
+const Implementation kImplementations[] = {
+	{"trace", {
+#define X87_REPLAY_RECORDED(RETURN, NAME, ARGS) &replayRecorded,
+		X87_HANDLER_LIST(X87_REPLAY_RECORDED)
+#undef X87_REPLAY_RECORDED
+	}},
+	{"fast", {
+#define X87_REPLAY_FAST(RETURN, NAME, ARGS) &replay<fpEnvironmentHandler<X87HandlerId::NAME, &NAME##_fast>()>,
+		X87_HANDLER_LIST(X87_REPLAY_FAST)
+#undef X87_REPLAY_FAST
+	}},
+#if defined(X87_CONVERT_TO_FP80)
+	{"exact", {
+#define X87_REPLAY_EXACT(RETURN, NAME, ARGS)                                                            \
+	ReplayExact<X87HandlerId::NAME>::function != nullptr ? ReplayExact<X87HandlerId::NAME>::function \
+	                                                     : &replay<fpEnvironmentHandler<X87HandlerId::NAME, &NAME##_fast>()>,
+		X87_HANDLER_LIST(X87_REPLAY_EXACT)
+#undef X87_REPLAY_EXACT
+	}},
+#endif
+};
+
+auto findImplementation(const char *name) -> const Implementation * {
+	for (const auto &implementation : kImplementations) {
+		if (std::strcmp(implementation.name, name) == 0) {
+			return &implementation;
+		}
+	}
+	return nullptr;
+}
+
+auto readTrace(const char *path, std::vector<TraceRecord> &records) -> bool {
+	auto file = std::fopen(path, "rb");
+	if (file == nullptr) {
+		std::fprintf(stderr, "Failed to open %s\n", path);
+		return false;
+	}
+
+	TraceHeader header;
+	const bool valid = std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.magic, "X87TRACE", 8) == 0 &&
+	                   header.version == kTraceVersion && header.recordSize == sizeof(TraceRecord);
+	if (!valid) {
+		std::fprintf(stderr, "%s is not a version %u trace\n", path, kTraceVersion);
+		std::fclose(file);
+		return false;
+	}
+	if (header.handlerCount != kHandlerCount) {
+		std::fprintf(stderr, "%s was recorded with %u handlers, this build has %zu\n", path, header.handlerCount, kHandlerCount);
+		std::fclose(file);
+		return false;
+	}
+
+	TraceRecord record;
+	while (std::fread(&record, sizeof(record), 1, file) == 1) {
+		if (record.handler < kHandlerCount) {
+			records.push_back(record);
+		}
+	}
+	std::fclose(file);
+	return true;
+}
+
+uint64_t sink;
+
+// Nanoseconds per call of one implementation over the records of one handler.
+auto timeHandler(ReplayFunction function, const std::vector<TraceRecord> &records, size_t iterations) -> double {
+	X87State state;
+	TraceRecord output = {};
+
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t iteration = 0; iteration < iterations; iteration++) {
+		for (const auto &record : records) {
+			loadState(state, record);
+			function(state, record, output);
+			sink += output.result;
+		}
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / (double)(iterations * records.size());
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		std::fprintf(stderr, "%s <trace> [a] [b] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	const auto a = findImplementation(argc > 2 ? argv[2] : "trace");
+	const auto b = findImplementation(argc > 3 ? argv[3] : "fast");
+	const size_t iterations = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 10;
+	if (a == nullptr || b == nullptr || iterations == 0) {
+		std::fprintf(stderr, "implementations:");
+		for (const auto &implementation : kImplementations) {
+			std::fprintf(stderr, " %s", implementation.name);
+		}
+		std::fprintf(stderr, "\n");
+		return 1;
+	}
+
+	std::vector<TraceRecord> records;
+	if (!readTrace(argv[1], records)) {
+		return 1;
+	}
+
+	// group the records by handler so every handler is timed in a tight loop
+	std::vector<TraceRecord> byHandler[kHandlerCount];
+	for (const auto &record : records) {
+		byHandler[record.handler].push_back(record);
+	}
+
+	std::printf("%zu records, %s vs %s\n", records.size(), a->name, b->name);
+	std::printf("%-20s %10s %10s %10s %10s\n", "handler", "calls", a->name, b->name, "differ");
+
+	struct Difference {
+		TraceRecord record;
+		TraceRecord a;
+		TraceRecord b;
+	};
+	std::vector<Difference> firstDifferences;
+	size_t totalDifferences = 0;
+
+	for (size_t id = 0; id < kHandlerCount; id++) {
+		const auto &handlerRecords = byHandler[id];
+		if (handlerRecords.empty()) {
+			continue;
+		}
+
+		size_t differences = 0;
+		for (const auto &record : handlerRecords) {
+			X87State state;
+			TraceRecord outputA = {};
+			TraceRecord outputB = {};
+
+			loadState(state, record);
+			a->handlers[id](state, record, outputA);
+			loadState(state, record);
+			b->handlers[id](state, record, outputB);
+
+			if (!sameOutput(id, outputA, outputB)) {
+				if (differences == 0) {
+					firstDifferences.push_back({record, outputA, outputB});
+				}
+				differences++;
+			}
+		}
+		totalDifferences += differences;
+
+		char timeA[16] = "-";
+		char timeB[16] = "-";
+		if (a->handlers[id] != &replayRecorded) {
+			std::snprintf(timeA, sizeof(timeA), "%.2f", timeHandler(a->handlers[id], handlerRecords, iterations));
+		}
+		if (b->handlers[id] != &replayRecorded) {
+			std::snprintf(timeB, sizeof(timeB), "%.2f", timeHandler(b->handlers[id], handlerRecords, iterations));
+		}
+
+		std::printf("%-20s %10zu %10s %10s %10zu\n", kHandlerNames[id], handlerRecords.size(), timeA, timeB, differences);
+	}
+
+	for (const auto &difference : firstDifferences) {
+		const auto &record = difference.record;
+		const auto format = static_cast<TraceRegisterFormat>(record.registerFormat);
+		char st0[32];
+		char st1[32];
+		std::printf("\n%s: operands 0x%llx 0x%llx 0x%llx st %s %s\n", kHandlerNames[record.handler], (unsigned long long)record.operands[0],
+		            (unsigned long long)record.operands[1], (unsigned long long)record.operands[2], formatRegister(st0, format, record.st[0], record.stExponent[0]),
+		            formatRegister(st1, format, record.st[1], record.stExponent[1]));
+		for (const auto &[name, output] : {std::pair{a->name, &difference.a}, std::pair{b->name, &difference.b}}) {
+			std::printf("  %-8s result 0x%04x:%016llx status 0x%04x\n", name, output->resultExponent, (unsigned long long)output->result, output->statusWordOut);
+		}
+	}
+
+	return totalDifferences == 0 ? 0 : 2;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Runtimes the loader knows the offsets of, kept with tools/known_runtimes.py.
+// An entry is used for a runtime of its size, any size for 0, whose
+// signatures lie at its offsets.
+//
+// X(size, exports fetch offset, svc call entry offset)
+#define ROSETTA_KNOWN_RUNTIMES(X) \
+	X(0x0, 0xFA8C, 0x1998) /* macOS 26.0, MD5 d7819a04355cd77ff24031800a985c13 */
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+// The few Mach-O structures the loader reads, laid out like those in
+// <mach-o/loader.h> so that the loader also builds and is tested on other
+// hosts. They live in their own namespace, and the constants are renamed, to
+// not clash with the system header where both are included.
+namespace macho {
+
+// MH_MAGIC_64 and LC_SEGMENT_64
+constexpr uint32_t kMagic64 = 0xFEEDFACF;
+constexpr uint32_t kLoadSegment64 = 0x19;
+
+// The runtime image is mapped into a process on arm64, which uses 16 KB pages.
+constexpr uint64_t kPageSize = 0x4000;
+
+struct mach_header_64 {
+	uint32_t magic;
+	int32_t cputype;
+	int32_t cpusubtype;
+	uint32_t filetype;
+	uint32_t ncmds;
+	uint32_t sizeofcmds;
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+struct load_command {
+	uint32_t cmd;
+	uint32_t cmdsize;
+};
+
+struct segment_command_64 {
+	uint32_t cmd;
+	uint32_t cmdsize;
+	char segname[16];
+	uint64_t vmaddr;
+	uint64_t vmsize;
+	uint64_t fileoff;
+	uint64_t filesize;
+	int32_t maxprot;
+	int32_t initprot;
+	uint32_t nsects;
+	uint32_t flags;
+};
+
+struct section_64 {
+	char sectname[16];
+	char segname[16];
+	uint64_t addr;
+	uint64_t size;
+	uint32_t offset;
+	uint32_t align;
+	uint32_t reloff;
+	uint32_t nreloc;
+	uint32_t flags;
+	uint32_t reserved1;
+	uint32_t reserved2;
+	uint32_t reserved3;
+};
+
+static_assert(sizeof(mach_header_64) == 32 && sizeof(segment_command_64) == 72 && sizeof(section_64) == 80, "Mach-O structures must match <mach-o/loader.h>");
+
+} // namespace macho
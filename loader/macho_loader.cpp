@@ -1,95 +1,143 @@
 #include "macho_loader.hpp"
 
-#include <fstream>
-#include <mach-o/loader.h>
-#include <mach/vm_page_size.h>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace macho;
+
+MachoLoader::~MachoLoader() {
+	close();
+}
 
 auto MachoLoader::open(std::filesystem::path const &path) -> bool {
-	if (!std::filesystem::exists(path)) {
+	close();
+
+	auto fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
 		return false;
 	}
 
-	auto file = std::ifstream(path, std::ios::binary);
+	// the mapping stays valid after closing the descriptor
+	auto mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
 
-	if (!file.is_open()) {
+	if (mapping == MAP_FAILED) {
 		return false;
 	}
 
-	buffer_ = std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	data_ = (uint8_t const *)mapping;
+	size_ = st.st_size;
+
+	if (!index()) {
+		close();
+		return false;
+	}
 
-	return buffer_.empty() == false;
+	return true;
 }
 
-auto MachoLoader::machHeader() const -> mach_header_64 * {
-	return (mach_header_64 *)buffer_.data();
+auto MachoLoader::close() -> void {
+	if (data_ != nullptr) {
+		munmap((void *)data_, size_);
+	}
+
+	data_ = nullptr;
+	size_ = 0;
+	imageSize_ = 0;
+	segments_.clear();
 }
 
-auto MachoLoader::imageSize() const -> size_t {
+// Walks the load commands once, checking that they and the segment contents
+// lie within the file, and remembers the segments.
+auto MachoLoader::index() -> bool {
+	if (size_ < sizeof(mach_header_64)) {
+		return false;
+	}
+
 	auto header = machHeader();
+	if (header->magic != kMagic64 || header->sizeofcmds > size_ - sizeof(mach_header_64)) {
+		return false;
+	}
 
-	size_t imageSize = 0;
+	auto cmd = (uint8_t const *)(header + 1);
+	auto end = cmd + header->sizeofcmds;
 
-	load_command *cmd = (load_command *)(header + 1);
+	for (uint32_t i = 0; i < header->ncmds; i++) {
+		auto command = (load_command const *)cmd;
+		if ((size_t)(end - cmd) < sizeof(load_command) || command->cmdsize < sizeof(load_command) || command->cmdsize > (size_t)(end - cmd)) {
+			return false;
+		}
 
-	for (auto i = 0; i < header->ncmds; i++) {
-		if (cmd->cmd == LC_SEGMENT_64) {
-			auto seg = (segment_command_64 *)cmd;
+		if (command->cmd == kLoadSegment64) {
+			auto seg = (segment_command_64 const *)command;
+
+			if (command->cmdsize < sizeof(segment_command_64) + (uint64_t)seg->nsects * sizeof(section_64)) {
+				return false;
+			}
+			if (seg->fileoff > size_ || seg->filesize > size_ - seg->fileoff) {
+				return false;
+			}
 
 			uint64_t segEnd = seg->vmaddr + seg->vmsize;
-			if (segEnd > imageSize) {
-				imageSize = segEnd;
+			if (segEnd > imageSize_) {
+				imageSize_ = segEnd;
 			}
+
+			segments_.push_back(seg);
 		}
 
-		cmd = (load_command *)((uint8_t *)cmd + cmd->cmdsize);
+		cmd += command->cmdsize;
 	}
 
-	imageSize = (imageSize + vm_page_size - 1) & ~(vm_page_size - 1);
-	return imageSize;
+	imageSize_ = (imageSize_ + kPageSize - 1) & ~(kPageSize - 1);
+	return true;
 }
 
-auto MachoLoader::getSection(const char *segment, const char *section) -> section_64 * {
-	auto header = machHeader();
-
-	load_command *cmd = (load_command *)(header + 1);
+auto MachoLoader::machHeader() const -> mach_header_64 const * {
+	return (mach_header_64 const *)data_;
+}
 
-	for (auto i = 0; i < header->ncmds; i++) {
-		if (cmd->cmd == LC_SEGMENT_64) {
-			auto seg = (segment_command_64 *)cmd;
+auto MachoLoader::imageSize() const -> size_t {
+	return imageSize_;
+}
 
-			if (strcmp(seg->segname, segment) == 0) {
-				section_64 *sect = (section_64 *)(seg + 1);
+auto MachoLoader::getSection(const char *segment, const char *section) const -> section_64 const * {
+	for (auto seg : segments_) {
+		if (strncmp(seg->segname, segment, sizeof(seg->segname)) != 0) {
+			continue;
+		}
 
-				for (auto j = 0; j < seg->nsects; j++) {
-					if (strcmp(sect->sectname, section) == 0) {
-						return sect;
-					}
+		auto sect = (section_64 const *)(seg + 1);
 
-					sect++;
-				}
+		for (uint32_t j = 0; j < seg->nsects; j++) {
+			if (strncmp(sect->sectname, section, sizeof(sect->sectname)) == 0) {
+				return sect;
 			}
-		}
 
-		cmd = (load_command *)((uint8_t *)cmd + cmd->cmdsize);
+			sect++;
+		}
 	}
 
 	return nullptr;
 }
 
-auto MachoLoader::forEachSegment(std::function<void(segment_command_64 *segm)> callback) -> void {
-	auto header = machHeader();
-
-	load_command *cmd = (load_command *)(header + 1);
-
-	for (auto i = 0; i < header->ncmds; i++) {
-		if (cmd->cmd == LC_SEGMENT_64) {
-			auto seg = (segment_command_64 *)cmd;
-
-			if (seg->nsects != 0) {
-				callback(seg);
-			}
+auto MachoLoader::forEachSegment(std::function<void(segment_command_64 const *segm)> callback) const -> void {
+	for (auto seg : segments_) {
+		if (seg->nsects != 0) {
+			callback(seg);
 		}
-
-		cmd = (load_command *)((uint8_t *)cmd + cmd->cmdsize);
 	}
 }
+
+auto MachoLoader::segmentData(segment_command_64 const *segm) const -> uint8_t const * {
+	return data_ + segm->fileoff;
+}
@@ -1,15 +1,34 @@
 #pragma once
 
 #include <filesystem>
-#include <mach-o/loader.h>
+#include <functional>
 #include <vector>
 
+#include "macho.hpp"
+
+// Read-only mapping of a Mach-O image. The load commands are indexed once in
+// open, the segments and sections point straight into the mapping.
 struct MachoLoader {
+	MachoLoader() = default;
+	MachoLoader(MachoLoader const &) = delete;
+	auto operator=(MachoLoader const &) -> MachoLoader & = delete;
+	~MachoLoader();
+
 	auto open(std::filesystem::path const &path) -> bool;
-	auto machHeader() const -> mach_header_64 *;
+	auto machHeader() const -> macho::mach_header_64 const *;
 	auto imageSize() const -> size_t;
-	auto getSection(const char *segment, const char *section) -> section_64 *;
-	auto forEachSegment(std::function<void(segment_command_64 *segm)>) -> void;
+	auto getSection(const char *segment, const char *section) const -> macho::section_64 const *;
+	auto forEachSegment(std::function<void(macho::segment_command_64 const *segm)>) const -> void;
+
+	// The file contents of a segment.
+	auto segmentData(macho::segment_command_64 const *segm) const -> uint8_t const *;
+
+private:
+	auto close() -> void;
+	auto index() -> bool;
 
-	std::vector<uint8_t> buffer_;
+	uint8_t const *data_ = nullptr;
+	size_t size_ = 0;
+	size_t imageSize_ = 0;
+	std::vector<macho::segment_command_64 const *> segments_;
 };
@@ -533,65 +533,90 @@ int main(int argc, char *argv[]) {
 
 	dbg.restoreThreadState(backupThreadState);
 
-	machoLoader.forEachSegment([&](segment_command_64 *segm) {
-		auto dest = machoBase + segm->vmaddr;
-		auto size = segm->vmsize;
-		auto src = machoLoader.buffer_.data() + segm->fileoff;
-
-		LOG("Copying segment %s from 0x%llx to 0x%llx (%zx bytes)\n", segm->segname, segm->fileoff, dest, (size_t)size);
-
-		dbg.writeMemory(dest, src, size);
-
-		dbg.adjustMemoryProtection(dest, segm->initprot, segm->vmsize);
+	// The image is linked at address 0. Every segment is copied, rebased and
+	// filled in locally first, so that it is written into the process once.
+	std::vector<std::pair<macho::segment_command_64 const *, std::vector<uint8_t>>> segments;
+	machoLoader.forEachSegment([&](macho::segment_command_64 const *segm) {
+		// zerofill sections (e.g. the profile counters) have no file contents,
+		// the anonymous mapping is already zeroed
+		auto src = machoLoader.segmentData(segm);
+		segments.emplace_back(segm, std::vector<uint8_t>(src, src + segm->filesize));
 	});
 
-	// fix up Exports segment of mapped macho
-	uint64_t machoExportsAddress = machoBase + machoLoader.getSection("__DATA", "exports")->addr;
-	Exports machoExports;
-
-	dbg.readMemory(machoExportsAddress, &machoExports, sizeof(machoExports));
-	machoExports.x87Exports += machoBase;
-	machoExports.runtimeExports += machoBase;
-
-	std::vector<Export> x87Exports(machoExports.x87ExportCount);
-	std::vector<Export> runtimeExports(machoExports.runtimeExportCount);
-
-	dbg.readMemory(machoExports.x87Exports, x87Exports.data(), x87Exports.size() * sizeof(Export));
-	dbg.readMemory(machoExports.runtimeExports, runtimeExports.data(), runtimeExports.size() * sizeof(Export));
+	// the local copy of the bytes at a linked address
+	auto imageData = [&](uint64_t address, size_t size) -> uint8_t * {
+		for (auto &[segm, data] : segments) {
+			if (address >= segm->vmaddr && address - segm->vmaddr + size <= data.size()) {
+				return data.data() + (address - segm->vmaddr);
+			}
+		}
+		fprintf(stderr, "Address 0x%llx (%zx bytes) has no file contents in the runtime image\n", address, size);
+		return nullptr;
+	};
 
-	for (auto &exp : x87Exports) {
-		exp.address += machoBase;
-		exp.name += machoBase;
+	// fix up Exports segment of mapped macho
+	auto exportsSection = machoLoader.getSection("__DATA", "exports");
+	auto machoExports = (Exports *)imageData(exportsSection->addr, sizeof(Exports));
+	if (machoExports == nullptr) {
+		return 1;
 	}
-
-	for (auto &exp : runtimeExports) {
-		exp.address += machoBase;
-		exp.name += machoBase;
+	auto x87Exports = (Export *)imageData(machoExports->x87Exports, machoExports->x87ExportCount * sizeof(Export));
+	auto runtimeExports = (Export *)imageData(machoExports->runtimeExports, machoExports->runtimeExportCount * sizeof(Export));
+	if (x87Exports == nullptr || runtimeExports == nullptr) {
+		return 1;
 	}
 
-	dbg.writeMemory(machoExports.x87Exports, x87Exports.data(), x87Exports.size() * sizeof(Export));
-	dbg.writeMemory(machoExports.runtimeExports, runtimeExports.data(), runtimeExports.size() * sizeof(Export));
+	// Rosetta's export tables are in the same order as ours. Entries we do not
+	// implement are left null in the image and get Rosetta's own address, so
+	// calls into them skip the runtime entirely.
+	std::vector<Export> rosettaX87Exports(exports.x87ExportCount);
+	std::vector<Export> rosettaRuntimeExports(exports.runtimeExportCount);
+
+	dbg.readMemory(exports.x87Exports, rosettaX87Exports.data(), rosettaX87Exports.size() * sizeof(Export));
+	dbg.readMemory(exports.runtimeExports, rosettaRuntimeExports.data(), rosettaRuntimeExports.size() * sizeof(Export));
+
+	auto fixupExports = [&](Export *machoTable, size_t count, const std::vector<Export> &rosettaTable) {
+		size_t passThroughCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			auto &exp = machoTable[i];
+			if (exp.address != 0) {
+				exp.address += machoBase;
+			} else if (i < rosettaTable.size()) {
+				exp.address = rosettaTable[i].address;
+				passThroughCount++;
+			}
+			exp.name += machoBase;
+		}
+		return passThroughCount;
+	};
+
+	auto x87PassThroughCount = fixupExports(x87Exports, machoExports->x87ExportCount, rosettaX87Exports);
+	auto runtimePassThroughCount = fixupExports(runtimeExports, machoExports->runtimeExportCount, rosettaRuntimeExports);
+	LOG("Passing through %zu x87 and %zu runtime exports to Rosetta\n", x87PassThroughCount, runtimePassThroughCount);
+
+	uint64_t machoExportsAddress = machoBase + exportsSection->addr;
+	machoExports->x87Exports += machoBase;
+	machoExports->runtimeExports += machoBase;
 
 	LOG("machoExports_address: 0x%llx\n", machoExportsAddress);
-	LOG("machoExports.x87Exports: 0x%llx\n", machoExports.x87Exports);
-	LOG("machoExports.runtimeExports: 0x%llx\n", machoExports.runtimeExports);
+	LOG("machoExports.x87Exports: 0x%llx\n", machoExports->x87Exports);
+	LOG("machoExports.runtimeExports: 0x%llx\n", machoExports->runtimeExports);
 
-	// match the running system's Rosetta version and export count
-	auto libRosettaRuntimeExportsAddress = dbg.readRegister(MuhDebugger::Register::X19);
-	Exports libRosettaRuntimeExports;
-	dbg.readMemory(libRosettaRuntimeExportsAddress, &libRosettaRuntimeExports, sizeof(libRosettaRuntimeExports));
+	// match the running system's Rosetta version and export count, X19 still
+	// holds the exports read at the breakpoint
+	auto libRosettaRuntimeExportsAddress = rosettaRuntimeExportsAddress;
+	auto &libRosettaRuntimeExports = exports;
 
-	machoExports.version = libRosettaRuntimeExports.version;
-	if (libRosettaRuntimeExports.x87ExportCount < machoExports.x87ExportCount) {
+	machoExports->version = libRosettaRuntimeExports.version;
+	if (libRosettaRuntimeExports.x87ExportCount < machoExports->x87ExportCount) {
 		LOG("Capping x87ExportCount from %llu to %llu to match system\n", 
-		    machoExports.x87ExportCount, libRosettaRuntimeExports.x87ExportCount);
-		machoExports.x87ExportCount = libRosettaRuntimeExports.x87ExportCount;
+		    machoExports->x87ExportCount, libRosettaRuntimeExports.x87ExportCount);
+		machoExports->x87ExportCount = libRosettaRuntimeExports.x87ExportCount;
 	}
 
-	dbg.writeMemory(machoExportsAddress, &machoExports, sizeof(machoExports));
-
 	// look up imports section of mapped macho
-	auto machoImportsAddress = machoBase + machoLoader.getSection("__DATA", "imports")->addr;
+	auto importsSection = machoLoader.getSection("__DATA", "imports");
+	auto machoImportsAddress = machoBase + importsSection->addr;
 	LOG("machoImportsAddress: 0x%llx\n", machoImportsAddress);
 
 	LOG("libRosettaRuntimeExportsAddress: 0x%llx\n", libRosettaRuntimeExportsAddress);
@@ -602,7 +627,45 @@ int main(int argc, char *argv[]) {
 	LOG("libRosettaRuntimeExports.runtimeExports = 0x%llx\n", libRosettaRuntimeExports.runtimeExports);
 	LOG("libRosettaRuntimeExports.runtimeExportCount = 0x%llx\n", libRosettaRuntimeExports.runtimeExportCount);
 
-	dbg.writeMemory(machoImportsAddress, &libRosettaRuntimeExports, sizeof(libRosettaRuntimeExports));
+	auto machoImports = imageData(importsSection->addr, sizeof(Exports));
+	if (machoImports == nullptr) {
+		return 1;
+	}
+	memcpy(machoImports, &libRosettaRuntimeExports, sizeof(Exports));
+
+	// copies an environment variable into a string section of the runtime
+	auto passEnvironment = [&](const char *variable, const char *sectionName) {
+		auto value = getenv(variable);
+		if (value == nullptr) {
+			return;
+		}
+
+		auto section = machoLoader.getSection("__DATA", sectionName);
+		auto length = strlen(value);
+
+		if (length >= section->size) {
+			fprintf(stderr, "%s is too long (%zu bytes, max %llu), ignoring it\n", variable, length, section->size - 1);
+		} else if (auto data = imageData(section->addr, length + 1)) {
+			LOG("%s: %s\n", variable, value);
+			memcpy(data, value, length + 1);
+		}
+	};
+
+	// pass the per handler mode selection and the trace and sample files on to
+	// init_library
+	passEnvironment("ROSETTA_X87_HANDLERS", "config");
+	passEnvironment("ROSETTA_X87_TRACE", "trace");
+	passEnvironment("ROSETTA_X87_SAMPLE", "sample");
+
+	for (auto &[segm, data] : segments) {
+		auto dest = machoBase + segm->vmaddr;
+
+		LOG("Copying segment %s from 0x%llx to 0x%llx (%zx bytes)\n", segm->segname, segm->fileoff, dest, data.size());
+
+		dbg.writeMemory(dest, data.data(), data.size());
+
+		dbg.adjustMemoryProtection(dest, segm->initprot, segm->vmsize);
+	}
 
 	// replace the exports in X19 register with the address of the mapped macho
 	dbg.setRegister(MuhDebugger::Register::X19, machoExportsAddress);
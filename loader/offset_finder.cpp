@@ -1,6 +1,22 @@
 #include "offset_finder.hpp"
+#include "known_runtimes.hpp"
+#if defined(ROSETTA_X87_RUNTIME_SAMPLES)
+#include "known_runtime_samples.hpp"
+#else
+#define ROSETTA_KNOWN_RUNTIME_SAMPLES(X)
+#endif
 
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
 
 auto OffsetFinder::setDefaultOffsets() -> void {
 	// These are the default offsets for the rosetta runtime that matches MD5 hash: d7819a04355cd77ff24031800a985c13
@@ -24,57 +40,273 @@ auto OffsetFinder::setDefaultOffsets() -> void {
 	offsetSvcCallRet_ = offsetSvcCallEntry_ + 0xC; // The return point of the above function
 }
 
-auto OffsetFinder::determineOffsets() -> bool {
-	// byte patterns in hex for the functions we need to find.
-	const std::vector<unsigned char> exportsFetch = {0x62, 0x06, 0x40, 0xF9, 0x63, 0x12, 0x40, 0xB9 };
-	const std::vector<unsigned char> svcCall = { 0xB0, 0x18, 0x80, 0xD2, 0x01, 0x10, 0x00, 0xD4, 0xE1, 0x37, 0x9F, 0x9A, 0xC0, 0x03, 0x5F, 0xD6 };
-	// For svc_call we need to check where this bitpattern starts in the code and also where it ends (we can just add 0xC to the start to get the end)
+auto runtimeSignatures() -> std::vector<Signature> const & {
+	static const std::vector<Signature> signatures = {
+		{ "exports fetch", { 0x62, 0x06, 0x40, 0xF9, 0x63, 0x12, 0x40, 0xB9 } },
+		// For svc_call we need to check where this bitpattern starts in the code and also where it ends (we can just add 0xC to the start to get the end)
+		{ "svc call", { 0xB0, 0x18, 0x80, 0xD2, 0x01, 0x10, 0x00, 0xD4, 0xE1, 0x37, 0x9F, 0x9A, 0xC0, 0x03, 0x5F, 0xD6 } },
+	};
+	return signatures;
+}
+
+// Single pass over the binary. Signatures are AArch64 instruction sequences,
+// so only word aligned offsets are tested. The first byte of a word rules out
+// most offsets with one table lookup before the signatures starting with it
+// are compared.
+auto findSignatures(const unsigned char *data, size_t size, const std::vector<Signature> &signatures) -> std::vector<std::vector<std::uint64_t>> {
+	std::vector<std::vector<std::uint64_t>> matches(signatures.size());
+
+	bool firstBytes[256] = {};
+	for (const auto &signature : signatures) {
+		firstBytes[signature.bytes[0]] = true;
+	}
+
+	for (size_t offset = 0; offset + sizeof(std::uint32_t) <= size; offset += sizeof(std::uint32_t)) {
+		if (!firstBytes[data[offset]]) {
+			continue;
+		}
+
+		for (size_t i = 0; i < signatures.size(); i++) {
+			const auto &bytes = signatures[i].bytes;
+			if (bytes.size() <= size - offset && memcmp(data + offset, bytes.data(), bytes.size()) == 0) {
+				matches[i].push_back(offset);
+			}
+		}
+	}
+
+	return matches;
+}
 
-	// Load rosetta runtime into an ifstream
-	std::ifstream file{"/usr/libexec/rosetta/runtime", std::ios::binary};
+// Runtimes whose offsets are compiled in, from loader/known_runtimes.hpp and
+// the runtimes of ROSETTA_X87_RUNTIME_SAMPLES. An entry applies to a runtime
+// of its size, or of any size for size 0, whose signatures lie at its offsets,
+// so entries never need a hash of the runtime and a wrong one is skipped. The
+// table is sorted by size at compile time so that the entries of a size are
+// found with a binary search.
+struct KnownRuntime {
+	std::uint64_t size;
+	std::uint64_t offsetExportsFetch;
+	std::uint64_t offsetSvcCallEntry;
+
+	constexpr auto operator<(KnownRuntime const &other) const -> bool {
+		return size < other.size;
+	}
+};
+
+#define KNOWN_RUNTIME_COUNT(SIZE, EXPORTS_FETCH, SVC_CALL_ENTRY) +1
+#define KNOWN_RUNTIME_ENTRY(SIZE, EXPORTS_FETCH, SVC_CALL_ENTRY) KnownRuntime{ SIZE, EXPORTS_FETCH, SVC_CALL_ENTRY },
+constexpr auto kKnownRuntimes = [] {
+	std::array<KnownRuntime, 0 ROSETTA_KNOWN_RUNTIMES(KNOWN_RUNTIME_COUNT) ROSETTA_KNOWN_RUNTIME_SAMPLES(KNOWN_RUNTIME_COUNT)> runtimes = { {
+		ROSETTA_KNOWN_RUNTIMES(KNOWN_RUNTIME_ENTRY) ROSETTA_KNOWN_RUNTIME_SAMPLES(KNOWN_RUNTIME_ENTRY) } };
+	std::sort(runtimes.begin(), runtimes.end());
+	return runtimes;
+}();
+#undef KNOWN_RUNTIME_COUNT
+#undef KNOWN_RUNTIME_ENTRY
+
+static auto signatureAt(int fd, std::uint64_t offset, Signature const &signature) -> bool {
+	unsigned char bytes[32];
+	if (signature.bytes.size() > sizeof(bytes)) {
+		return false;
+	}
+	const auto length = pread(fd, bytes, signature.bytes.size(), offset);
+	return length == static_cast<ssize_t>(signature.bytes.size()) && memcmp(bytes, signature.bytes.data(), signature.bytes.size()) == 0;
+}
+
+// The offsets found in a runtime, stored between launches so that the runtime
+// is only searched again after it changed.
+struct OffsetCache {
+	std::uint64_t magic;
+	RuntimeIdentity identity;
+	std::uint64_t offsetExportsFetch;
+	std::uint64_t offsetSvcCallEntry;
+	std::uint64_t offsetSvcCallRet;
+};
+
+constexpr std::uint64_t kOffsetCacheMagic = 0x3146464F37385852; // "RX87OFF1"
+
+static auto offsetCacheDirectory() -> std::string {
+	auto home = getenv("HOME");
+	if (home == nullptr || home[0] == '\0') {
+		return {};
+	}
+	return std::string(home) + "/Library/Caches/rosettax87";
+}
+
+static auto runtimeIdentity(int fd, struct stat const &st) -> RuntimeIdentity {
+	RuntimeIdentity identity = {};
+	identity.size = st.st_size;
+#if defined(__APPLE__)
+	identity.mtimeSeconds = st.st_mtimespec.tv_sec;
+	identity.mtimeNanoseconds = st.st_mtimespec.tv_nsec;
+#else
+	identity.mtimeSeconds = st.st_mtim.tv_sec;
+	identity.mtimeNanoseconds = st.st_mtim.tv_nsec;
+#endif
+
+	// FNV-1a over the first page
+	unsigned char page[4096];
+	auto length = pread(fd, page, sizeof(page), 0);
+	identity.hash = 0xCBF29CE484222325;
+	for (ssize_t i = 0; i < length; i++) {
+		identity.hash = (identity.hash ^ page[i]) * 0x100000001B3;
+	}
+	return identity;
+}
+
+auto OffsetFinder::loadKnownOffsets(int fd, std::uint64_t size) -> bool {
+	const auto &signatures = runtimeSignatures();
+	// entries of this size first, then those for any size
+	for (const auto key : { size, std::uint64_t{ 0 } }) {
+		const auto [first, last] = std::equal_range(kKnownRuntimes.begin(), kKnownRuntimes.end(), KnownRuntime{ key, 0, 0 });
+		for (auto known = first; known != last; ++known) {
+			if (!signatureAt(fd, known->offsetExportsFetch, signatures[0]) || !signatureAt(fd, known->offsetSvcCallEntry, signatures[1])) {
+				continue;
+			}
+
+			offsetExportsFetch_ = known->offsetExportsFetch;
+			offsetSvcCallEntry_ = known->offsetSvcCallEntry;
+			offsetSvcCallRet_ = offsetSvcCallEntry_ + 0xC;
+			return true;
+		}
+		if (size == 0) {
+			break;
+		}
+	}
+	return false;
+}
+
+auto OffsetFinder::loadCachedOffsets(int fd, RuntimeIdentity const &identity) -> bool {
+	auto directory = offsetCacheDirectory();
+	if (directory.empty()) {
+		return false;
+	}
+
+	auto cacheFd = open((directory + "/offsets").c_str(), O_RDONLY);
+	if (cacheFd < 0) {
+		return false;
+	}
+
+	OffsetCache cache;
+	auto length = read(cacheFd, &cache, sizeof(cache));
+	close(cacheFd);
+
+	// only trust offsets that could have come from this runtime
+	if (length != sizeof(cache) || cache.magic != kOffsetCacheMagic || !(cache.identity == identity)) {
+		return false;
+	}
+	// the identity only hashes the first page, a runtime changed in place
+	// without a new size or modification time must not be stopped at random
+	// instructions
+	const auto &signatures = runtimeSignatures();
+	if (cache.offsetSvcCallRet != cache.offsetSvcCallEntry + 0xC || !signatureAt(fd, cache.offsetExportsFetch, signatures[0]) ||
+	    !signatureAt(fd, cache.offsetSvcCallEntry, signatures[1])) {
+		return false;
+	}
+
+	offsetExportsFetch_ = cache.offsetExportsFetch;
+	offsetSvcCallEntry_ = cache.offsetSvcCallEntry;
+	offsetSvcCallRet_ = cache.offsetSvcCallRet;
+	return true;
+}
+
+auto OffsetFinder::storeCachedOffsets(RuntimeIdentity const &identity) const -> void {
+	auto directory = offsetCacheDirectory();
+	if (directory.empty()) {
+		return;
+	}
+
+	// ~/Library/Caches exists on every macOS install, only our directory is created
+	mkdir(directory.c_str(), 0755);
+
+	const OffsetCache cache = {
+		.magic = kOffsetCacheMagic,
+		.identity = identity,
+		.offsetExportsFetch = offsetExportsFetch_,
+		.offsetSvcCallEntry = offsetSvcCallEntry_,
+		.offsetSvcCallRet = offsetSvcCallRet_,
+	};
+
+	// write a private file and rename it over the cache, so that concurrent launches never read a partial one
+	auto path = directory + "/offsets";
+	auto temporaryPath = path + "." + std::to_string(getpid());
+
+	auto fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return;
+	}
+
+	auto written = write(fd, &cache, sizeof(cache));
+	close(fd);
+
+	if (written != sizeof(cache) || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		unlink(temporaryPath.c_str());
+	}
+}
+
+auto OffsetFinder::determineOffsets() -> bool {
+	auto fd = open("/usr/libexec/rosetta/runtime", O_RDONLY);
 
 	// Check if we were successfully able to load the file, if not abort and use default offsets
-	if (!file) {
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
 		fprintf(stderr, "Problem accessing rosetta runtime to determine offsets automatically.\nFalling back to macOS 26.0 defaults (This WILL crash your app if they are not correct!)\n");
 		return false;
 	}
 
-	// Determine size of rosetta runtime file
-	file.seekg(0, std::ios::end);
-	std::streampos size = file.tellg();
-	file.seekg(0, std::ios::beg);
+	// The runtime only changes with OS updates, skip the search for runtimes that are known or were searched before
+	const auto identity = runtimeIdentity(fd, st);
+	if (loadKnownOffsets(fd, st.st_size) || loadCachedOffsets(fd, identity)) {
+		close(fd);
+		return true;
+	}
+
+	const auto found = searchOffsets(fd, st.st_size);
+	close(fd);
+
+	if (found) {
+		storeCachedOffsets(identity);
+	}
+	return found;
+}
+
+auto OffsetFinder::searchOffsets(int fd, std::uint64_t size) -> bool {
+	const auto &signatures = runtimeSignatures();
 
-	// Set our buffer to the size of the file
-	std::vector<unsigned char> buffer(size);
+	// Map the rosetta runtime read-only
+	auto mapping = size != 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
 
-	// read into the buffer
-	if (!file.read(reinterpret_cast<char *>(buffer.data()), size)) {
+	if (mapping == MAP_FAILED) {
 		fprintf(stderr, "Problem reading rosetta runtime to determine offsets automatically.\nFalling back to macOS 26.0 defaults (This WILL crash your app if they are not correct!)\n");
 		return false;
 	}
 
-	// Do the search and store the results
-	std::vector<std::uint64_t> results;
-	for (const auto offset : { exportsFetch, svcCall }) {
-		const std::boyer_moore_searcher searcher(offset.begin(), offset.end());
-		const auto it = std::search(buffer.begin(), buffer.end(), searcher);
-		if (it == buffer.end()) {
-			fprintf(stderr, "Offset not found in rosetta runtime binary\n");
-			results.push_back(-1);
-		} else {
-			results.push_back((std::uint64_t)std::distance(buffer.begin(), it));
+	// Do the search, every match is kept so that ambiguous signatures are reported
+	const auto matches = findSignatures((const unsigned char *)mapping, size, signatures);
+	munmap(mapping, size);
+	// A missing signature leaves nothing to stop at, fall back instead. One that
+	// matches more than once most likely still matches first where it used to.
+	bool found = true;
+	for (size_t i = 0; i < signatures.size(); i++) {
+		if (matches[i].empty()) {
+			fprintf(stderr, "Offset of %s not found in rosetta runtime binary\n", signatures[i].name);
+			found = false;
+		} else if (matches[i].size() > 1) {
+			fprintf(stderr, "Warning: offset of %s is ambiguous in rosetta runtime binary (%zu matches), using the first at 0x%llx\n", signatures[i].name, matches[i].size(), (unsigned long long)matches[i][0]);
 		}
 	}
 
-	// If we've stored -1 in any offset, error out and fall back to non-accelerated x87 handles.
-	if ((int)results[0] <= -1 || (int)results[1] <= -1) {
+	if (!found) {
 		fprintf(stderr, "Problem searching rosetta runtime to determine offsets automatically.\nFalling back to macOS 26 defaults (This WILL crash your app if they are not correct!)\n");
 		return false;
 	}
 
-	// Set the offsets to the results that we've found now that we know they're "correct".
-	offsetExportsFetch_ = results[0];
-	offsetSvcCallEntry_ = results[1];
+	// Set the offsets to the first matches now that we know every signature was found.
+	offsetExportsFetch_ = matches[0][0];
+	offsetSvcCallEntry_ = matches[1][0];
 	offsetSvcCallRet_ = offsetSvcCallEntry_ + 0xC;
 
 	return true;
@@ -1,6 +1,32 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
+
+// Identifies a build of the rosetta runtime without reading all of it: the
+// file size and modification time, and a hash of the first page, which holds
+// the Mach-O header with the LC_UUID of the build.
+struct RuntimeIdentity {
+	std::uint64_t size;
+	std::int64_t mtimeSeconds;
+	std::int64_t mtimeNanoseconds;
+	std::uint64_t hash;
+
+	auto operator==(RuntimeIdentity const &) const -> bool = default;
+};
+
+// A byte pattern in hex for one of the functions we need to find.
+struct Signature {
+	const char *name;
+	std::vector<unsigned char> bytes;
+};
+
+// The signatures searchOffsets looks for: the exports fetch, then the svc call.
+auto runtimeSignatures() -> std::vector<Signature> const &;
+
+// Finds every match of the signatures at word aligned offsets, in ascending
+// order for each signature.
+auto findSignatures(const unsigned char *data, size_t size, const std::vector<Signature> &signatures) -> std::vector<std::vector<std::uint64_t>>;
 
 struct OffsetFinder {
 	auto setDefaultOffsets() -> void;
@@ -9,4 +35,17 @@ struct OffsetFinder {
 	std::uint64_t offsetExportsFetch_;
 	std::uint64_t offsetSvcCallEntry_;
 	std::uint64_t offsetSvcCallRet_;
+
+	// Searches the runtime binary for the signatures, without consulting the
+	// known runtimes or the cache.
+	auto searchOffsets(int fd, std::uint64_t size) -> bool;
+
+	// Takes the offsets of the first known runtime whose signatures are found
+	// at its offsets in the runtime binary.
+	auto loadKnownOffsets(int fd, std::uint64_t size) -> bool;
+
+	// The offsets cached in ~/Library/Caches/rosettax87 for a runtime with
+	// this identity, used only if the signatures are found at them.
+	auto loadCachedOffsets(int fd, RuntimeIdentity const &identity) -> bool;
+	auto storeCachedOffsets(RuntimeIdentity const &identity) const -> void;
 };
@@ -0,0 +1,155 @@
+#pragma once
+
+// Double-double division and square root on X87Float80 values, used by the
+// exact handlers. A register splits exactly into hi + lo doubles (53 + 11 bits
+// of the mantissa), the operation runs on hardware doubles with an FMA based
+// correction step to about 100 bits, and the result is rounded once to 64 bits
+// in the rounding control like in X87SoftFloat.h. This replaces the long
+// division and the Newton iteration of the 128 bit engine. Results whose
+// rounding the computed bits cannot decide, exact results among them, are
+// computed again in the engine, so the results and flags match it bit for
+// bit. Addition and multiplication stay in the engine, its integer arithmetic
+// is as fast as TwoSum and TwoProd there.
+//
+// Operands outside kDoubleDoubleMaxExponent (zeros, denormals, infinities,
+// NaNs and very large or small values) and precisions below 64 bits go
+// through the engine, which keeps the exception flags exact. Inside the window
+// no operation overflows, underflows or divides by zero.
+//
+// The error-free transformations assume the host rounds to nearest, which is
+// the mode the exact handlers run in. Nothing here needs FP80 storage, the
+// handlers using it do.
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#include "X87Float80.h"
+#include "X87SoftFloat.h"
+
+// Largest unbiased exponent handled in doubles. Quotients and square roots of
+// such operands, including their error terms, stay normal doubles.
+constexpr int32_t kDoubleDoubleMaxExponent = 255;
+
+struct DoubleDouble {
+	double hi;
+	double lo;
+};
+
+// Exact hi + lo of a + b, requires |a| >= |b| or a == 0.
+__attribute__((always_inline)) inline auto doubleDoubleFastTwoSum(double a, double b) -> DoubleDouble {
+	const double sum = a + b;
+	return {sum, b - (sum - a)};
+}
+
+// True for normal operands with an exponent inside the window.
+__attribute__((always_inline)) inline auto doubleDoubleFits(X87Float80 value) -> bool {
+	const uint32_t biased = value.exponent & 0x7FFF;
+	return static_cast<uint32_t>(biased - (kFloat80Bias - kDoubleDoubleMaxExponent)) <= 2 * kDoubleDoubleMaxExponent &&
+	       (value.mantissa & kFloat80IntegerBit) != 0;
+}
+
+// The shortcut only rounds to 64 bits, the engine handles the other
+// precisions, whose rounding boundaries lie inside hi.
+__attribute__((always_inline)) inline auto doubleDoublePrecision(uint16_t controlWord) -> bool {
+	return (controlWord & X87ControlWord::kPrecisionControl) == X87ControlWord::kPrecision64Bit;
+}
+
+// Splits a value that fits into hi (top 53 bits) and lo (low 11 bits).
+__attribute__((always_inline)) inline auto doubleDoubleSplit(X87Float80 value) -> DoubleDouble {
+	const int32_t exponent = (value.exponent & 0x7FFF) - kFloat80Bias;
+	const uint64_t sign = static_cast<uint64_t>(value.exponent & 0x8000) << 48;
+	const double hi = std::bit_cast<double>(sign | (static_cast<uint64_t>(exponent + 1023) << 52) | ((value.mantissa >> 11) & 0x000FFFFFFFFFFFFFULL));
+	// 2^(exponent - 63), the weight of the lowest mantissa bit
+	const double scale = std::bit_cast<double>(sign | (static_cast<uint64_t>(exponent - 63 + 1023) << 52));
+	return {hi, static_cast<double>(value.mantissa & 0x7FF) * scale};
+}
+
+// Largest distance, in units of the last place, of the computed hi + lo from
+// the exact result is about 2^-37. Fractions closer than this to a tie or to
+// zero could round, or set the precision flag, differently than the exact
+// result and are left to the engine.
+constexpr double kDoubleDoubleGuard = 0x1p-20;
+
+// Rounds hi + lo, hi != 0 and |lo| <= ulp(hi) / 2, to 64 bits in the rounding
+// control. The 11 mantissa bits below hi are the integer part of lo in units
+// of the last place, and the fraction decides the rounding. Returns false
+// when the fraction is within kDoubleDoubleGuard of a tie or of zero, or the
+// leading bit moves, for the caller to compute the result in the engine.
+__attribute__((always_inline)) inline auto doubleDoublePack(DoubleDouble value, uint16_t controlWord, uint16_t *statusWord, X87Float80 *result) -> bool {
+	const auto hiBits = std::bit_cast<uint64_t>(value.hi);
+	const bool sign = (hiBits >> 63) != 0;
+
+	// lo in units of the last place of the result, with the sign of hi folded in
+	const int32_t hiExponent = static_cast<int32_t>((hiBits >> 52) & 0x7FF);
+	const double scale = std::bit_cast<double>((static_cast<uint64_t>(1023 + 1023 + 63 - hiExponent) << 52) | (hiBits & 0x8000000000000000ULL));
+	const double units = value.lo * scale;
+	// round to nearest even, |units| <= 2^10
+	constexpr double kToInt = 0x1.8p52;
+	double whole = (units + kToInt) - kToInt;
+	const double fraction = units - whole;
+	if (std::fabs(fraction) < kDoubleDoubleGuard || 0.5 - std::fabs(fraction) < kDoubleDoubleGuard) [[unlikely]] {
+		return false;
+	}
+
+	const uint16_t rounding = controlWord & X87ControlWord::kRoundingControlMask;
+	const bool towardZero = rounding == X87ControlWord::kRoundToZero || (rounding == X87ControlWord::kRoundUp && sign) ||
+	                        (rounding == X87ControlWord::kRoundDown && !sign);
+	if (rounding != X87ControlWord::kRoundToNearest) {
+		// truncate or round away from zero in magnitude
+		if (towardZero && fraction < 0.0) {
+			whole -= 1.0;
+		} else if (!towardZero && fraction > 0.0) {
+			whole += 1.0;
+		}
+	}
+
+	const uint64_t base = ((hiBits & 0x000FFFFFFFFFFFFFULL) | 0x0010000000000000ULL) << 11;
+	const auto adjust = static_cast<int64_t>(whole);
+	if (adjust < 0 && base == kFloat80IntegerBit) [[unlikely]] {
+		return false;
+	}
+
+	const bool roundedUp = static_cast<double>(adjust) > units;
+	*statusWord = (*statusWord & ~X87StatusWordFlag::kConditionCode1) | X87StatusWordFlag::kPrecision | (roundedUp ? X87StatusWordFlag::kConditionCode1 : 0);
+	*result = softFloat80Make(sign, hiExponent - 1023 + kFloat80Bias, base + static_cast<uint64_t>(adjust));
+	return true;
+}
+
+inline auto doubleDouble80Div(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	if (!doubleDoubleFits(a) || !doubleDoubleFits(b) || !doubleDoublePrecision(controlWord)) [[unlikely]] {
+		return softFloat80Div(a, b, controlWord, statusWord);
+	}
+
+	const auto x = doubleDoubleSplit(a);
+	const auto y = doubleDoubleSplit(b);
+	// one correction step: q = q1 + (x - q1 * y) / y.hi, x.hi - q1 * y.hi is
+	// exact as the two are within a factor of two
+	const double quotient = x.hi / y.hi;
+	const double product = quotient * y.hi;
+	const double error = std::fma(quotient, y.hi, -product);
+	const double remainder = (((x.hi - product) - error) + x.lo) - quotient * y.lo;
+	X87Float80 result;
+	if (!doubleDoublePack(doubleDoubleFastTwoSum(quotient, remainder / y.hi), controlWord, statusWord, &result)) [[unlikely]] {
+		return softFloat80Div(a, b, controlWord, statusWord);
+	}
+	return result;
+}
+
+inline auto doubleDouble80Sqrt(X87Float80 a, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	if (!doubleDoubleFits(a) || softFloat80Sign(a) || !doubleDoublePrecision(controlWord)) [[unlikely]] {
+		return softFloat80Sqrt(a, controlWord, statusWord);
+	}
+
+	const auto x = doubleDoubleSplit(a);
+	// one Newton step on the residual x - s^2
+	const double root = std::sqrt(x.hi);
+	const double square = root * root;
+	const double error = std::fma(root, root, -square);
+	const double remainder = ((x.hi - square) - error) + x.lo;
+	X87Float80 result;
+	if (!doubleDoublePack(doubleDoubleFastTwoSum(root, remainder / (2.0 * root)), controlWord, statusWord, &result)) [[unlikely]] {
+		return softFloat80Sqrt(a, controlWord, statusWord);
+	}
+	return result;
+}
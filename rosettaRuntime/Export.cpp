@@ -1,8 +1,29 @@
 #include "Export.h"
+#include "Sample.h"
 #include "X87.h"
+#include "X87State.h"
 
 #include <array>
 
+// Exports without a native implementation are left null. The loader writes
+// Rosetta's own address for the same index into those entries, so calls into
+// them do not go through a trampoline.
+static constexpr void *kPassThrough = nullptr;
+
+// Implemented natively unless the registers are kept in Rosetta's format.
+#if defined(X87_CONVERT_TO_FP80)
+#define X87_FP80_PASS_THROUGH(NAME) kPassThrough
+#else
+#define X87_FP80_PASS_THROUGH(NAME) (void *)&NAME
+#endif
+
+// The translator is intercepted to map samples back to guest code.
+#if defined(X87_SAMPLE)
+#define X87_SAMPLE_PASS_THROUGH(NAME) (void *)&NAME
+#else
+#define X87_SAMPLE_PASS_THROUGH(NAME) kPassThrough
+#endif
+
 __attribute__((used)) init_library_t orig_init_library;
 __attribute__((used)) register_runtime_routine_offsets_t orig_register_runtime_routine_offsets;
 __attribute__((used)) translator_use_t8027_codegen_t orig_translator_use_t8027_codegen;
@@ -116,30 +137,30 @@ __attribute__((used)) runtime_cpuid_t orig_runtime_cpuid;
 __attribute__((used)) runtime_wide_udiv_64_t orig_runtime_wide_udiv_64;
 __attribute__((used)) runtime_wide_sdiv_64_t orig_runtime_wide_sdiv_64;
 
-constexpr std::array kExportList{
+constinit const std::array kExportList{
 	Export{(void *)&init_library, "__ZN7rosetta7runtime7library12init_libraryEPKNS1_10SymbolListEyPKNS_20ThreadContextOffsetsE"},
-	Export{(void *)&register_runtime_routine_offsets, "__ZN7rosetta7runtime7library32register_runtime_routine_offsetsEPKyPPKcm"},
-	Export{(void *)&translator_use_t8027_codegen, "__ZN7rosetta7runtime7library28translator_use_t8027_codegenEb"},
-	Export{(void *)&translator_reset, "__ZN7rosetta7runtime7library16translator_resetEv"},
-	Export{(void *)&ir_create_bad_access, "__ZN7rosetta7runtime7library20ir_create_bad_accessEy13BadAccessKind"},
-	Export{(void *)&ir_create, "__ZN7rosetta7runtime7library9ir_createEyjj15TranslationMode13ExecutionMode"},
-	Export{(void *)&module_free, "__ZN7rosetta7runtime7library11module_freeEPKNS1_12ModuleResultE"},
-	Export{(void *)&module_get_size, "__ZN7rosetta7runtime7library15module_get_sizeEPKNS1_12ModuleResultE"},
-	Export{(void *)&module_is_bad_access, "__ZN7rosetta7runtime7library20module_is_bad_accessEPKNS1_12ModuleResultE"},
-	Export{(void *)&module_print, "__ZN7rosetta7runtime7library12module_printEPKNS1_12ModuleResultEi"},
-	Export{(void *)&translator_translate, "__ZN7rosetta7runtime7library20translator_translateEPKNS1_12ModuleResultE15TranslationMode"},
-	Export{(void *)&translator_free, "__ZN7rosetta7runtime7library15translator_freeEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_get_data, "__ZN7rosetta7runtime7library19translator_get_dataEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_get_size, "__ZN7rosetta7runtime7library19translator_get_sizeEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_get_branch_slots_offset, "__ZN7rosetta7runtime7library34translator_get_branch_slots_offsetEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_get_branch_slots_count, "__ZN7rosetta7runtime7library33translator_get_branch_slots_countEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_get_branch_entries, "__ZN7rosetta7runtime7library29translator_get_branch_entriesEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_get_instruction_offsets, "__ZN7rosetta7runtime7library34translator_get_instruction_offsetsEPKNS1_17TranslationResultE"},
-	Export{(void *)&translator_apply_fixups, "__ZN7rosetta7runtime7library23translator_apply_fixupsEPNS1_17TranslationResultEPhy"},
-	Export{(void *)&x87_init, "__ZN7rosetta7runtime7library8x87_initEPNS1_8X87StateE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library32register_runtime_routine_offsetsEPKyPPKcm"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library28translator_use_t8027_codegenEb"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library16translator_resetEv"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library20ir_create_bad_accessEy13BadAccessKind"},
+	Export{X87_SAMPLE_PASS_THROUGH(sampleIrCreate), "__ZN7rosetta7runtime7library9ir_createEyjj15TranslationMode13ExecutionMode"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library11module_freeEPKNS1_12ModuleResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library15module_get_sizeEPKNS1_12ModuleResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library20module_is_bad_accessEPKNS1_12ModuleResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library12module_printEPKNS1_12ModuleResultEi"},
+	Export{X87_SAMPLE_PASS_THROUGH(sampleTranslatorTranslate), "__ZN7rosetta7runtime7library20translator_translateEPKNS1_12ModuleResultE15TranslationMode"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library15translator_freeEPKNS1_17TranslationResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library19translator_get_dataEPKNS1_17TranslationResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library19translator_get_sizeEPKNS1_17TranslationResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library34translator_get_branch_slots_offsetEPKNS1_17TranslationResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library33translator_get_branch_slots_countEPKNS1_17TranslationResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library29translator_get_branch_entriesEPKNS1_17TranslationResultE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library34translator_get_instruction_offsetsEPKNS1_17TranslationResultE"},
+	Export{X87_SAMPLE_PASS_THROUGH(sampleTranslatorApplyFixups), "__ZN7rosetta7runtime7library23translator_apply_fixupsEPNS1_17TranslationResultEPhy"},
+	Export{X87_FP80_PASS_THROUGH(x87_init), "__ZN7rosetta7runtime7library8x87_initEPNS1_8X87StateE"},
 	Export{(void *)&x87_state_from_x86_float_state, "__ZN7rosetta7runtime7library30x87_state_from_x86_float_stateEPNS1_8X87StateEPKNS0_15X86FloatState64E"},
 	Export{(void *)&x87_state_to_x86_float_state, "__ZN7rosetta7runtime7library28x87_state_to_x86_float_stateEPKNS1_8X87StateEPNS0_15X86FloatState64E"},
-	Export{(void *)&x87_pop_register_stack, "__ZN7rosetta7runtime7library22x87_pop_register_stackEPNS1_8X87StateE"},
+	Export{X87_FP80_PASS_THROUGH(x87_pop_register_stack), "__ZN7rosetta7runtime7library22x87_pop_register_stackEPNS1_8X87StateE"},
 	Export{(void *)&x87_f2xm1, "__ZN7rosetta7runtime7library9x87_f2xm1EPNS1_8X87StateE"},
 	Export{(void *)&x87_fabs, "__ZN7rosetta7runtime7library8x87_fabsEPNS1_8X87StateE"},
 	Export{(void *)&x87_fadd_ST, "__ZN7rosetta7runtime7library11x87_fadd_STEPNS1_8X87StateEjjb"},
@@ -211,29 +232,29 @@ constexpr std::array kExportList{
 	Export{(void *)&x87_fxtract, "__ZN7rosetta7runtime7library11x87_fxtractEPNS1_8X87StateE"},
 	Export{(void *)&x87_fyl2x, "__ZN7rosetta7runtime7library9x87_fyl2xEPNS1_8X87StateE"},
 	Export{(void *)&x87_fyl2xp1, "__ZN7rosetta7runtime7library11x87_fyl2xp1EPNS1_8X87StateE"},
-	Export{(void *)&sse_pcmpestri, "__ZN7rosetta7runtime7library13sse_pcmpestriEyyyyhxx"},
-	Export{(void *)&sse_pcmpestrm, "__ZN7rosetta7runtime7library13sse_pcmpestrmEyyyyhxx"},
-	Export{(void *)&sse_pcmpistri, "__ZN7rosetta7runtime7library13sse_pcmpistriEyyyyh"},
-	Export{(void *)&sse_pcmpistrm, "__ZN7rosetta7runtime7library13sse_pcmpistrmEyyyyh"},
-	Export{(void *)&is_ldt_initialized, "__ZN7rosetta7runtime7library18is_ldt_initializedEv"},
-	Export{(void *)&get_ldt, "__ZN7rosetta7runtime7library7get_ldtEjjPvj"},
-	Export{(void *)&set_ldt, "__ZN7rosetta7runtime7library7set_ldtEjjPKvj"},
-	Export{(void *)&execution_mode_for_code_segment_selector, "__ZN7rosetta7runtime7library40execution_mode_for_code_segment_selectorEjt"},
-	Export{(void *)&mov_segment, "__ZN7rosetta7runtime7library11mov_segmentEjPNS1_16SegmentRegistersENS1_15SegmentRegisterEt"},
-	Export{(void *)&abi_for_address, "__ZN7rosetta7runtime7library15abi_for_addressEy"},
-	Export{(void *)&determine_state_recovery_action, "__ZN7rosetta7runtime7library31determine_state_recovery_actionEPKjjj"},
-	Export{(void *)&get_segment_limit, "__ZN7rosetta7runtime7library17get_segment_limitEjt"},
-	Export{(void *)&translator_set_variant, "__ZN7rosetta7runtime7library22translator_set_variantEb"},
-	Export{(void *)&x87_set_init_state, "__ZN7rosetta7runtime7library18x87_set_init_stateEPNS1_8X87StateE"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library13sse_pcmpestriEyyyyhxx"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library13sse_pcmpestrmEyyyyhxx"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library13sse_pcmpistriEyyyyh"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library13sse_pcmpistrmEyyyyh"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library18is_ldt_initializedEv"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library7get_ldtEjjPvj"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library7set_ldtEjjPKvj"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library40execution_mode_for_code_segment_selectorEjt"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library11mov_segmentEjPNS1_16SegmentRegistersENS1_15SegmentRegisterEt"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library15abi_for_addressEy"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library31determine_state_recovery_actionEPKjjj"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library17get_segment_limitEjt"},
+	Export{kPassThrough, "__ZN7rosetta7runtime7library22translator_set_variantEb"},
+	Export{X87_FP80_PASS_THROUGH(x87_set_init_state), "__ZN7rosetta7runtime7library18x87_set_init_stateEPNS1_8X87StateE"},
 };
 
-constexpr std::array kRuntimeExportList = {
-	Export{(void *)&runtime_cpuid, "runtime_cpuid"},
-	Export{(void *)&runtime_wide_udiv_64, "runtime_wide_udiv_64"},
-	Export{(void *)&runtime_wide_sdiv_64, "runtime_wide_sdiv_64"},
+constinit const std::array kRuntimeExportList = {
+	Export{kPassThrough, "runtime_cpuid"},
+	Export{kPassThrough, "runtime_wide_udiv_64"},
+	Export{kPassThrough, "runtime_wide_sdiv_64"},
 };
 
-__attribute__((section("__DATA,exports"), used)) Exports kExports = {
+RUNTIME_DATA_SECTION("exports") Exports kExports = {
 	0x16A0000000000,
 	kExportList.data(),
 	kExportList.size(),
@@ -242,7 +263,7 @@ __attribute__((section("__DATA,exports"), used)) Exports kExports = {
 };
 
 // this is filled in by loader with the exports of libRosettaRuntime
-__attribute__((section("__DATA,imports"), used)) Exports kImports = {
+RUNTIME_DATA_SECTION("imports") Exports kImports = {
 	0x0,
 	0x0,
 	0x0,
@@ -4,6 +4,14 @@
 
 #include "X87.h"
 
+// Sections the loader reads or patches in the runtime image. Host builds are
+// ELF, which has no segment,section names.
+#if defined(__APPLE__)
+#define RUNTIME_DATA_SECTION(NAME) __attribute__((section("__DATA," NAME), used))
+#else
+#define RUNTIME_DATA_SECTION(NAME) __attribute__((section(NAME), used))
+#endif
+
 struct Export {
 	void *address;
 	const char *name;
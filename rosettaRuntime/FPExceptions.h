@@ -0,0 +1,183 @@
+#pragma once
+
+// Opt-in IEEE exception flags for the native handlers. Enable with the
+// ROSETTA_X87_EXCEPTIONS CMake option (defines X87_IEEE_EXCEPTIONS). The
+// handlers compute in double and never test their results for exceptions,
+// instead the dispatch slots call the handlers that do floating point work
+// through FPExceptionHandler. It clears the cumulative flags of the host FPSR
+// (MXCSR on x86 hosts) before the call and maps what the handler raised onto
+// the status word after it, with a few bit operations.
+//
+// The merge cannot be deferred to the readers of the status word, fnstsw,
+// fstenv and fsave are translated inline and read X87State directly. Neither
+// can the flags accumulate in the FPSR across handlers, the translated SSE
+// code in between shares the register, so the FPSR found on entry is restored.
+// Writing the register can cost as much as the handler, so only the flags the
+// status word does not hold yet are cleared, and nothing is written when they
+// were clear or the handler raised nothing new. Once a program has seen its
+// first inexact result, the common case writes nothing at all.
+
+#include <cstdint>
+#include <type_traits>
+
+#include "X87.h"
+#include "X87State.h"
+
+#if defined(__aarch64__)
+// FPSR IOC, DZC, OFC, UFC, IXC and IDC
+constexpr uint64_t kFPExceptionFlags = 0x9F;
+#else
+// MXCSR IE, DE, ZE, OE, UE and PE
+constexpr uint64_t kFPExceptionFlags = 0x3F;
+#endif
+
+__attribute__((always_inline)) inline auto fpExceptionRead() -> uint64_t {
+#if defined(__aarch64__)
+	uint64_t fpsr;
+	asm volatile("mrs %0, fpsr" : "=r"(fpsr) : : "memory");
+	return fpsr;
+#else
+	return __builtin_ia32_stmxcsr();
+#endif
+}
+
+__attribute__((always_inline)) inline auto fpExceptionWrite(uint64_t flags) -> void {
+#if defined(__aarch64__)
+	asm volatile("msr fpsr, %0" : : "r"(flags) : "memory");
+#else
+	__builtin_ia32_ldmxcsr(static_cast<uint32_t>(flags));
+#endif
+}
+
+// Maps the cumulative host flags onto the exception flags of the status word.
+constexpr auto fpExceptionStatusWord(uint64_t flags) -> uint16_t {
+#if defined(__aarch64__)
+	// IOC is bit 0 like IE, DZC to IXC sit one bit below ZE to PE, IDC is DE
+	return static_cast<uint16_t>((flags & 0x01) | ((flags & 0x1E) << 1) | ((flags >> 6) & 0x02));
+#else
+	// MXCSR uses the x87 layout
+	return static_cast<uint16_t>(flags & 0x3F);
+#endif
+}
+
+// Maps the exception flags of the status word onto the cumulative host flags.
+constexpr auto fpExceptionHostFlags(uint16_t statusWord) -> uint64_t {
+#if defined(__aarch64__)
+	return (statusWord & 0x01) | ((statusWord >> 1) & 0x1E) | (static_cast<uint64_t>(statusWord & 0x02) << 6);
+#else
+	return statusWord & 0x3F;
+#endif
+}
+
+// Handlers whose double arithmetic or conversions can raise exceptions. The
+// compares set their flags explicitly, and the host compares would report
+// invalid for quiet NaNs that fucom accepts.
+constexpr auto fpExceptionTracked(X87HandlerId id) -> bool {
+	switch (id) {
+	case X87HandlerId::x87_f2xm1:
+	case X87HandlerId::x87_fadd_ST:
+	case X87HandlerId::x87_fadd_f32:
+	case X87HandlerId::x87_fadd_f64:
+	case X87HandlerId::x87_fcos:
+	case X87HandlerId::x87_fdiv_ST:
+	case X87HandlerId::x87_fdiv_f32:
+	case X87HandlerId::x87_fdiv_f64:
+	case X87HandlerId::x87_fdivr_ST:
+	case X87HandlerId::x87_fdivr_f32:
+	case X87HandlerId::x87_fdivr_f64:
+	case X87HandlerId::x87_fiadd:
+	case X87HandlerId::x87_fidiv:
+	case X87HandlerId::x87_fidivr:
+	case X87HandlerId::x87_fimul:
+	case X87HandlerId::x87_fist_i16:
+	case X87HandlerId::x87_fist_i32:
+	case X87HandlerId::x87_fist_i64:
+	case X87HandlerId::x87_fistt_i16:
+	case X87HandlerId::x87_fistt_i32:
+	case X87HandlerId::x87_fistt_i64:
+	case X87HandlerId::x87_fisub:
+	case X87HandlerId::x87_fisubr:
+	case X87HandlerId::x87_fld_fp32:
+	case X87HandlerId::x87_fmul_ST:
+	case X87HandlerId::x87_fmul_f32:
+	case X87HandlerId::x87_fmul_f64:
+	case X87HandlerId::x87_fpatan:
+	case X87HandlerId::x87_fprem:
+	case X87HandlerId::x87_fprem1:
+	case X87HandlerId::x87_fptan:
+	case X87HandlerId::x87_frndint:
+	case X87HandlerId::x87_fscale:
+	case X87HandlerId::x87_fsin:
+	case X87HandlerId::x87_fsincos:
+	case X87HandlerId::x87_fsqrt:
+	case X87HandlerId::x87_fst_fp32:
+	case X87HandlerId::x87_fsub_ST:
+	case X87HandlerId::x87_fsub_f32:
+	case X87HandlerId::x87_fsub_f64:
+	case X87HandlerId::x87_fsubr_ST:
+	case X87HandlerId::x87_fsubr_f32:
+	case X87HandlerId::x87_fsubr_f64:
+	case X87HandlerId::x87_fxtract:
+	case X87HandlerId::x87_fyl2x:
+	case X87HandlerId::x87_fyl2xp1:
+		return true;
+	default:
+		return false;
+	}
+}
+
+#if defined(X87_IEEE_EXCEPTIONS)
+
+#include "SIMDGuard.h"
+
+template <X87HandlerId kId, auto kHandler>
+struct FPExceptionHandler;
+
+template <X87HandlerId kId, typename Return, typename State, typename... Args, Return (*kHandler)(State *, Args...)>
+struct FPExceptionHandler<kId, kHandler> {
+	static auto call(State *state, Args... args) -> Return {
+		// like the trace recorder, the wrapper is not covered by the handler's
+		// own mask
+		SIMDGuardMask<0, SIMDGuardMasks<kId>::kGPR> simdGuard;
+
+		const auto saved = fpExceptionRead();
+		const auto cleared = saved & ~(kFPExceptionFlags & ~fpExceptionHostFlags(state->statusWord));
+		if (cleared != saved) {
+			fpExceptionWrite(cleared);
+		}
+
+		if constexpr (std::is_void_v<Return>) {
+			kHandler(state, args...);
+			const auto raised = fpExceptionRead();
+			if (raised != saved) {
+				fpExceptionWrite(saved);
+			}
+			state->statusWord |= fpExceptionStatusWord(raised);
+		} else {
+			auto result = kHandler(state, args...);
+			const auto raised = fpExceptionRead();
+			if (raised != saved) {
+				fpExceptionWrite(saved);
+			}
+			// stores report their status word in the result
+			if constexpr (requires { result.statusWord; }) {
+				result.statusWord |= fpExceptionStatusWord(raised);
+			} else {
+				state->statusWord |= fpExceptionStatusWord(raised);
+			}
+			return result;
+		}
+	}
+};
+
+// The handler to dispatch to, wrapped if it is tracked.
+template <X87HandlerId kId, auto kHandler>
+constexpr auto fpExceptionHandler() {
+	if constexpr (fpExceptionTracked(kId)) {
+		return &FPExceptionHandler<kId, kHandler>::call;
+	} else {
+		return kHandler;
+	}
+}
+
+#endif
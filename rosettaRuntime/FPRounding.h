@@ -0,0 +1,191 @@
+#pragma once
+
+// Rounding control for the native handlers. With ROSETTA_X87_ROUNDING_CONTROL
+// (defines X87_ROUNDING_CONTROL) the dispatch slots call the handlers that
+// round through FPRoundingHandler, which runs them with the rounding mode of
+// the host FPCR (MXCSR on x86 hosts) set to the rounding control of the
+// control word. The arithmetic then rounds like the x87 does, and frndint and
+// fist round with a single instruction instead of switching over the modes.
+//
+// fldcw is translated inline, so nothing runs when the control word changes,
+// and the FPCR cannot keep the x87 mode between handlers, the translated SSE
+// code in between rounds with it too. The wrapper compares the two modes on
+// every call instead and only writes the FPCR when they differ, setting it back
+// afterwards. Programs that keep rounding to nearest only pay for the read.
+//
+// The transcendental handlers are not wrapped, their kernels and the
+// double-double division and square root of the exact handlers rely on
+// rounding to nearest.
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+#if !defined(__aarch64__)
+#include <emmintrin.h>
+#endif
+
+#include "FPExceptions.h"
+#include "X87.h"
+#include "X87State.h"
+
+#if defined(__aarch64__)
+// FPCR RMode
+constexpr uint64_t kFPRoundingMask = 0x00C00000;
+#else
+// MXCSR RC
+constexpr uint64_t kFPRoundingMask = 0x6000;
+#endif
+
+__attribute__((always_inline)) inline auto fpRoundingRead() -> uint64_t {
+#if defined(__aarch64__)
+	uint64_t fpcr;
+	asm volatile("mrs %0, fpcr" : "=r"(fpcr) : : "memory");
+	return fpcr;
+#else
+	return __builtin_ia32_stmxcsr();
+#endif
+}
+
+__attribute__((always_inline)) inline auto fpRoundingWrite(uint64_t control) -> void {
+#if defined(__aarch64__)
+	asm volatile("msr fpcr, %0" : : "r"(control) : "memory");
+#else
+	__builtin_ia32_ldmxcsr(static_cast<uint32_t>(control));
+#endif
+}
+
+// Maps the rounding control of the control word onto the host rounding mode.
+constexpr auto fpRoundingMode(uint16_t controlWord) -> uint64_t {
+#if defined(__aarch64__)
+	// RMode swaps down (01 on the x87) and up (10)
+	const uint64_t roundingControl = (controlWord >> 10) & 3;
+	return (((roundingControl & 1) << 1) | (roundingControl >> 1)) << 22;
+#else
+	// MXCSR uses the x87 encoding
+	return static_cast<uint64_t>(controlWord & X87ControlWord::kRoundingControlMask) << 3;
+#endif
+}
+
+// Rounds to an integer in the host rounding mode, frintx and fcvtzs on AArch64
+// and a single cvtsd2si on x86.
+__attribute__((always_inline)) inline auto fpRoundToInteger(double value) -> int64_t {
+#if defined(__aarch64__)
+	return static_cast<int64_t>(std::rint(value));
+#else
+	return _mm_cvtsd_si64(_mm_set_sd(value));
+#endif
+}
+
+// Rounds to an integral double in the host rounding mode, frintx on AArch64.
+// Compilers expand rint on x86 into additions on the magnitude that only hold
+// for rounding to nearest, so values that fit an integer go through cvtsd2si.
+__attribute__((always_inline)) inline auto fpRoundToIntegral(double value) -> double {
+#if defined(__aarch64__)
+	return std::rint(value);
+#else
+	if (!(std::fabs(value) < 0x1p52)) {
+		return value;
+	}
+	return std::copysign(static_cast<double>(_mm_cvtsd_si64(_mm_set_sd(value))), value);
+#endif
+}
+
+// Handlers whose results depend on the rounding mode.
+constexpr auto fpRoundingTracked(X87HandlerId id) -> bool {
+	switch (id) {
+	case X87HandlerId::x87_fadd_ST:
+	case X87HandlerId::x87_fadd_f32:
+	case X87HandlerId::x87_fadd_f64:
+	case X87HandlerId::x87_fdiv_ST:
+	case X87HandlerId::x87_fdiv_f32:
+	case X87HandlerId::x87_fdiv_f64:
+	case X87HandlerId::x87_fdivr_ST:
+	case X87HandlerId::x87_fdivr_f32:
+	case X87HandlerId::x87_fdivr_f64:
+	case X87HandlerId::x87_fiadd:
+	case X87HandlerId::x87_fidiv:
+	case X87HandlerId::x87_fidivr:
+	case X87HandlerId::x87_fimul:
+	case X87HandlerId::x87_fist_i16:
+	case X87HandlerId::x87_fist_i32:
+	case X87HandlerId::x87_fist_i64:
+	case X87HandlerId::x87_fisub:
+	case X87HandlerId::x87_fisubr:
+	case X87HandlerId::x87_fmul_ST:
+	case X87HandlerId::x87_fmul_f32:
+	case X87HandlerId::x87_fmul_f64:
+	case X87HandlerId::x87_frndint:
+	case X87HandlerId::x87_fsqrt:
+	case X87HandlerId::x87_fst_fp32:
+	case X87HandlerId::x87_fsub_ST:
+	case X87HandlerId::x87_fsub_f32:
+	case X87HandlerId::x87_fsub_f64:
+	case X87HandlerId::x87_fsubr_ST:
+	case X87HandlerId::x87_fsubr_f32:
+	case X87HandlerId::x87_fsubr_f64:
+		return true;
+	default:
+		return false;
+	}
+}
+
+#if defined(X87_ROUNDING_CONTROL)
+
+#include "SIMDGuard.h"
+
+template <X87HandlerId kId, auto kHandler>
+struct FPRoundingHandler;
+
+template <X87HandlerId kId, typename Return, typename State, typename... Args, Return (*kHandler)(State *, Args...)>
+struct FPRoundingHandler<kId, kHandler> {
+	static auto call(State *state, Args... args) -> Return {
+		// like the trace recorder, the wrapper is not covered by the handler's
+		// own mask
+		SIMDGuardMask<0, SIMDGuardMasks<kId>::kGPR> simdGuard;
+
+		const auto saved = fpRoundingRead();
+		const auto wanted = (saved & ~kFPRoundingMask) | fpRoundingMode(state->controlWord);
+		if (wanted == saved) [[likely]] {
+			return kHandler(state, args...);
+		}
+
+		fpRoundingWrite(wanted);
+		if constexpr (std::is_void_v<Return>) {
+			kHandler(state, args...);
+			fpRoundingWrite(saved);
+		} else {
+			auto result = kHandler(state, args...);
+			fpRoundingWrite(saved);
+			return result;
+		}
+	}
+};
+
+// The handler to dispatch to, wrapped if it is tracked.
+template <X87HandlerId kId, auto kHandler>
+constexpr auto fpRoundingHandler() {
+	if constexpr (fpRoundingTracked(kId)) {
+		return &FPRoundingHandler<kId, kHandler>::call;
+	} else {
+		return kHandler;
+	}
+}
+
+#endif
+
+// A native handler as the dispatch slots call it, through the wrappers the
+// build enables. The host tools use it to run handlers like the runtime does.
+template <X87HandlerId kId, auto kHandler>
+constexpr auto fpEnvironmentHandler() {
+#if defined(X87_IEEE_EXCEPTIONS)
+	constexpr auto exceptions = fpExceptionHandler<kId, kHandler>();
+#else
+	constexpr auto exceptions = kHandler;
+#endif
+#if defined(X87_ROUNDING_CONTROL)
+	return fpRoundingHandler<kId, exceptions>();
+#else
+	return exceptions;
+#endif
+}
@@ -0,0 +1,115 @@
+#include "HandlerConfig.h"
+#include "Export.h"
+#include "Log.h"
+#include "X87State.h"
+
+// this is filled in by loader with the contents of ROSETTA_X87_HANDLERS
+RUNTIME_DATA_SECTION("config") char kHandlerConfig[256] = {0};
+
+// Compares the range [begin, end) with a zero terminated string.
+static auto rangeEquals(const char *begin, const char *end, const char *str) -> bool {
+	while (begin != end && *str != '\0' && *begin == *str) {
+		begin++;
+		str++;
+	}
+	return begin == end && *str == '\0';
+}
+
+static auto ruleMatchesHandler(const char *begin, const char *end, const char *name) -> bool {
+	if (end - begin == 1 && *begin == '*') {
+		return true;
+	}
+	if (rangeEquals(begin, end, name)) {
+		return true;
+	}
+	// allow the handler name without its x87_ prefix
+	return name[0] == 'x' && name[1] == '8' && name[2] == '7' && name[3] == '_' && rangeEquals(begin, end, name + 4);
+}
+
+static auto parseMode(const char *begin, const char *end, X87HandlerMode *mode) -> bool {
+	if (rangeEquals(begin, end, "fast")) {
+		*mode = X87HandlerMode::kFast;
+	} else if (rangeEquals(begin, end, "exact")) {
+		*mode = X87HandlerMode::kExact;
+	} else if (rangeEquals(begin, end, "rosetta")) {
+		*mode = X87HandlerMode::kRosetta;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// Calls callback(name, nameEnd, mode, modeEnd) for every "name=mode" rule.
+template <typename Callback>
+static auto forEachRule(Callback callback) -> void {
+	const char *ptr = kHandlerConfig;
+	const char *limit = kHandlerConfig + sizeof(kHandlerConfig);
+
+	while (ptr < limit && *ptr != '\0') {
+		const char *ruleEnd = ptr;
+		while (ruleEnd < limit && *ruleEnd != '\0' && *ruleEnd != ',') {
+			ruleEnd++;
+		}
+
+		const char *separator = ptr;
+		while (separator < ruleEnd && *separator != '=') {
+			separator++;
+		}
+
+		callback(ptr, separator, separator < ruleEnd ? separator + 1 : ruleEnd, ruleEnd);
+
+		ptr = ruleEnd;
+		if (ptr < limit && *ptr == ',') {
+			ptr++;
+		}
+	}
+}
+
+auto handlerConfigMode(const char *name) -> X87HandlerMode {
+	auto mode = X87HandlerMode::kFast;
+
+	forEachRule([&](const char *ruleName, const char *ruleNameEnd, const char *ruleMode, const char *ruleModeEnd) {
+		X87HandlerMode parsed;
+		if (ruleMatchesHandler(ruleName, ruleNameEnd, name) && parseMode(ruleMode, ruleModeEnd, &parsed)) {
+			mode = parsed;
+		}
+	});
+
+	return mode;
+}
+
+auto handlerConfigValidate() -> void {
+	forEachRule([](const char *ruleName, const char *, const char *ruleMode, const char *ruleModeEnd) {
+		X87HandlerMode parsed;
+		if (!parseMode(ruleMode, ruleModeEnd, &parsed)) {
+			simplePrintf("ROSETTA_X87_HANDLERS: ignoring invalid rule '");
+			syscallWrite(STDERR_FILENO, ruleName, ruleModeEnd - ruleName);
+			simplePrintf("' (expected <handler>=fast|exact|rosetta)\n");
+		}
+	});
+}
+
+auto handlerConfigSelect(const char *name, void *fast, [[maybe_unused]] void *exact, [[maybe_unused]] void *rosetta) -> void * {
+	auto mode = handlerConfigMode(name);
+	if (mode == X87HandlerMode::kFast) {
+		return fast;
+	}
+
+#if !defined(X87_CONVERT_TO_FP80)
+	// Rosetta handlers expect the FP80 register layout
+	simplePrintf("%s: %s mode requires X87_CONVERT_TO_FP80, using fast\n", name, mode == X87HandlerMode::kRosetta ? "rosetta" : "exact");
+	return fast;
+#else
+	if (mode == X87HandlerMode::kExact && exact != nullptr) {
+		return exact;
+	}
+
+	if (rosetta == nullptr) {
+		simplePrintf("%s: not exported by this Rosetta version, using fast\n", name);
+		return fast;
+	}
+
+	// Rosetta's own handler is exact as well
+	return rosetta;
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Per handler selection between the native and the original Rosetta
+// implementation. The loader copies ROSETTA_X87_HANDLERS into kHandlerConfig,
+// e.g. "*=fast,fsin=rosetta,fcos=rosetta". Rules are applied left to right,
+// so later rules override earlier ones. Handler names may be given with or
+// without the x87_ prefix, '*' matches every handler.
+
+enum class X87HandlerMode : uint8_t {
+	kFast = 0,    // native handler computing in double precision
+	kExact = 1,   // native 80 bit handler (X87Exact.h), Rosetta's own if there is none
+	kRosetta = 2, // original Rosetta handler
+};
+
+// this is filled in by loader with the contents of ROSETTA_X87_HANDLERS
+extern char kHandlerConfig[256];
+
+// Returns the mode configured for the handler called `name` (e.g. "x87_fsin").
+extern auto handlerConfigMode(const char *name) -> X87HandlerMode;
+
+// Reports rules with an unknown mode, called once from init_library.
+extern auto handlerConfigValidate() -> void;
+
+// Picks the implementation the dispatch slot of handler `name` should point to.
+// exact is nullptr for handlers without a native exact implementation. Falls back to the fast handler when the Rosetta one is not
+// available.
+extern auto handlerConfigSelect(const char *name, void *fast, void *exact, void *rosetta) -> void *;
@@ -1,8 +1,10 @@
 #include "Log.h"
 
 #include <cmath>
+#include <fcntl.h>
 
 auto syscallWrite(int fd, const char *buf, uint64_t count) -> uint64_t {
+#if defined(__APPLE__) && defined(__aarch64__)
 	register uint64_t x0 __asm__("x0") = fd;
 	register uint64_t x1 __asm__("x1") = (uint64_t)buf;
 	register uint64_t x2 __asm__("x2") = count;
@@ -17,6 +19,31 @@ auto syscallWrite(int fd, const char *buf, uint64_t count) -> uint64_t {
 		: "memory");
 
 	return x0;
+#else
+	// host builds link against libc
+	return write(fd, buf, count);
+#endif
+}
+
+auto syscallOpen(const char *path, int flags, int mode) -> int {
+#if defined(__APPLE__) && defined(__aarch64__)
+	register uint64_t x0 __asm__("x0") = (uint64_t)path;
+	register uint64_t x1 __asm__("x1") = flags;
+	register uint64_t x2 __asm__("x2") = mode;
+	register uint64_t x16 __asm__("x16") = 398; // SYS_open_nocancel
+
+	asm volatile(
+		"svc #0x80\n"
+		"mov x1, #-1\n"
+		"csel x0, x1, x0, cs\n"
+		: "+r"(x0)
+		: "r"(x1), "r"(x2), "r"(x16)
+		: "memory");
+
+	return (int)x0;
+#else
+	return open(path, flags, mode);
+#endif
 }
 
 __attribute__((no_stack_protector, optnone)) void simplePrintf(const char *format, ...) {
@@ -134,18 +161,19 @@ __attribute__((no_stack_protector, optnone)) void simplePrintf(const char *forma
 			case 'l': {
 				++ptr; // Skip 'l'
 				if (*ptr == 'd') {
-					d = va_arg(args, long long);
-					char numBuf[20];
+					// keep all 64 bits, d is only an int
+					int64_t ld = va_arg(args, long long);
+					char numBuf[21];
 					char *numPtr = numBuf + sizeof(numBuf) - 1;
 					*numPtr = '\0';
-					if (d < 0) {
+					if (ld < 0) {
 						*bufPtr++ = '-';
-						d = -d;
+						ld = -ld;
 					}
 					do {
-						*--numPtr = '0' + (d % 10);
-						d /= 10;
-					} while (d != 0);
+						*--numPtr = '0' + (ld % 10);
+						ld /= 10;
+					} while (ld != 0);
 					while (*numPtr != '\0') {
 						*bufPtr++ = *numPtr++;
 					}
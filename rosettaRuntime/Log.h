@@ -18,4 +18,7 @@
 
 extern auto syscallWrite(int fd, const char *buf, uint64_t count) -> uint64_t;
 
+// Returns the file descriptor, or -1 on failure.
+extern auto syscallOpen(const char *path, int flags, int mode) -> int;
+
 extern void simplePrintf(const char *format, ...);
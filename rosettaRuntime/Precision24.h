@@ -0,0 +1,120 @@
+#pragma once
+
+// Transcendental kernels for states with 24 bit precision control. The x87
+// computes transcendentals to full precision regardless of the control word,
+// but a program running with 24 bit precision rounds everything it does with
+// the results to single precision, so low degree polynomials that are accurate
+// to a single precision ulp are enough. All kernels evaluate in double, the
+// callers keep arguments outside a kernel's domain on the openlibm path.
+
+#include <bit>
+#include <cstdint>
+
+#include "openlibm/k_cosf.h"
+#include "openlibm/k_sinf.h"
+
+// Largest |x| the two constant reduction by pi/2 handles, n * kPio2Hi is exact
+// for n < 2^20.
+constexpr double kPrecision24MaxAngle = 0x1p19 * 1.57079632679489661923;
+
+// Returns the quadrant and the reduced argument in [-pi/4, pi/4].
+__attribute__((always_inline)) inline auto reducePio2Precision24(double x, double *reduced) -> int32_t {
+	constexpr double kInvPio2 = 6.36619772367581382433e-01; // 0x3FE45F30, 0x6DC9C883
+	constexpr double kPio2Hi = 1.57079632673412561417e+00;  // first 33 bits of pi/2
+	constexpr double kPio2Lo = 6.07710050650619224932e-11;  // pi/2 - kPio2Hi
+	constexpr double kToInt = 0x1.8p52;
+
+	// round to nearest integer without a libm call
+	const double n = (x * kInvPio2 + kToInt) - kToInt;
+	*reduced = (x - n * kPio2Hi) - n * kPio2Lo;
+	return static_cast<int32_t>(n);
+}
+
+// sin and cos of x for |x| <= kPrecision24MaxAngle. Both kernels are cheap
+// enough to always evaluate, the quadrant only selects and negates them, which
+// avoids mispredicted branches on arbitrary angles.
+__attribute__((always_inline)) inline auto sinCosPrecision24(double x, double *sn, double *cs) -> void {
+	double r;
+	const auto quadrant = static_cast<uint64_t>(reducePio2Precision24(x, &r));
+	const double s = __kernel_sindf(r);
+	const double c = __kernel_cosdf(r);
+
+	// odd quadrants swap sin and cos, sin is negated in quadrants 2 and 3, cos
+	// in quadrants 1 and 2. Selecting with masks keeps the compiler from turning
+	// the selection back into a branch.
+	const uint64_t sBits = std::bit_cast<uint64_t>(s);
+	const uint64_t cBits = std::bit_cast<uint64_t>(c);
+	const uint64_t swap = (sBits ^ cBits) & (0 - (quadrant & 1));
+	const uint64_t sinSign = (quadrant & 2) << 62;
+	const uint64_t cosSign = ((quadrant + 1) & 2) << 62;
+	*sn = std::bit_cast<double>(sBits ^ swap ^ sinSign);
+	*cs = std::bit_cast<double>(cBits ^ swap ^ cosSign);
+}
+
+// 2^x - 1 for |x| <= 1, from 2^(k/16) and a degree 4 polynomial of 2^r - 1 on
+// |r| <= 1/32. The polynomial is used alone for |x| < 1/32, so small results
+// keep their relative precision.
+__attribute__((always_inline)) inline auto exp2m1Precision24(double x) -> double {
+	static constexpr double kExp2Table[33] = {
+		0.5, 0.52213689121370688, 0.54525386633262884, 0.56939431737834578,
+		0.59460355750136051, 0.620928906036742, 0.64841977732550482, 0.67712777346844633,
+		0.70710678118654757, 0.73841307296974967, 0.77110541270397037, 0.80524516597462714,
+		0.8408964152537145, 0.87812608018664973, 0.91700404320467122, 0.9576032806985737,
+		1.0, 1.0442737824274138, 1.0905077326652577, 1.1387886347566916,
+		1.189207115002721, 1.241857812073484, 1.2968395546510096, 1.3542555469368927,
+		1.4142135623730951, 1.4768261459394993, 1.5422108254079407, 1.6104903319492543,
+		1.681792830507429, 1.7562521603732995, 1.8340080864093424, 1.9152065613971474,
+		2.0,
+	};
+	// ln(2)^i / i!
+	constexpr double P1 = 0.6931471805599453;
+	constexpr double P2 = 0.2402265069591007;
+	constexpr double P3 = 0.055504108664821576;
+	constexpr double P4 = 0.009618129107628477;
+	constexpr double kToInt = 0x1.8p52;
+
+	const double k = (x * 16.0 + kToInt) - kToInt;
+	const double r = x - k * 0.0625;
+	const double p = r * (P1 + r * (P2 + r * (P3 + r * P4)));
+
+	// 2^x - 1 = t * (2^r - 1) + (t - 1), t - 1 is exact
+	const double t = kExp2Table[static_cast<int32_t>(k) + 16];
+	return t * p + (t - 1.0);
+}
+
+// log2(1 + f) for |f| <= 1 - sqrt(1/2), using s = f / (2 + f) and
+// log(1 + f) = 2s + 2s^3/3 + ... + 2s^9/9.
+__attribute__((always_inline)) inline auto log2p1Precision24(double f) -> double {
+	constexpr double kInvLn2 = 1.4426950408889634;
+	constexpr double L1 = 2.0 / 3.0;
+	constexpr double L2 = 2.0 / 5.0;
+	constexpr double L3 = 2.0 / 7.0;
+	constexpr double L4 = 2.0 / 9.0;
+
+	const double s = f / (2.0 + f);
+	const double z = s * s;
+	return s * (2.0 + z * (L1 + z * (L2 + z * (L3 + z * L4)))) * kInvLn2;
+}
+
+// log2(x) for positive normal x, or false for anything else.
+__attribute__((always_inline)) inline auto log2Precision24(double x, double *result) -> bool {
+	auto bits = std::bit_cast<uint64_t>(x);
+	const int32_t biased = static_cast<int32_t>(bits >> 52);
+	// zero, subnormals, negative values, infinities and NaNs
+	if (biased <= 0 || biased >= 0x7FF) {
+		return false;
+	}
+
+	// x = 2^e * m with m in [sqrt(1/2), sqrt(2))
+	int32_t e = biased - 1023;
+	bits &= 0x000FFFFFFFFFFFFFULL;
+	if (bits > 0x6A09E667F3BCDULL) {
+		bits |= 0x3FE0000000000000ULL;
+		e++;
+	} else {
+		bits |= 0x3FF0000000000000ULL;
+	}
+
+	*result = e + log2p1Precision24(std::bit_cast<double>(bits) - 1.0);
+	return true;
+}
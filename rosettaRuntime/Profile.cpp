@@ -0,0 +1,65 @@
+#include "Profile.h"
+
+#if defined(X87_PROFILE)
+
+#include "Log.h"
+
+ProfileCounters kProfileCounters[kProfileShards][static_cast<size_t>(X87HandlerId::kCount)];
+uint64_t kProfileNextReport;
+
+static auto profileNextDeadline(uint64_t now) -> uint64_t {
+#if defined(__aarch64__)
+	// report every 10 seconds
+	uint64_t frequency;
+	asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+	return now + frequency * 10;
+#else
+	// the host harness calls profileReport itself
+	return UINT64_MAX;
+#endif
+}
+
+static auto profileReportHandler(const char *name, X87HandlerId id) -> void {
+	ProfileCounters total = {};
+	for (uint32_t shard = 0; shard < kProfileShards; shard++) {
+		const auto &counters = kProfileCounters[shard][static_cast<size_t>(id)];
+		total.calls += __atomic_load_n(&counters.calls, __ATOMIC_RELAXED);
+		for (uint32_t bucket = 0; bucket < kProfileBuckets; bucket++) {
+			total.histogram[bucket] += __atomic_load_n(&counters.histogram[bucket], __ATOMIC_RELAXED);
+		}
+	}
+
+	if (total.calls == 0) {
+		return;
+	}
+
+	simplePrintf("%s %ld", name, total.calls);
+	for (uint32_t bucket = 0; bucket < kProfileBuckets; bucket++) {
+		if (total.histogram[bucket] != 0) {
+			simplePrintf(" %d:%ld", bucket, total.histogram[bucket]);
+		}
+	}
+	simplePrintf("\n");
+}
+
+auto profileReport() -> void {
+	simplePrintf("x87 handler profile: <handler> <calls> <log2 ticks bucket>:<calls>...\n");
+
+#define X87_PROFILE_REPORT(RETURN, NAME, ARGS) profileReportHandler(#NAME, X87HandlerId::NAME);
+	X87_HANDLER_LIST(X87_PROFILE_REPORT)
+#undef X87_PROFILE_REPORT
+}
+
+auto profileReportDue(uint64_t now, uint64_t due) -> void {
+	// only the thread that moves the deadline forward reports
+	if (!__atomic_compare_exchange_n(&kProfileNextReport, &due, profileNextDeadline(now), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	// the first call only arms the deadline
+	if (due != 0) {
+		profileReport();
+	}
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+// Opt-in per handler call counters and latency histograms. Enable with the
+// ROSETTA_X87_PROFILE CMake option (defines X87_PROFILE). Every native handler
+// then counts its calls and the log2 bucket of the timer ticks it took, and
+// the aggregated table is written to stderr through syscallWrite.
+//
+// The runtime image has no dyld and therefore no thread_local storage, so the
+// counters are sharded by a hash of the thread pointer instead and updated
+// with relaxed atomics. Threads rarely share a shard, keeping the cache lines
+// uncontended.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "X87.h"
+
+// Also used by the trace recorder (Trace.h).
+__attribute__((always_inline)) inline auto profileTicks() -> uint64_t {
+#if defined(__aarch64__)
+	uint64_t ticks;
+	asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+	return ticks;
+#else
+	return __builtin_ia32_rdtsc();
+#endif
+}
+
+// Identifies the calling thread in place of thread_local storage.
+__attribute__((always_inline)) inline auto profileThreadPointer() -> uint64_t {
+#if defined(__APPLE__) && defined(__aarch64__)
+	uint64_t threadPointer;
+	asm("mrs %0, tpidrro_el0" : "=r"(threadPointer));
+	return threadPointer;
+#else
+	return reinterpret_cast<uint64_t>(__builtin_thread_pointer());
+#endif
+}
+
+#if defined(X87_PROFILE)
+
+constexpr uint32_t kProfileShardBits = 4;
+constexpr uint32_t kProfileShards = 1u << kProfileShardBits;
+constexpr uint32_t kProfileBuckets = 16; // bucket i counts calls of [2^(i-1), 2^i) ticks
+
+struct ProfileCounters {
+	uint64_t calls;
+	uint64_t histogram[kProfileBuckets];
+};
+
+extern ProfileCounters kProfileCounters[kProfileShards][static_cast<size_t>(X87HandlerId::kCount)];
+
+// Timer value at which the next periodic report is due, 0 before the first call.
+extern uint64_t kProfileNextReport;
+
+// Writes the table aggregated over all shards to stderr.
+extern auto profileReport() -> void;
+
+// The runtime has no hook that runs at process exit, so the table is reported
+// periodically instead. Called once kProfileNextReport is due.
+extern auto profileReportDue(uint64_t now, uint64_t due) -> void;
+
+__attribute__((always_inline)) inline auto profileShard() -> uint32_t {
+	return (profileThreadPointer() * 0x9E3779B97F4A7C15ULL) >> (64 - kProfileShardBits);
+}
+
+struct ProfileScope {
+	__attribute__((always_inline)) explicit ProfileScope(X87HandlerId id) : id_(id), start_(profileTicks()) {}
+
+	__attribute__((always_inline)) ~ProfileScope() {
+		const auto end = profileTicks();
+		const auto ticks = end - start_;
+		const uint32_t bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+
+		auto &counters = kProfileCounters[profileShard()][static_cast<size_t>(id_)];
+		__atomic_fetch_add(&counters.calls, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&counters.histogram[bucket < kProfileBuckets ? bucket : kProfileBuckets - 1], 1, __ATOMIC_RELAXED);
+
+		const auto due = __atomic_load_n(&kProfileNextReport, __ATOMIC_RELAXED);
+		if (__builtin_expect(end >= due, 0)) {
+			profileReportDue(end, due);
+		}
+	}
+
+	X87HandlerId id_;
+	uint64_t start_;
+};
+
+#define X87_PROFILE_SCOPE(NAME) ProfileScope profileScope(X87HandlerId::NAME)
+
+#else
+
+#define X87_PROFILE_SCOPE(NAME) ((void)0)
+
+#endif
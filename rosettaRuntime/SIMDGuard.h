@@ -1,150 +1,247 @@
 #pragma once
 
-// most x87 instruction handlers only use d0-d3 registers, so backing all up is
-// too much of a penalty. Only sin/cos/log2/exp require a full backup of the
-// simd registers. Anything above d7 handled by the compiler. This assumption
-// was made by staring at disassembled code.
-
+// Handlers must preserve the vector and general registers Rosetta keeps guest
+// state in, but saving all of them on every call is too much of a penalty. Each
+// handler saves exactly the registers in its mask from SIMDGuardMasks.h, which
+// tools/simd_guard_masks.py generates from the disassembled runtime. The same
+// script checks every build for handlers clobbering a register their mask does
+// not cover. It only fails the build once the header carries its generated
+// marker; the masks checked in are seed values matching the old hand-picked
+// guards, so until they are generated on arm64 the check only warns.
+
+#include <bit>
 #include <cstdint>
+#include <utility>
 
-#define ENABLE_SIMD_GUARD
-
-struct SIMDGuard {
-	using SIMDRegister_t = uint8_t[8];
+#include "SIMDGuardMasks.h"
+#include "X87.h"
 
-	SIMDGuard() {
-#if defined(ENABLE_SIMD_GUARD)
-		// Save q0–q3 in pairs into buf
-		asm volatile("stp  q0,  q1, [%0, # 0]\n\t"
-		             "stp  q2,  q3, [%0, #32]\n\t"
-		             : // no outputs
-		             : "r"(buf)
-		             : "memory");
+// host builds (X87_HOST) call the handlers like any other function
+#if !defined(X87_HOST)
+#define ENABLE_SIMD_GUARD
 #endif
-	}
 
-	~SIMDGuard() {
 #if defined(ENABLE_SIMD_GUARD)
-		// Restore q0–q3 in reverse order
-		asm volatile("ldp  q2,  q3, [%0, #32]\n\t"
-		             "ldp  q0,  q1, [%0, # 0]\n\t"
-		             :
-		             : "r"(buf)
-		             : "v0", "v1", "v2", "v3", "memory");
+// The register number has to be part of the instruction text, so every
+// register (and every even/odd pair sharing a stp/ldp) gets its own
+// specialization. Offsets are relative to the guard buffer.
+template <uint32_t kIndex>
+struct SIMDVector;
+template <uint32_t kIndex>
+struct SIMDVectorPair;
+template <uint32_t kIndex>
+struct SIMDGPR;
+template <uint32_t kIndex>
+struct SIMDGPRPair;
+
+#define SIMD_VECTOR(N)                                                                                  \
+	template <>                                                                                     \
+	struct SIMDVector<N> {                                                                          \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto save(uint8_t *buf) -> void {                 \
+			asm volatile("str q" #N ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "memory");   \
+		}                                                                                       \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto restore(uint8_t *buf) -> void {              \
+			asm volatile("ldr q" #N ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "v" #N, "memory"); \
+		}                                                                                       \
+	};
+
+#define SIMD_VECTOR_PAIR(N, M)                                                                          \
+	template <>                                                                                     \
+	struct SIMDVectorPair<N> {                                                                      \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto save(uint8_t *buf) -> void {                 \
+			asm volatile("stp q" #N ", q" #M ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "memory"); \
+		}                                                                                       \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto restore(uint8_t *buf) -> void {              \
+			asm volatile("ldp q" #N ", q" #M ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "v" #N, "v" #M, "memory"); \
+		}                                                                                       \
+	};
+
+#define SIMD_GPR(N)                                                                                     \
+	template <>                                                                                     \
+	struct SIMDGPR<N> {                                                                             \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto save(uint8_t *buf) -> void {                 \
+			asm volatile("str x" #N ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "memory");   \
+		}                                                                                       \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto restore(uint8_t *buf) -> void {              \
+			asm volatile("ldr x" #N ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "x" #N, "memory"); \
+		}                                                                                       \
+	};
+
+#define SIMD_GPR_PAIR(N, M)                                                                             \
+	template <>                                                                                     \
+	struct SIMDGPRPair<N> {                                                                         \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto save(uint8_t *buf) -> void {                 \
+			asm volatile("stp x" #N ", x" #M ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "memory"); \
+		}                                                                                       \
+		template <uint32_t kOffset>                                                             \
+		__attribute__((always_inline)) static auto restore(uint8_t *buf) -> void {              \
+			asm volatile("ldp x" #N ", x" #M ", [%0, #%1]" : : "r"(buf), "i"(kOffset) : "x" #N, "x" #M, "memory"); \
+		}                                                                                       \
+	};
+
+#define SIMD_VECTOR_PAIRS(N, M) SIMD_VECTOR(N) SIMD_VECTOR(M) SIMD_VECTOR_PAIR(N, M)
+#define SIMD_GPR_PAIRS(N, M) SIMD_GPR(N) SIMD_GPR(M) SIMD_GPR_PAIR(N, M)
+
+SIMD_VECTOR_PAIRS(0, 1)
+SIMD_VECTOR_PAIRS(2, 3)
+SIMD_VECTOR_PAIRS(4, 5)
+SIMD_VECTOR_PAIRS(6, 7)
+SIMD_VECTOR_PAIRS(8, 9)
+SIMD_VECTOR_PAIRS(10, 11)
+SIMD_VECTOR_PAIRS(12, 13)
+SIMD_VECTOR_PAIRS(14, 15)
+SIMD_VECTOR_PAIRS(16, 17)
+SIMD_VECTOR_PAIRS(18, 19)
+SIMD_VECTOR_PAIRS(20, 21)
+SIMD_VECTOR_PAIRS(22, 23)
+SIMD_VECTOR_PAIRS(24, 25)
+SIMD_VECTOR_PAIRS(26, 27)
+SIMD_VECTOR_PAIRS(28, 29)
+SIMD_VECTOR_PAIRS(30, 31)
+
+// x18 is the platform register on Darwin and never touched by the compiler
+SIMD_GPR_PAIRS(0, 1)
+SIMD_GPR_PAIRS(2, 3)
+SIMD_GPR_PAIRS(4, 5)
+SIMD_GPR_PAIRS(6, 7)
+SIMD_GPR_PAIRS(8, 9)
+SIMD_GPR_PAIRS(10, 11)
+SIMD_GPR_PAIRS(12, 13)
+SIMD_GPR_PAIRS(14, 15)
+SIMD_GPR_PAIRS(16, 17)
+
+#undef SIMD_VECTOR_PAIRS
+#undef SIMD_GPR_PAIRS
+#undef SIMD_VECTOR
+#undef SIMD_VECTOR_PAIR
+#undef SIMD_GPR
+#undef SIMD_GPR_PAIR
 #endif
-	}
 
-	alignas(16) uint8_t buf[16][4];
-};
+// Saves the vector registers in kVectorMask (bit i = q_i) and the general
+// registers in kGPRMask (bit i = x_i) on construction and restores them in
+// reverse order on destruction.
+template <uint32_t kVectorMask, uint32_t kGPRMask>
+struct SIMDGuardMask {
+	static_assert((kGPRMask & ~0x3FFFFu) == 0, "only x0-x17 can be saved");
 
-struct SIMDGuardAndX0X7 {
-	using SIMDRegister_t = uint8_t[8];
+	// general registers first, keeping every stp/ldp offset in range
+	static constexpr uint32_t kGPRBytes = (std::popcount(kGPRMask) * 8 + 15) & ~15u;
+	static constexpr uint32_t kBufferBytes = kGPRBytes + std::popcount(kVectorMask) * 16;
 
-	SIMDGuardAndX0X7() {
+	SIMDGuardMask() {
 #if defined(ENABLE_SIMD_GUARD)
-		// Save q0–q3 in pairs into buf
-		// Save x0–x7 in pairs into buf
-		asm volatile("stp  q0,  q1, [%0, #  0]\n\t"
-		             "stp  q2,  q3, [%0, # 32]\n\t"
-		             "stp  x0,  x1, [%0, # 64]\n\t"
-		             "stp  x2,  x3, [%0, # 80]\n\t"
-		             "stp  x4,  x5, [%0, # 96]\n\t"
-		             "stp  x6,  x7, [%0, #112]\n\t"
-		             : // no outputs
-		             : "r"(buf)
-		             : "memory");
+		saveAll(std::make_integer_sequence<uint32_t, 16>());
 #endif
 	}
 
-	~SIMDGuardAndX0X7() {
+	~SIMDGuardMask() {
 #if defined(ENABLE_SIMD_GUARD)
-		// Restore x0–x7 in reverse order
-		// Restore q0–q3 in reverse order
-		asm volatile("ldp  x6,  x7, [%0, #112]\n\t"
-		             "ldp  x4,  x5, [%0, # 96]\n\t"
-		             "ldp  x2,  x3, [%0, # 80]\n\t"
-		             "ldp  x0,  x1, [%0, # 64]\n\t"
-		             "ldp  q2,  q3, [%0, # 32]\n\t"
-		             "ldp  q0,  q1, [%0, #  0]\n\t"
-		             :
-		             : "r"(buf)
-		             : "v0", "v1", "v2", "v3", "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "memory");
+		restoreAll(std::make_integer_sequence<uint32_t, 16>());
 #endif
 	}
 
-	alignas(16) uint8_t buf[16][8];
-};
-
-struct SIMDGuardFull {
-	using SIMDRegister_t = uint8_t[8];
-
-	SIMDGuardFull() {
 #if defined(ENABLE_SIMD_GUARD)
-		// Save q0–q7 in pairs into buf
-		asm volatile("stp  q0,  q1, [%0, # 0]\n\t"
-		             "stp  q2,  q3, [%0, #32]\n\t"
-		             "stp  q4,  q5, [%0, #64]\n\t"
-		             "stp  q6,  q7, [%0, #96]\n\t"
-		             : // no outputs
-		             : "r"(buf)
-		             : "memory");
-#endif
+	// Registers are packed in ascending order.
+	static constexpr auto gprOffset(uint32_t index) -> uint32_t {
+		return std::popcount(kGPRMask & ((1u << index) - 1)) * 8;
 	}
 
-	~SIMDGuardFull() {
-#if defined(ENABLE_SIMD_GUARD)
-		// Restore q0–q7 in reverse order
-		asm volatile("ldp  q6,  q7, [%0, #96]\n\t"
-		             "ldp  q4,  q5, [%0, #64]\n\t"
-		             "ldp  q2,  q3, [%0, #32]\n\t"
-		             "ldp  q0,  q1, [%0, # 0]\n\t"
-		             :
-		             : "r"(buf)
-		             : "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "memory");
-#endif
+	static constexpr auto vectorOffset(uint32_t index) -> uint32_t {
+		return kGPRBytes + std::popcount(kVectorMask & ((1u << index) - 1)) * 16;
 	}
 
-	alignas(16) uint8_t buf[16][8];
-};
+	template <uint32_t kPair>
+	__attribute__((always_inline)) auto savePair() -> void {
+		constexpr uint32_t even = kPair * 2;
+		constexpr uint32_t vectors = (kVectorMask >> even) & 3;
+		constexpr uint32_t gprs = (kGPRMask >> even) & 3;
+
+		if constexpr (vectors == 3) {
+			SIMDVectorPair<even>::template save<vectorOffset(even)>(buf);
+		} else if constexpr (vectors == 1) {
+			SIMDVector<even>::template save<vectorOffset(even)>(buf);
+		} else if constexpr (vectors == 2) {
+			SIMDVector<even + 1>::template save<vectorOffset(even + 1)>(buf);
+		}
+
+		if constexpr (gprs == 3) {
+			SIMDGPRPair<even>::template save<gprOffset(even)>(buf);
+		} else if constexpr (gprs == 1) {
+			SIMDGPR<even>::template save<gprOffset(even)>(buf);
+		} else if constexpr (gprs == 2) {
+			SIMDGPR<even + 1>::template save<gprOffset(even + 1)>(buf);
+		}
+	}
 
-struct SIMDGuardFullAndX0X7 {
-	using SIMDRegister_t = uint8_t[8];
+	template <uint32_t kPair>
+	__attribute__((always_inline)) auto restorePair() -> void {
+		constexpr uint32_t even = kPair * 2;
+		constexpr uint32_t vectors = (kVectorMask >> even) & 3;
+		constexpr uint32_t gprs = (kGPRMask >> even) & 3;
+
+		if constexpr (gprs == 3) {
+			SIMDGPRPair<even>::template restore<gprOffset(even)>(buf);
+		} else if constexpr (gprs == 1) {
+			SIMDGPR<even>::template restore<gprOffset(even)>(buf);
+		} else if constexpr (gprs == 2) {
+			SIMDGPR<even + 1>::template restore<gprOffset(even + 1)>(buf);
+		}
+
+		if constexpr (vectors == 3) {
+			SIMDVectorPair<even>::template restore<vectorOffset(even)>(buf);
+		} else if constexpr (vectors == 1) {
+			SIMDVector<even>::template restore<vectorOffset(even)>(buf);
+		} else if constexpr (vectors == 2) {
+			SIMDVector<even + 1>::template restore<vectorOffset(even + 1)>(buf);
+		}
+	}
 
-	SIMDGuardFullAndX0X7() {
-#if defined(ENABLE_SIMD_GUARD)
-		// Save q0–q7 in pairs into buf
-		// Save x0–x7 in pairs into buf
-		asm volatile("stp  q0,  q1, [%0, #  0]\n\t"
-		             "stp  q2,  q3, [%0, # 32]\n\t"
-		             "stp  q4,  q5, [%0, # 64]\n\t"
-		             "stp  q6,  q7, [%0, # 96]\n\t"
-		             "stp  x0,  x1, [%0, #128]\n\t"
-		             "stp  x2,  x3, [%0, #144]\n\t"
-		             "stp  x4,  x5, [%0, #160]\n\t"
-		             "stp  x6,  x7, [%0, #176]\n\t"
-		             : // no outputs
-		             : "r"(buf)
-		             : "memory");
-#endif
+	template <uint32_t... kPairs>
+	__attribute__((always_inline)) auto saveAll(std::integer_sequence<uint32_t, kPairs...>) -> void {
+		(savePair<kPairs>(), ...);
 	}
 
-	~SIMDGuardFullAndX0X7() {
-#if defined(ENABLE_SIMD_GUARD)
-		// Restore x0–x7 in reverse order
-		// Restore q0–q7 in reverse order
-		asm volatile("ldp  x6,  x7, [%0, #176]\n\t"
-		             "ldp  x4,  x5, [%0, #160]\n\t"
-		             "ldp  x2,  x3, [%0, #144]\n\t"
-		             "ldp  x0,  x1, [%0, #128]\n\t"
-		             "ldp  q6,  q7, [%0, # 96]\n\t"
-		             "ldp  q4,  q5, [%0, # 64]\n\t"
-		             "ldp  q2,  q3, [%0, # 32]\n\t"
-		             "ldp  q0,  q1, [%0, #  0]\n\t"
-		             :
-		             : "r"(buf)
-		             : "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "memory");
-#endif
+	template <uint32_t... kPairs>
+	__attribute__((always_inline)) auto restoreAll(std::integer_sequence<uint32_t, kPairs...>) -> void {
+		(restorePair<sizeof...(kPairs) - 1 - kPairs>(), ...);
 	}
+#endif
 
-	alignas(16) uint8_t buf[16][12];
+	alignas(16) uint8_t buf[kBufferBytes > 0 ? kBufferBytes : 16];
 };
+
+// Hand picked sets for code outside the handler list.
+using SIMDGuard = SIMDGuardMask<0x0F, 0x00>;
+using SIMDGuardFull = SIMDGuardMask<0xFF, 0x00>;
+
+template <X87HandlerId kId>
+struct SIMDGuardMasks;
+
+#define X87_SIMD_GUARD_MASK(NAME, VECTOR, GPR)                  \
+	template <>                                             \
+	struct SIMDGuardMasks<X87HandlerId::NAME> {             \
+		static constexpr uint32_t kVector = VECTOR;     \
+		static constexpr uint32_t kGPR = GPR;           \
+	};
+X87_SIMD_GUARD_MASKS(X87_SIMD_GUARD_MASK)
+#undef X87_SIMD_GUARD_MASK
+
+// Analysis builds (ROSETTA_X87_SIMD_GUARD_ANALYZE) save nothing, so that the
+// disassembly shows only the registers the handler bodies clobber.
+#if defined(X87_SIMD_GUARD_ANALYZE)
+template <X87HandlerId kId>
+using SIMDGuardFor = SIMDGuardMask<0, 0>;
+#else
+template <X87HandlerId kId>
+using SIMDGuardFor = SIMDGuardMask<SIMDGuardMasks<kId>::kVector, SIMDGuardMasks<kId>::kGPR>;
+#endif
+
+#define X87_SIMD_GUARD(NAME) SIMDGuardFor<X87HandlerId::NAME> simdGuard
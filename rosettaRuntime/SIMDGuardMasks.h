@@ -0,0 +1,78 @@
+#pragma once
+
+// Seed values picked by hand from the handler sources, not yet generated by
+// tools/simd_guard_masks.py. Until they are regenerated from a runtime built
+// with ROSETTA_X87_SIMD_GUARD_ANALYZE the build only warns about clobbers they
+// miss.
+//
+// X(handler, vector registers q0-q31, general registers x0-x17)
+#define X87_SIMD_GUARD_MASKS(X) \
+	X(x87_f2xm1, 0x000000FF, 0x00000) \
+	X(x87_fabs, 0x0000000F, 0x00000) \
+	X(x87_fadd_ST, 0x0000000F, 0x00000) \
+	X(x87_fadd_f32, 0x0000000F, 0x00000) \
+	X(x87_fadd_f64, 0x0000000F, 0x00000) \
+	X(x87_fbld, 0x0000000F, 0x00000) \
+	X(x87_fbstp, 0x0000000F, 0x000FC) \
+	X(x87_fchs, 0x0000000F, 0x00000) \
+	X(x87_fcmov, 0x0000000F, 0x00000) \
+	X(x87_fcom_ST, 0x0000000F, 0x00000) \
+	X(x87_fcom_f32, 0x0000000F, 0x00000) \
+	X(x87_fcom_f64, 0x0000000F, 0x00000) \
+	X(x87_fcomi, 0x0000000F, 0x00000) \
+	X(x87_fcos, 0x000000FF, 0x000FF) \
+	X(x87_fdecstp, 0x00000000, 0x00000) \
+	X(x87_fdiv_ST, 0x0000000F, 0x00000) \
+	X(x87_fdiv_f32, 0x0000000F, 0x00000) \
+	X(x87_fdiv_f64, 0x0000000F, 0x00000) \
+	X(x87_fdivr_ST, 0x0000000F, 0x00000) \
+	X(x87_fdivr_f32, 0x0000000F, 0x00000) \
+	X(x87_fdivr_f64, 0x0000000F, 0x00000) \
+	X(x87_fiadd, 0x0000000F, 0x00000) \
+	X(x87_ficom, 0x0000000F, 0x00000) \
+	X(x87_fidiv, 0x0000000F, 0x00000) \
+	X(x87_fidivr, 0x0000000F, 0x00000) \
+	X(x87_fild, 0x0000000F, 0x00000) \
+	X(x87_fimul, 0x0000000F, 0x00000) \
+	X(x87_fist_i16, 0x0000000F, 0x00000) \
+	X(x87_fist_i32, 0x0000000F, 0x00000) \
+	X(x87_fist_i64, 0x0000000F, 0x00000) \
+	X(x87_fistt_i16, 0x0000000F, 0x00000) \
+	X(x87_fistt_i32, 0x0000000F, 0x00000) \
+	X(x87_fistt_i64, 0x0000000F, 0x00000) \
+	X(x87_fisub, 0x0000000F, 0x00000) \
+	X(x87_fisubr, 0x0000000F, 0x00000) \
+	X(x87_fld_STi, 0x0000000F, 0x00000) \
+	X(x87_fld_constant, 0x0000000F, 0x00000) \
+	X(x87_fld_fp32, 0x0000000F, 0x00000) \
+	X(x87_fld_fp64, 0x0000000F, 0x00000) \
+	X(x87_fld_fp80, 0x0000000F, 0x00000) \
+	X(x87_fmul_ST, 0x0000000F, 0x00000) \
+	X(x87_fmul_f32, 0x0000000F, 0x00000) \
+	X(x87_fmul_f64, 0x0000000F, 0x00000) \
+	X(x87_fpatan, 0x000000FF, 0x00000) \
+	X(x87_fprem, 0x0000000F, 0x000FF) \
+	X(x87_fprem1, 0x0000000F, 0x000FF) \
+	X(x87_fptan, 0x000000FF, 0x000FF) \
+	X(x87_frndint, 0x0000000F, 0x00000) \
+	X(x87_fscale, 0x0000000F, 0x00000) \
+	X(x87_fsin, 0x000000FF, 0x000FF) \
+	X(x87_fsincos, 0x000000FF, 0x000FF) \
+	X(x87_fsqrt, 0x0000000F, 0x00000) \
+	X(x87_fst_STi, 0x0000000F, 0x00000) \
+	X(x87_fst_fp32, 0x0000000F, 0x00000) \
+	X(x87_fst_fp64, 0x0000000F, 0x00000) \
+	X(x87_fst_fp80, 0x0000000F, 0x00000) \
+	X(x87_fsub_ST, 0x0000000F, 0x00000) \
+	X(x87_fsub_f32, 0x0000000F, 0x00000) \
+	X(x87_fsub_f64, 0x0000000F, 0x00000) \
+	X(x87_fsubr_ST, 0x0000000F, 0x00000) \
+	X(x87_fsubr_f32, 0x0000000F, 0x00000) \
+	X(x87_fsubr_f64, 0x0000000F, 0x00000) \
+	X(x87_fucom, 0x0000000F, 0x00000) \
+	X(x87_fucomi, 0x0000000F, 0x00000) \
+	X(x87_fxam, 0x0000000F, 0x00000) \
+	X(x87_fxch, 0x0000000F, 0x00000) \
+	X(x87_fxtract, 0x000000FF, 0x00000) \
+	X(x87_fyl2x, 0x000000FF, 0x00000) \
+	X(x87_fyl2xp1, 0x000000FF, 0x00000)
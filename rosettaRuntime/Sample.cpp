@@ -0,0 +1,370 @@
+#include "Sample.h"
+#include "Export.h"
+
+// this is filled in by loader with the contents of ROSETTA_X87_SAMPLE
+RUNTIME_DATA_SECTION("sample") char kSamplePath[256] = {0};
+
+#if defined(X87_SAMPLE)
+
+#include "Log.h"
+
+#include <fcntl.h>
+
+// Guest addresses of the modules and translations in flight, keyed by their
+// pointer. A later translation hashing to the same slot overwrites the entry.
+constexpr uint32_t kSamplePendingBits = 8;
+
+struct SamplePending {
+	uint64_t key;
+	uint64_t address;
+};
+
+// Where the JIT placed the code translated from a guest address. The table
+// wraps around, overwriting the oldest translations.
+constexpr uint32_t kSampleTranslationBits = 16;
+constexpr uint32_t kSampleTranslationCount = 1u << kSampleTranslationBits;
+
+struct SampleTranslation {
+	uint64_t code;
+	uint64_t size;
+	uint64_t address;
+};
+
+// Call sites, keyed by return address with the handler id in the top byte.
+constexpr uint32_t kSampleSiteBits = 13;
+constexpr uint32_t kSampleSiteCount = 1u << kSampleSiteBits;
+constexpr uint32_t kSampleSiteProbes = 64;
+
+struct SampleSite {
+	uint64_t key;
+	uint64_t ticks;
+	uint64_t reportedTicks; // only touched by the reporting thread
+};
+
+SampleCountdown kSampleCountdowns[kSampleShards];
+
+static SamplePending kSamplePending[1u << kSamplePendingBits];
+static SampleTranslation kSampleTranslations[kSampleTranslationCount];
+static uint64_t kSampleTranslationNext;
+static SampleSite kSampleSites[kSampleSiteCount];
+static uint64_t kSampleDropped;
+static uint64_t kSampleNextReport;
+static int kSampleFd = -1;
+
+static auto samplePendingSlot(const void *key) -> SamplePending & {
+	return kSamplePending[(reinterpret_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> (64 - kSamplePendingBits)];
+}
+
+static auto samplePendingStore(const void *key, uint64_t address) -> void {
+	auto &slot = samplePendingSlot(key);
+	__atomic_store_n(&slot.key, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot.address, address, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot.key, reinterpret_cast<uint64_t>(key), __ATOMIC_RELEASE);
+}
+
+// The guest address stored for key, 0 if the slot was taken over since.
+static auto samplePendingLoad(const void *key) -> uint64_t {
+	auto &slot = samplePendingSlot(key);
+	if (__atomic_load_n(&slot.key, __ATOMIC_ACQUIRE) != reinterpret_cast<uint64_t>(key)) {
+		return 0;
+	}
+	const auto address = __atomic_load_n(&slot.address, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&slot.key, __ATOMIC_RELAXED) == reinterpret_cast<uint64_t>(key) ? address : 0;
+}
+
+auto sampleIrCreated(uint64_t address, ModuleResult const *module) -> void {
+	// x0 and x1 are saved by the trampoline, the vector return registers here
+	SIMDGuardFull simdGuard;
+
+	if (kSampleFd >= 0) {
+		samplePendingStore(module, address);
+	}
+}
+
+auto sampleTranslated(ModuleResult const *module, TranslationResult const *result) -> void {
+	SIMDGuardFull simdGuard;
+
+	const auto address = kSampleFd >= 0 ? samplePendingLoad(module) : 0;
+	if (address != 0) {
+		samplePendingStore(result, address);
+	}
+}
+
+auto sampleFixupsApplying(TranslationResult const *result, uint8_t const *code) -> void {
+	// the argument registers are saved by the trampoline, vector arguments here
+	SIMDGuardFull simdGuard;
+
+	const auto address = kSampleFd >= 0 ? samplePendingLoad(result) : 0;
+	if (address != 0) {
+		const auto getSize = reinterpret_cast<auto (*)(TranslationResult const *)->uint64_t>(orig_translator_get_size);
+		auto &translation = kSampleTranslations[__atomic_fetch_add(&kSampleTranslationNext, 1, __ATOMIC_RELAXED) & (kSampleTranslationCount - 1)];
+		__atomic_store_n(&translation.code, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&translation.size, getSize(result), __ATOMIC_RELAXED);
+		__atomic_store_n(&translation.address, address, __ATOMIC_RELAXED);
+		__atomic_store_n(&translation.code, reinterpret_cast<uint64_t>(code), __ATOMIC_RELEASE);
+	}
+}
+
+#if defined(X87_HOST)
+// There is no Rosetta to intercept in host builds.
+void sampleIrCreate() {
+	__builtin_trap();
+}
+
+void sampleTranslatorTranslate() {
+	__builtin_trap();
+}
+
+void sampleTranslatorApplyFixups() {
+	__builtin_trap();
+}
+#else
+// Calls the original, then HOOK with the first argument and x0. x0 and x1 are
+// returned unchanged, as are the vector registers, which HOOK saves.
+#define X87_SAMPLE_AFTER(NAME, ORIGINAL, HOOK)                                   \
+	__attribute__((naked, used)) void NAME() {                               \
+		asm volatile("stp x29, x30, [sp, #-48]!\n"                       \
+		             "mov x29, sp\n"                                     \
+		             "str x0, [sp, #16]\n"                               \
+		             "adrp x16, _" #ORIGINAL "@PAGE\n"                   \
+		             "ldr x16, [x16, _" #ORIGINAL "@PAGEOFF]\n"          \
+		             "blr x16\n"                                         \
+		             "stp x0, x1, [sp, #32]\n"                           \
+		             "mov x1, x0\n"                                      \
+		             "ldr x0, [sp, #16]\n"                               \
+		             "bl _" #HOOK "\n"                                   \
+		             "ldp x0, x1, [sp, #32]\n"                           \
+		             "ldp x29, x30, [sp], #48\n"                         \
+		             "ret");                                             \
+	}
+
+X87_SAMPLE_AFTER(sampleIrCreate, orig_ir_create, sampleIrCreated)
+X87_SAMPLE_AFTER(sampleTranslatorTranslate, orig_translator_translate, sampleTranslated)
+#undef X87_SAMPLE_AFTER
+
+// Calls sampleFixupsApplying with the first two arguments, then branches to the
+// original with x0-x8 and the vector registers as they came in.
+__attribute__((naked, used)) void sampleTranslatorApplyFixups() {
+	asm volatile("stp x29, x30, [sp, #-96]!\n"
+	             "mov x29, sp\n"
+	             "stp x0, x1, [sp, #16]\n"
+	             "stp x2, x3, [sp, #32]\n"
+	             "stp x4, x5, [sp, #48]\n"
+	             "stp x6, x7, [sp, #64]\n"
+	             "str x8, [sp, #80]\n"
+	             "bl _sampleFixupsApplying\n"
+	             "ldp x0, x1, [sp, #16]\n"
+	             "ldp x2, x3, [sp, #32]\n"
+	             "ldp x4, x5, [sp, #48]\n"
+	             "ldp x6, x7, [sp, #64]\n"
+	             "ldr x8, [sp, #80]\n"
+	             "ldp x29, x30, [sp], #96\n"
+	             "adrp x16, _orig_translator_apply_fixups@PAGE\n"
+	             "ldr x16, [x16, _orig_translator_apply_fixups@PAGEOFF]\n"
+	             "br x16");
+}
+#endif
+
+auto sampleInit() -> bool {
+	if (kSamplePath[0] == '\0') {
+		return false;
+	}
+
+	kSampleFd = syscallOpen(kSamplePath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (kSampleFd < 0) {
+		simplePrintf("Failed to open sample file %s\n", kSamplePath);
+		return false;
+	}
+
+	simplePrintf("Sampling x87 handlers to %s\n", kSamplePath);
+	return true;
+}
+
+static auto sampleNextDeadline(uint64_t now) -> uint64_t {
+#if defined(__aarch64__)
+	// report every 10 seconds
+	uint64_t frequency;
+	asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+	return now + frequency * 10;
+#else
+	// the host harness calls sampleReport itself
+	return UINT64_MAX;
+#endif
+}
+
+static auto sampleReportDue(uint64_t now, uint64_t due) -> void {
+	// only the thread that moves the deadline forward reports
+	if (!__atomic_compare_exchange_n(&kSampleNextReport, &due, sampleNextDeadline(now), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	// the first call only arms the deadline
+	if (due != 0) {
+		sampleReport();
+	}
+}
+
+auto sampleRecord(uint64_t returnAddress, X87HandlerId id, uint64_t ticks) -> void {
+	const uint64_t key = returnAddress | (static_cast<uint64_t>(id) << 56);
+
+	uint32_t index = (key * 0x9E3779B97F4A7C15ULL) >> (64 - kSampleSiteBits);
+	for (uint32_t probe = 0; probe < kSampleSiteProbes; probe++, index = (index + 1) & (kSampleSiteCount - 1)) {
+		auto &site = kSampleSites[index];
+		auto siteKey = __atomic_load_n(&site.key, __ATOMIC_RELAXED);
+		if (siteKey == 0 && __atomic_compare_exchange_n(&site.key, &siteKey, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			siteKey = key;
+		}
+		if (siteKey == key) {
+			__atomic_fetch_add(&site.ticks, ticks, __ATOMIC_RELAXED);
+
+			const auto now = profileTicks();
+			const auto due = __atomic_load_n(&kSampleNextReport, __ATOMIC_RELAXED);
+			if (now >= due) {
+				sampleReportDue(now, due);
+			}
+			return;
+		}
+	}
+
+	// more call sites than the table holds
+	if (__atomic_fetch_add(&kSampleDropped, 1, __ATOMIC_RELAXED) == 0) {
+		simplePrintf("Sample sites exhausted, dropping samples\n");
+	}
+}
+
+static auto sampleHandlerName(X87HandlerId id) -> const char * {
+	switch (id) {
+#define X87_SAMPLE_NAME(RETURN, NAME, ARGS) \
+	case X87HandlerId::NAME:            \
+		return #NAME;
+		X87_HANDLER_LIST(X87_SAMPLE_NAME)
+#undef X87_SAMPLE_NAME
+	default:
+		return "unknown";
+	}
+}
+
+// Report output, written out whenever it fills up.
+static char kSampleOutput[16384];
+static uint32_t kSampleOutputLength;
+
+static auto sampleFlush() -> void {
+	syscallWrite(kSampleFd, kSampleOutput, kSampleOutputLength);
+	kSampleOutputLength = 0;
+}
+
+static auto sampleAppend(const char *text) -> void {
+	while (*text != '\0') {
+		kSampleOutput[kSampleOutputLength++] = *text++;
+	}
+}
+
+static auto sampleAppendNumber(uint64_t value, uint32_t base) -> void {
+	char digits[20];
+	uint32_t count = 0;
+	do {
+		const auto digit = static_cast<char>(value % base);
+		digits[count++] = digit < 10 ? '0' + digit : 'a' + (digit - 10);
+		value /= base;
+	} while (value != 0);
+
+	while (count > 0) {
+		kSampleOutput[kSampleOutputLength++] = digits[--count];
+	}
+}
+
+// Translations ordered by code address, rebuilt for every report.
+static uint32_t kSampleOrder[kSampleTranslationCount];
+
+static auto sampleSortTranslations() -> uint32_t {
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < kSampleTranslationCount; i++) {
+		if (__atomic_load_n(&kSampleTranslations[i].code, __ATOMIC_ACQUIRE) != 0) {
+			kSampleOrder[count++] = i;
+		}
+	}
+
+	// shell sort, the runtime has no library to sort with
+	for (uint32_t gap = count / 2; gap > 0; gap /= 2) {
+		for (uint32_t i = gap; i < count; i++) {
+			const auto index = kSampleOrder[i];
+			const auto code = kSampleTranslations[index].code;
+			uint32_t j = i;
+			for (; j >= gap && kSampleTranslations[kSampleOrder[j - gap]].code > code; j -= gap) {
+				kSampleOrder[j] = kSampleOrder[j - gap];
+			}
+			kSampleOrder[j] = index;
+		}
+	}
+	return count;
+}
+
+// The guest address of the translation containing the call before
+// returnAddress, 0 if the code was not translated by the JIT.
+static auto sampleGuestAddress(uint64_t returnAddress, uint32_t count) -> uint64_t {
+	const uint64_t call = returnAddress - 4;
+
+	// last translation starting at or before the call
+	uint32_t low = 0;
+	uint32_t high = count;
+	while (low < high) {
+		const uint32_t middle = (low + high) / 2;
+		if (kSampleTranslations[kSampleOrder[middle]].code <= call) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low == 0) {
+		return 0;
+	}
+
+	const auto &translation = kSampleTranslations[kSampleOrder[low - 1]];
+	return call - translation.code < translation.size ? translation.address : 0;
+}
+
+auto sampleReport() -> void {
+	if (kSampleFd < 0) {
+		return;
+	}
+
+	const uint32_t count = sampleSortTranslations();
+
+	// every report appends the ticks since the previous one, flamegraph.pl
+	// adds up the lines of the same stack
+	for (uint32_t i = 0; i < kSampleSiteCount; i++) {
+		auto &site = kSampleSites[i];
+		const auto key = __atomic_load_n(&site.key, __ATOMIC_RELAXED);
+		const auto ticks = __atomic_load_n(&site.ticks, __ATOMIC_RELAXED);
+		if (key == 0 || ticks == site.reportedTicks) {
+			continue;
+		}
+
+		const uint64_t returnAddress = key & ((1ULL << 56) - 1);
+		const auto address = sampleGuestAddress(returnAddress, count);
+		if (address != 0) {
+			sampleAppend("0x");
+			sampleAppendNumber(address, 16);
+		} else {
+			sampleAppend("[translated 0x");
+			sampleAppendNumber(returnAddress, 16);
+			sampleAppend("]");
+		}
+		sampleAppend(";");
+		sampleAppend(sampleHandlerName(static_cast<X87HandlerId>(key >> 56)));
+		sampleAppend(" ");
+		sampleAppendNumber(ticks - site.reportedTicks, 10);
+		sampleAppend("\n");
+		site.reportedTicks = ticks;
+
+		// a line takes at most 110 bytes
+		if (kSampleOutputLength > sizeof(kSampleOutput) - 128) {
+			sampleFlush();
+		}
+	}
+
+	sampleFlush();
+}
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+// Opt-in sampling profile attributing handler time to guest code. Enable with
+// the ROSETTA_X87_SAMPLE CMake option (defines X87_SAMPLE) and point the
+// ROSETTA_X87_SAMPLE environment variable at the output file. The dispatch
+// slots then call the handlers through SampleHandler, which times every
+// kSamplePeriod-th call of a thread and adds the ticks to its call site, the
+// return address into the translated code.
+//
+// Call sites are mapped back to guest addresses with the translations of
+// Rosetta's JIT: ir_create, translator_translate and translator_apply_fixups
+// are intercepted to remember which guest address the code placed at every
+// address was translated from. Only their arguments are known, from the
+// mangled names, so the interceptors are trampolines that pass the argument
+// registers to Rosetta and its return registers back unchanged and only read
+// the pointers they need. A call site reports the guest address its
+// translation starts at, the layout of translator_get_instruction_offsets is
+// not known. Code translated ahead of time is not seen and keeps its
+// translated address.
+//
+// Like the profile table, the samples are reported periodically as there is no
+// hook at process exit. Every report appends the ticks since the previous one,
+// one "<guest address>;<handler> <ticks>" line per call site and handler. This
+// is the folded stack format flamegraph.pl reads, which adds up the lines of
+// the same stack.
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "X87.h"
+
+#if defined(X87_SAMPLE)
+
+#include "Profile.h"
+#include "SIMDGuard.h"
+
+constexpr uint32_t kSampleShardBits = 4;
+constexpr uint32_t kSampleShards = 1u << kSampleShardBits;
+
+// prime, so that the sampled calls do not follow the period of a loop
+constexpr uint32_t kSamplePeriod = 1021;
+
+struct alignas(64) SampleCountdown {
+	uint32_t calls;
+};
+
+extern SampleCountdown kSampleCountdowns[kSampleShards];
+
+// Trampolines for Rosetta's translator calls, exported while sampling. ir_create
+// and translator_translate are observed after they return, with their first
+// argument and x0, translator_apply_fixups before it is entered, which then
+// returns straight to its caller.
+extern void sampleIrCreate();
+extern void sampleTranslatorTranslate();
+extern void sampleTranslatorApplyFixups();
+
+// Called by the trampolines. A module or translation is only assumed to be
+// returned in x0, anything else fails the lookups.
+extern "C" auto sampleIrCreated(uint64_t address, ModuleResult const *module) -> void;
+extern "C" auto sampleTranslated(ModuleResult const *module, TranslationResult const *result) -> void;
+extern "C" auto sampleFixupsApplying(TranslationResult const *result, uint8_t const *code) -> void;
+
+// Opens the file named by the loader, called once from init_library. The
+// handlers are only sampled if this succeeded.
+extern auto sampleInit() -> bool;
+
+// Adds the ticks of a sampled call to its call site.
+extern auto sampleRecord(uint64_t returnAddress, X87HandlerId id, uint64_t ticks) -> void;
+
+// Appends the folded stacks of the samples since the previous report.
+extern auto sampleReport() -> void;
+
+// Counts down the calls of the shard of the calling thread. Threads sharing a
+// shard can lose a decrement, which only stretches the period.
+__attribute__((always_inline)) inline auto sampleDue() -> bool {
+	auto &countdown = kSampleCountdowns[(profileThreadPointer() * 0x9E3779B97F4A7C15ULL) >> (64 - kSampleShardBits)];
+	const auto calls = __atomic_load_n(&countdown.calls, __ATOMIC_RELAXED);
+	if (calls > 1) [[likely]] {
+		__atomic_store_n(&countdown.calls, calls - 1, __ATOMIC_RELAXED);
+		return false;
+	}
+	__atomic_store_n(&countdown.calls, kSamplePeriod, __ATOMIC_RELAXED);
+	return true;
+}
+
+template <X87HandlerId kId, auto kHandler>
+struct SampleHandler;
+
+template <X87HandlerId kId, typename Return, typename State, typename... Args, Return (*kHandler)(State *, Args...)>
+struct SampleHandler<kId, kHandler> {
+	static auto call(State *state, Args... args) -> Return {
+		// like the trace recorder, the wrapper is not covered by the handler's
+		// own mask
+		SIMDGuardMask<0, SIMDGuardMasks<kId>::kGPR> simdGuard;
+
+		// the dispatch stubs branch without linking, x30 still points into the
+		// translated code
+		const auto returnAddress = reinterpret_cast<uint64_t>(__builtin_extract_return_addr(__builtin_return_address(0)));
+
+		if (!sampleDue()) [[likely]] {
+			return kHandler(state, args...);
+		}
+		return sampled(returnAddress, state, args...);
+	}
+
+	__attribute__((noinline)) static auto sampled(uint64_t returnAddress, State *state, Args... args) -> Return {
+		// the recording code is not covered either
+		SIMDGuardMask<0xFFFFFFFF, SIMDGuardMasks<kId>::kGPR> simdGuard;
+
+		const auto start = profileTicks();
+		if constexpr (std::is_void_v<Return>) {
+			kHandler(state, args...);
+			sampleRecord(returnAddress, kId, profileTicks() - start);
+		} else {
+			auto result = kHandler(state, args...);
+			sampleRecord(returnAddress, kId, profileTicks() - start);
+			return result;
+		}
+	}
+};
+
+#endif
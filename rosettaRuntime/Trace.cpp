@@ -0,0 +1,135 @@
+#include "Trace.h"
+#include "Export.h"
+
+// this is filled in by loader with the contents of ROSETTA_X87_TRACE
+RUNTIME_DATA_SECTION("trace") char kTracePath[256] = {0};
+
+#if defined(X87_TRACE)
+
+#include "Log.h"
+
+#include <fcntl.h>
+
+constexpr uint32_t kTraceRingBits = 4;
+constexpr uint32_t kTraceRings = 1u << kTraceRingBits;
+constexpr uint32_t kTraceRingRecords = 2048;
+
+// A ring belongs to a thread while it holds records of that thread that are
+// not written yet. The owner sets kTraceRingBusy while it appends.
+struct alignas(64) TraceRing {
+	uint64_t owner;     // thread pointer of the thread recording into this ring, 0 if free
+	uint64_t lastTicks; // profileTicks of the last append
+	uint32_t next;
+	TraceRecord records[kTraceRingRecords];
+};
+
+constexpr uint64_t kTraceRingBusy = 1;
+
+static TraceRing kTraceRingBuffers[kTraceRings];
+static int kTraceFd = -1;
+static uint64_t kTraceDropped;
+
+auto traceInit() -> bool {
+	if (kTracePath[0] == '\0') {
+		return false;
+	}
+
+	kTraceFd = syscallOpen(kTracePath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (kTraceFd < 0) {
+		simplePrintf("Failed to open trace file %s\n", kTracePath);
+		return false;
+	}
+
+	const TraceHeader header = {
+		{'X', '8', '7', 'T', 'R', 'A', 'C', 'E'},
+		kTraceVersion,
+		sizeof(TraceRecord),
+		static_cast<uint32_t>(X87HandlerId::kCount),
+		0,
+	};
+	syscallWrite(kTraceFd, reinterpret_cast<const char *>(&header), sizeof(header));
+
+	simplePrintf("Tracing x87 handlers to %s\n", kTracePath);
+	return true;
+}
+
+// Rings idle for this long are taken over by threads that find no free ring.
+static auto traceIdleTicks() -> uint64_t {
+#if defined(__aarch64__)
+	// one second
+	uint64_t frequency;
+	asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+	return frequency;
+#else
+	return 1ULL << 32;
+#endif
+}
+
+static auto traceLock(TraceRing &ring, uint64_t owner, uint64_t threadPointer) -> bool {
+	return __atomic_compare_exchange_n(&ring.owner, &owner, threadPointer | kTraceRingBusy, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// Locks the ring owned by the calling thread, or claims a free one. There is
+// no hook when a thread exits, so owners release their ring whenever they
+// write it out, and a thread that finds every ring owned takes over one that
+// has been idle for a while after writing out the records left in it.
+static auto traceAcquire(uint64_t threadPointer, uint64_t now) -> TraceRing * {
+	const uint32_t start = (threadPointer * 0x9E3779B97F4A7C15ULL) >> (64 - kTraceRingBits);
+	TraceRing *free = nullptr;
+	for (uint32_t i = 0; i < kTraceRings; i++) {
+		auto &ring = kTraceRingBuffers[(start + i) & (kTraceRings - 1)];
+		const auto owner = __atomic_load_n(&ring.owner, __ATOMIC_RELAXED);
+		if (owner == threadPointer && traceLock(ring, owner, threadPointer)) {
+			return &ring;
+		}
+		if (owner == 0 && free == nullptr) {
+			free = &ring;
+		}
+	}
+	// keep looking for an owned ring first, a thread never holds two
+	if (free != nullptr && traceLock(*free, 0, threadPointer)) {
+		return free;
+	}
+
+	const auto idleTicks = traceIdleTicks();
+	for (uint32_t i = 0; i < kTraceRings; i++) {
+		auto &ring = kTraceRingBuffers[(start + i) & (kTraceRings - 1)];
+		const auto owner = __atomic_load_n(&ring.owner, __ATOMIC_RELAXED);
+		if ((owner & kTraceRingBusy) != 0 || now - __atomic_load_n(&ring.lastTicks, __ATOMIC_RELAXED) < idleTicks || !traceLock(ring, owner, threadPointer)) {
+			continue;
+		}
+		if (ring.next != 0) {
+			syscallWrite(kTraceFd, reinterpret_cast<const char *>(ring.records), ring.next * sizeof(TraceRecord));
+			ring.next = 0;
+		}
+		return &ring;
+	}
+	return nullptr;
+}
+
+auto traceAppend(TraceRecord &record) -> void {
+	const auto threadPointer = profileThreadPointer();
+	const auto now = profileTicks();
+	auto ring = traceAcquire(threadPointer, now);
+	if (ring == nullptr) {
+		// more busy threads than rings
+		if (__atomic_fetch_add(&kTraceDropped, 1, __ATOMIC_RELAXED) == 0) {
+			simplePrintf("Trace rings exhausted, dropping records\n");
+		}
+		return;
+	}
+
+	record.ring = static_cast<uint8_t>(ring - kTraceRingBuffers);
+	ring->records[ring->next] = record;
+	__atomic_store_n(&ring->lastTicks, now, __ATOMIC_RELAXED);
+
+	if (++ring->next == kTraceRingRecords) {
+		syscallWrite(kTraceFd, reinterpret_cast<const char *>(ring->records), sizeof(ring->records));
+		ring->next = 0;
+		__atomic_store_n(&ring->owner, 0, __ATOMIC_RELEASE);
+		return;
+	}
+	__atomic_store_n(&ring->owner, threadPointer, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,222 @@
+#pragma once
+
+// Opt-in binary trace of every native handler call. Enable with the
+// ROSETTA_X87_TRACE CMake option (defines X87_TRACE) and point the
+// ROSETTA_X87_TRACE environment variable at the output file. The dispatch
+// slots then call the handlers through TraceHandler, which appends one
+// TraceRecord per call to a ring buffer owned by the calling thread.
+//
+// There is no thread_local storage or background thread in the runtime image,
+// so the rings are claimed by thread pointer like the profile shards, and a
+// thread writes out its ring with syscallWrite whenever it is full, one write
+// per 2048 calls, and releases it. Threads finding every ring owned take over
+// one idle for a second. Records still in a ring when the process exits are
+// lost, up to 2047 per ring.
+//
+// The file format is a TraceHeader followed by TraceRecords, with the records
+// of one thread in order. The record layout is shared with the offline tools.
+// Registers are stored in the layout of the build that captured them, 80 bit
+// values with X87_CONVERT_TO_FP80, so that those replay exactly.
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "X87.h"
+#include "X87State.h"
+
+struct TraceHeader {
+	char magic[8];         // "X87TRACE"
+	uint32_t version;      // kTraceVersion
+	uint32_t recordSize;   // sizeof(TraceRecord)
+	uint32_t handlerCount; // X87HandlerId::kCount, the ids follow X87_HANDLER_LIST
+	uint32_t reserved;
+};
+
+static_assert(sizeof(TraceHeader) == 24, "Invalid size for TraceHeader");
+
+constexpr uint32_t kTraceVersion = 2;
+constexpr uint32_t kTraceOperandSlots = 3;
+
+// How a record holds the registers in st and the result of void handlers.
+enum class TraceRegisterFormat : uint8_t {
+	kFloat64 = 0, // double bits, the exponent fields are zero
+	kFloat80 = 1, // the mantissa, with the sign and exponent in the exponent field
+};
+
+#if defined(X87_CONVERT_TO_FP80)
+constexpr auto kTraceRegisterFormat = TraceRegisterFormat::kFloat80;
+#else
+constexpr auto kTraceRegisterFormat = TraceRegisterFormat::kFloat64;
+#endif
+
+struct TraceRecord {
+	uint8_t handler;           // X87HandlerId
+	uint8_t ring;              // ring the record was captured in, held by one thread until written out
+	uint16_t controlWord;      // before the call
+	uint16_t statusWordIn;     // before the call, holds the stack top
+	uint16_t statusWordOut;    // after the call
+	uint16_t tagWordIn;        // before the call, as stored
+	uint8_t registerFormat;    // TraceRegisterFormat
+	uint8_t reserved;
+	uint32_t ticks;            // timer ticks the handler took
+	uint64_t operands[kTraceOperandSlots]; // arguments after the state, raw bits in 8 byte slots
+	uint64_t st[2];            // traceStOffsets registers before the call
+	uint64_t result;           // returned value (first 8 bytes), ST(0) after the call for void handlers
+	uint16_t stExponent[2];    // sign and exponent of st in kFloat80
+	uint16_t resultExponent;   // sign and exponent of the ST(0) result in kFloat80
+	uint16_t reserved2[5];
+};
+
+static_assert(sizeof(TraceRecord) == 80, "Invalid size for TraceRecord");
+
+// The registers a handler reads, ST(0) and ST(1) unless its operands name them.
+constexpr auto traceStOffsets(X87HandlerId id, const uint64_t *operands) -> std::pair<uint32_t, uint32_t> {
+	switch (id) {
+	case X87HandlerId::x87_fadd_ST:
+	case X87HandlerId::x87_fdiv_ST:
+	case X87HandlerId::x87_fdivr_ST:
+	case X87HandlerId::x87_fmul_ST:
+	case X87HandlerId::x87_fsub_ST:
+	case X87HandlerId::x87_fsubr_ST:
+		return {operands[0] & 7, operands[1] & 7};
+	case X87HandlerId::x87_fcom_ST:
+	case X87HandlerId::x87_fcomi:
+	case X87HandlerId::x87_fucom:
+	case X87HandlerId::x87_fucomi:
+	case X87HandlerId::x87_fld_STi:
+	case X87HandlerId::x87_fst_STi:
+	case X87HandlerId::x87_fxch:
+		return {0, operands[0] & 7};
+	case X87HandlerId::x87_fcmov:
+		return {0, operands[1] & 7};
+	default:
+		return {0, 1};
+	}
+}
+
+// Stores ST(stOffset) in the register format of the build.
+__attribute__((always_inline)) inline auto traceStoreRegister(const X87State *state, uint32_t stOffset, uint64_t &bits, uint16_t &exponent) -> void {
+#if defined(X87_CONVERT_TO_FP80)
+	const auto &value = state->st[state->getStIndex(stOffset)];
+	bits = value.mantissa;
+	exponent = value.exponent;
+#else
+	bits = std::bit_cast<uint64_t>(state->getStFast(stOffset));
+	exponent = 0;
+#endif
+}
+
+// A register stored in either format as an 80 bit value, which holds both
+// exactly.
+inline auto traceRegisterFloat80(TraceRegisterFormat format, uint64_t bits, uint16_t exponent) -> X87Float80 {
+	if (format == TraceRegisterFormat::kFloat80) {
+		return X87Float80{.mantissa = bits, .exponent = exponent};
+	}
+	return ConvertFloat64ToX87Register(std::bit_cast<double>(bits), nullptr);
+}
+
+// Loads a register stored in either format into ST(stOffset) and marks it
+// valid. Builds without X87_CONVERT_TO_FP80 round 80 bit values to double.
+inline auto traceLoadRegister(X87State *state, uint32_t stOffset, TraceRegisterFormat format, uint64_t bits, uint16_t exponent) -> void {
+#if defined(X87_CONVERT_TO_FP80)
+	state->setStFast(stOffset, 0.0);
+	state->st[state->getStIndex(stOffset)] = traceRegisterFloat80(format, bits, exponent);
+#else
+	state->setStFast(stOffset, format == TraceRegisterFormat::kFloat80 ? ConvertX87RegisterToFloat64(X87Float80{.mantissa = bits, .exponent = exponent}, nullptr)
+	                                                                 : std::bit_cast<double>(bits));
+#endif
+}
+
+// Operands take as many 8 byte slots as they need, in argument order.
+template <typename T>
+__attribute__((always_inline)) inline auto traceStoreOperand(uint64_t *operands, uint32_t &slot, const T &value) -> void {
+	constexpr uint32_t slots = (sizeof(T) + 7) / 8;
+	if (slot + slots <= kTraceOperandSlots) {
+		memcpy(&operands[slot], &value, sizeof(T));
+	}
+	slot += slots;
+}
+
+template <typename T>
+inline auto traceLoadOperand(const uint64_t *operands, uint32_t &slot) -> T {
+	constexpr uint32_t slots = (sizeof(T) + 7) / 8;
+	T value = {};
+	if (slot + slots <= kTraceOperandSlots) {
+		memcpy(&value, &operands[slot], sizeof(T));
+	}
+	slot += slots;
+	return value;
+}
+
+// Stores report their status word in the result, everything else in the state.
+template <typename Return>
+__attribute__((always_inline)) inline auto traceStoreResult(TraceRecord &record, const X87State *state, const Return &result) -> void {
+	memcpy(&record.result, &result, sizeof(result) < 8 ? sizeof(result) : 8);
+	if constexpr (requires { result.statusWord; }) {
+		record.statusWordOut = result.statusWord;
+	} else {
+		record.statusWordOut = state->statusWord;
+	}
+}
+
+__attribute__((always_inline)) inline auto traceStoreResult(TraceRecord &record, const X87State *state) -> void {
+	traceStoreRegister(state, 0, record.result, record.resultExponent);
+	record.statusWordOut = state->statusWord;
+}
+
+#if defined(X87_TRACE)
+
+#include "Profile.h"
+#include "SIMDGuard.h"
+
+// Opens the file named by the loader and writes the header, called once from
+// init_library. The handlers are only traced if this succeeded.
+extern auto traceInit() -> bool;
+
+// Copies the record into the ring of the calling thread.
+extern auto traceAppend(TraceRecord &record) -> void;
+
+template <X87HandlerId kId, auto kHandler>
+struct TraceHandler;
+
+template <X87HandlerId kId, typename Return, typename State, typename... Args, Return (*kHandler)(State *, Args...)>
+struct TraceHandler<kId, kHandler> {
+	static auto call(State *state, Args... args) -> Return {
+		// the recording code is not covered by the handler's own mask
+		SIMDGuardMask<0xFFFFFFFF, SIMDGuardMasks<kId>::kGPR> simdGuard;
+
+		TraceRecord record = {};
+		record.handler = static_cast<uint8_t>(kId);
+		record.registerFormat = static_cast<uint8_t>(kTraceRegisterFormat);
+		record.controlWord = state->controlWord;
+		record.statusWordIn = state->statusWord;
+		record.tagWordIn = state->tagWord;
+
+		uint32_t slot = 0;
+		(traceStoreOperand(record.operands, slot, args), ...);
+
+		const auto [first, second] = traceStOffsets(kId, record.operands);
+		traceStoreRegister(state, first, record.st[0], record.stExponent[0]);
+		traceStoreRegister(state, second, record.st[1], record.stExponent[1]);
+
+		const auto start = profileTicks();
+		if constexpr (std::is_void_v<Return>) {
+			kHandler(state, args...);
+			record.ticks = profileTicks() - start;
+			traceStoreResult(record, state);
+			traceAppend(record);
+		} else {
+			auto result = kHandler(state, args...);
+			record.ticks = profileTicks() - start;
+			traceStoreResult(record, state, result);
+			traceAppend(record);
+			return result;
+		}
+	}
+};
+
+#endif
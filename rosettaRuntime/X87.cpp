@@ -1,7 +1,14 @@
 #include "X87.h"
 #include "Export.h"
+#include "FPRounding.h"
+#include "X87Exact.h"
+#include "HandlerConfig.h"
 #include "Log.h"
+#include "Precision24.h"
+#include "Profile.h"
 #include "SIMDGuard.h"
+#include "Sample.h"
+#include "Trace.h"
 #include "X87State.h"
 #include "openlibm/s_tan.h"
 #include "openlibm/s_remquo.h"
@@ -10,6 +17,7 @@
 #include "openlibm/e_pow.h"
 #include "openlibm/s_cos.h"
 #include "openlibm/s_sin.h"
+#include "openlibm/s_sincos.h"
 #include "openlibm/s_atan.h"
 #include "openlibm/e_atan2.h"
 #include "openlibm/e_fmod.h"
@@ -17,125 +25,89 @@
 
 #include <cstring>
 
-#define X87_F2XM1
-#define X87_FABS
-#define X87_FADD_ST
-#define X87_FADD_F32
-#define X87_FADD_F64
-#define X87_FBLD
-#define X87_FBSTP
-#define X87_FCHS
-#define X87_FCMOV
-#define X87_FCOM_ST
-#define X87_FCOM_F32
-#define X87_FCOM_F64
-#define X87_FCOMI
-#define X87_FCOS
-#define X87_FDECSTP
-#define X87_FDIV_ST
-#define X87_FDIV_F32
-#define X87_FDIV_F64
-#define X87_FDIVR_ST
-#define X87_FDIVR_F32
-#define X87_FDIVR_F64
-#define X87_FFREE
-#define X87_FIADD
-#define X87_FICOM
-#define X87_FIDIV
-#define X87_FIDIVR
-#define X87_FILD
-#define X87_FIMUL
-#define X87_FINCSTP
-#define X87_FIST_I16
-#define X87_FIST_I32
-#define X87_FIST_I64
-#define X87_FISTT_I16
-#define X87_FISTT_I32
-#define X87_FISTT_I64
-#define X87_FISUB
-#define X87_FISUBR
-#define X87_FLD_STI
-#define X87_FLD_CONSTANT
-#define X87_FLD_FP32
-#define X87_FLD_FP64
-#define X87_FLD_FP80
-#define X87_FMUL_ST
-#define X87_FMUL_F32
-#define X87_FMUL_F64
-#define X87_FPATAN
-#define X87_FPREM
-#define X87_FPREM1
-#define X87_FPTAN
-#define X87_FRNDINT
-#define X87_FSCALE
-#define X87_FSIN
-#define X87_FSINCOS
-#define X87_FSQRT
-#define X87_FST_STI
-#define X87_FST_FP32
-#define X87_FST_FP64
-#define X87_FST_FP80
-#define X87_FSUB_ST
-#define X87_FSUB_F32
-#define X87_FSUB_F64
-#define X87_FSUBR_ST
-#define X87_FSUBR_F32
-#define X87_FSUBR_F64
-#define X87_FUCOM
-#define X87_FUCOMI
-#define X87_FXAM
-#define X87_FXCH
-#define X87_FXTRACT
-#define X87_FYL2X
-#define X87_FYL2XP1
-
-#define X87_TRAMPOLINE(NAME, REGISTER)                                         \
-	void __attribute__((naked, used)) NAME() {                             \
-		asm volatile("adrp " #REGISTER ", _orig_" #NAME "@PAGE\n"      \
-		             "ldr " #REGISTER ", [" #REGISTER ", _orig_" #NAME \
-		             "@PAGEOFF]\n"                                     \
-		             "br " #REGISTER);                                 \
+#if defined(X87_HOST)
+// There is no Rosetta to forward to in host builds, the native handlers are
+// called directly through their NAME_fast symbols.
+#define X87_DISPATCH(RETURN, NAME, ARGS)                                         \
+	void *dispatch_##NAME;                                                   \
+	RETURN NAME ARGS {                                                       \
+		__builtin_trap();                                                \
 	}
+#else
+// Exports a handler from X87_HANDLER_LIST through its dispatch slot, which
+// handlerDispatchInit points at the native or the original Rosetta handler.
+#define X87_DISPATCH(RETURN, NAME, ARGS)                                         \
+	__attribute__((used)) void *dispatch_##NAME;                             \
+	RETURN __attribute__((naked, used)) NAME ARGS {                          \
+		asm volatile("adrp x9, _dispatch_" #NAME "@PAGE\n"              \
+		             "ldr x9, [x9, _dispatch_" #NAME "@PAGEOFF]\n"      \
+		             "br x9");                                           \
+	}
+#endif
+
+X87_HANDLER_LIST(X87_DISPATCH)
 
-#define X87_TRAMPOLINE_ARGS(RETURN, NAME, ARGS, REGISTER)                      \
-	RETURN __attribute__((naked, used)) NAME ARGS {                        \
-		asm volatile("adrp " #REGISTER ", _orig_" #NAME "@PAGE\n"      \
-		             "ldr " #REGISTER ", [" #REGISTER ", _orig_" #NAME \
-		             "@PAGEOFF]\n"                                     \
-		             "br " #REGISTER);                                 \
+// The native handler for a dispatch slot, wrapped by the trace recorder and
+// the sampler if they are enabled. The sampler goes outermost, it reads the
+// return address into the translated code.
+template <X87HandlerId kId, auto kHandler>
+static auto nativeHandler([[maybe_unused]] bool trace, [[maybe_unused]] bool sample) -> void * {
+#if defined(X87_TRACE)
+	if (trace) {
+		constexpr auto traced = &TraceHandler<kId, kHandler>::call;
+#if defined(X87_SAMPLE)
+		if (sample) {
+			return (void *)&SampleHandler<kId, traced>::call;
+		}
+#endif
+		return (void *)traced;
+	}
+#endif
+#if defined(X87_SAMPLE)
+	if (sample) {
+		return (void *)&SampleHandler<kId, kHandler>::call;
 	}
+#endif
+	return (void *)kHandler;
+}
+
+static auto handlerDispatchInit() -> void {
+	handlerConfigValidate();
+
+#if defined(X87_TRACE)
+	const bool trace = traceInit();
+#else
+	const bool trace = false;
+#endif
+#if defined(X87_SAMPLE)
+	const bool sample = sampleInit();
+#else
+	const bool sample = false;
+#endif
+
+#define X87_NATIVE_HANDLER(NAME) nativeHandler<X87HandlerId::NAME, fpEnvironmentHandler<X87HandlerId::NAME, &NAME##_fast>()>(trace, sample)
+
+	// pointers are taken here rather than in a static table as the image is
+	// not rebased after being mapped
+#define X87_DISPATCH_INIT(RETURN, NAME, ARGS) \
+	dispatch_##NAME = handlerConfigSelect(#NAME, X87_NATIVE_HANDLER(NAME), X87ExactHandler<X87HandlerId::NAME>::address(), (void *)orig_##NAME);
+
+	X87_HANDLER_LIST(X87_DISPATCH_INIT)
+#undef X87_DISPATCH_INIT
+#undef X87_NATIVE_HANDLER
+}
 
 void *init_library(SymbolList const *a1, uint64_t a2, ThreadContextOffsets const *a3) {
 	SIMDGuardFull simdGuard;
 	exportsInit();
+	handlerDispatchInit();
 
 	simplePrintf("RosettaRuntimex87 built %s\n", __DATE__ " " __TIME__);
 
 	return orig_init_library(a1, a2, a3);
 }
 
-X87_TRAMPOLINE(register_runtime_routine_offsets, x9)
-X87_TRAMPOLINE(translator_use_t8027_codegen, x9)
-X87_TRAMPOLINE(translator_reset, x9)
-X87_TRAMPOLINE(ir_create_bad_access, x9)
-X87_TRAMPOLINE(ir_create, x9)
-X87_TRAMPOLINE(module_free, x9)
-X87_TRAMPOLINE(module_get_size, x9)
-X87_TRAMPOLINE(module_is_bad_access, x9)
-X87_TRAMPOLINE(module_print, x9)
-X87_TRAMPOLINE(translator_translate, x9)
-X87_TRAMPOLINE(translator_free, x9)
-X87_TRAMPOLINE(translator_get_data, x9)
-X87_TRAMPOLINE(translator_get_size, x9)
-X87_TRAMPOLINE(translator_get_branch_slots_offset, x9)
-X87_TRAMPOLINE(translator_get_branch_slots_count, x9)
-X87_TRAMPOLINE(translator_get_branch_entries, x9)
-X87_TRAMPOLINE(translator_get_instruction_offsets, x9)
-X87_TRAMPOLINE(translator_apply_fixups, x9)
-
-#if defined(X87_CONVERT_TO_FP80)
-X87_TRAMPOLINE_ARGS(void, x87_init, (X87State *state), x9);
-#else
+#if !defined(X87_CONVERT_TO_FP80)
 void x87_init(X87State *state) {
 	SIMDGuard simdGuard;
 	LOG(1, "x87_init\n", 9);
@@ -143,21 +115,155 @@ void x87_init(X87State *state) {
 }
 #endif
 
-X87_TRAMPOLINE(x87_state_from_x86_float_state, x9);
-X87_TRAMPOLINE(x87_state_to_x86_float_state, x9);
+// The x86 float state is used for signal delivery and FXSAVE style access. It
+// has to be converted natively, Rosetta's implementation would read the double
+// registers of the non FP80 layout as 80 bit values.
+void x87_state_from_x86_float_state(X87State *state, X86FloatState64 const *floatState) {
+	SIMDGuard simdGuard;
+
+	LOG(1, "x87_state_from_x86_float_state\n", 31);
+
+	state->controlWord = floatState->fcw;
+	state->statusWord = floatState->fsw;
+
+	// Expand the abridged tag byte, every empty register becomes 11
+	uint32_t empty = ~floatState->ftw & 0xFF;
+	empty = (empty | (empty << 4)) & 0x0F0F;
+	empty = (empty | (empty << 2)) & 0x3333;
+	empty = (empty | (empty << 1)) & 0x5555;
+	uint32_t tagWord = empty | (empty << 1);
 
+	// stmm[i] holds ST(i), which lives in physical register (top + i) & 7
+	const uint32_t top = state->topIndex();
 #if defined(X87_CONVERT_TO_FP80)
-X87_TRAMPOLINE(x87_pop_register_stack, x9);
+	for (uint32_t i = 0; i < 8; i++) {
+		state->st[(top + i) & 7] = floatState->stmm[i].value;
+	}
+#else
+	ConvertX87RegistersToFloat64(&floatState->stmm[0].value, sizeof(floatState->stmm[0]), &state->st[0].ieee754, top);
+#endif
+
+#if !defined(X87_LAZY_TAG_WORD)
+	for (uint32_t regIdx = 0; regIdx < 8; regIdx++) {
+		if ((empty >> (regIdx * 2)) & 1) {
+			continue;
+		}
+#if defined(X87_CONVERT_TO_FP80)
+		tagWord |= static_cast<uint32_t>(classifyTag(state->st[regIdx])) << (regIdx * 2);
+#else
+		tagWord |= static_cast<uint32_t>(classifyTag(state->st[regIdx].ieee754)) << (regIdx * 2);
+#endif
+	}
+#endif
+
+	state->tagWord = static_cast<int16_t>(tagWord);
+}
+
+void x87_state_to_x86_float_state(X87State const *state, X86FloatState64 *floatState) {
+	SIMDGuard simdGuard;
+
+	LOG(1, "x87_state_to_x86_float_state\n", 29);
+
+	floatState->fcw = state->controlWord;
+	floatState->fsw = state->statusWord;
+
+	// Compress the tag word, a register is non-empty unless both tag bits are set
+	const uint32_t tagWord = static_cast<uint16_t>(state->tagWord);
+	uint32_t empty = tagWord & (tagWord >> 1) & 0x5555;
+	empty = (empty | (empty >> 1)) & 0x3333;
+	empty = (empty | (empty >> 2)) & 0x0F0F;
+	empty = (empty | (empty >> 4)) & 0x00FF;
+	floatState->ftw = static_cast<uint8_t>(~empty);
+
+	const uint32_t top = state->topIndex();
+#if defined(X87_CONVERT_TO_FP80)
+	for (uint32_t i = 0; i < 8; i++) {
+		floatState->stmm[i].value = state->st[(top + i) & 7];
+	}
 #else
+	ConvertFloat64ToX87Registers(&state->st[0].ieee754, top, &floatState->stmm[0].value, sizeof(floatState->stmm[0]));
+#endif
+}
+
+#if !defined(X87_CONVERT_TO_FP80)
 void x87_pop_register_stack(X87State *state) {
 	LOG(1, "x87_pop_register_stack\n", 9);
 	state->pop();
 }
 #endif
 
-#if defined(X87_F2XM1)
-void x87_f2xm1(X87State *state) {
-	SIMDGuardFull simdGuard;
+// Helpers shared by the fadd, fsub, fsubr, fmul, fdiv and fdivr families and
+// their fi* forms, so that every one of them runs the same code.
+
+using FastOperation = auto (*)(double, double) -> double;
+
+__attribute__((always_inline)) static inline auto fastAdd(double a, double b) -> double {
+	return a + b;
+}
+
+__attribute__((always_inline)) static inline auto fastSub(double a, double b) -> double {
+	return a - b;
+}
+
+__attribute__((always_inline)) static inline auto fastMul(double a, double b) -> double {
+	return a * b;
+}
+
+__attribute__((always_inline)) static inline auto fastDiv(double a, double b) -> double {
+	return a / b;
+}
+
+// A value with the sign of the rounding error of result = operation(a, b),
+// exactly recovered with the two-sum and fma residuals, for rounding to odd.
+template <FastOperation kOperation>
+__attribute__((always_inline)) static inline auto fastError(double a, double b, double result) -> double {
+	if constexpr (kOperation == &fastAdd || kOperation == &fastSub) {
+		const auto addend = kOperation == &fastAdd ? b : -b;
+		const auto roundedAddend = result - a;
+		return (a - (result - roundedAddend)) + (addend - roundedAddend);
+	} else if constexpr (kOperation == &fastMul) {
+		return std::fma(a, b, -result);
+	} else {
+		// the residual has the sign of the error times the sign of the divisor
+		const auto residual = std::fma(-result, b, a);
+		return b < 0 ? -residual : residual;
+	}
+}
+
+// ST(i) = ST(i) op ST(j), or ST(j) op ST(i) for the reversed forms.
+template <FastOperation kOperation, bool kReverse>
+__attribute__((always_inline)) static inline auto fastArithmeticST(X87State *state, uint32_t stOffset1, uint32_t stOffset2, bool pop) -> void {
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+
+	const auto a = state->getStFast(stOffset1);
+	const auto b = state->getStFast(stOffset2);
+	const auto x = kReverse ? b : a;
+	const auto y = kReverse ? a : b;
+	const auto result = kOperation(x, y);
+	// setSt keeps the tag word classified unless the tags are lazy
+	state->setSt(stOffset1, state->roundToPrecision(result, [&] { return fastError<kOperation>(x, y, result); }));
+
+	if (pop) {
+		state->pop();
+	}
+}
+
+// ST(0) = ST(0) op operand, or operand op ST(0) for the reversed forms. Float
+// and integer operands convert to double exactly.
+template <FastOperation kOperation, bool kReverse>
+__attribute__((always_inline)) static inline auto fastArithmetic(X87State *state, double operand) -> void {
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+
+	const auto st0 = state->getStFast(0);
+	const auto x = kReverse ? operand : st0;
+	const auto y = kReverse ? st0 : operand;
+	const auto result = kOperation(x, y);
+	state->setSt(0, state->roundToPrecision(result, [&] { return fastError<kOperation>(x, y, result); }));
+}
+
+void x87_f2xm1_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_f2xm1);
+	X87_PROFILE_SCOPE(x87_f2xm1);
 
 	LOG(1, "x87_f2xm1\n", 10);
 	// Get value from ST(0)
@@ -171,21 +277,18 @@ void x87_f2xm1(X87State *state) {
 	}
 
 	// Calculate 2^x - 1 using mmath::exp2
-	auto result = openlibm_exp2(x) - 1.0f;
+	auto result = state->isPrecision24() ? exp2m1Precision24(x) : openlibm_exp2(x) - 1.0f;
 
 	// Store result back in ST(0)
 	state->setStFast(0, result);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_f2xm1, (X87State *state), x9);
-#endif
 
 // Clears the sign bit of ST(0) to create the absolute value of the operand. The
 // following table shows the results obtained when creating the absolute value
 // of various classes of numbers. C1 Set to 0.
-#if defined(X87_FABS)
-void x87_fabs(X87State *state) {
-	SIMDGuard simdGuard;
+void x87_fabs_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fabs);
+	X87_PROFILE_SCOPE(x87_fabs);
 
 	LOG(1, "x87_fabs\n", 10);
 
@@ -198,66 +301,33 @@ void x87_fabs(X87State *state) {
 	// Set value in ST(0) to its absolute value
 	state->setStFast(0, std::abs(value));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fabs, (X87State *a1), x9);
-#endif
 
-#if defined(X87_FADD_ST)
-void x87_fadd_ST(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
-	SIMDGuard simdGuard;
+void x87_fadd_ST_fast(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fadd_ST);
+	X87_PROFILE_SCOPE(x87_fadd_ST);
 
 	LOG(1, "x87_fadd_ST\n", 13);
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get register indices and values
-	const auto val1 = state->getStFast(st_offset_1);
-	const auto val2 = state->getStFast(st_offset_2);
 
-	// Perform addition and store result in ST(idx1)
-	state->setStFast(st_offset_1, val1 + val2);
-
-	if (pop_stack) {
-		state->pop();
-	}
+	fastArithmeticST<&fastAdd, false>(state, st_offset_1, st_offset_2, pop_stack);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fadd_ST, (X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack), x9);
-#endif
 
-#if defined(X87_FADD_F32)
-void x87_fadd_f32(X87State *state, uint32_t fp32) {
-	SIMDGuard simdGuard;
+void x87_fadd_f32_fast(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fadd_f32);
+	X87_PROFILE_SCOPE(x87_fadd_f32);
 
 	LOG(1, "x87_fadd_f32\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<float>(fp32);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 + value);
+	fastArithmetic<&fastAdd, false>(state, std::bit_cast<float>(fp32));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fadd_f32, (X87State *state, uint32_t fp32), x9);
-#endif
 
-#if defined(X87_FADD_F64)
-void x87_fadd_f64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fadd_f64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fadd_f64);
+	X87_PROFILE_SCOPE(x87_fadd_f64);
 
 	LOG(1, "x87_fadd_f64\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<double>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 + value);
+	fastArithmetic<&fastAdd, false>(state, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fadd_f64, (X87State *state, uint64_t val), x9);
-#endif
 
 double BCD2Double(uint8_t bcd[10]) {
 	uint64_t tmp = 0;
@@ -284,9 +354,9 @@ double BCD2Double(uint8_t bcd[10]) {
 	return value;
 }
 
-#if defined(X87_FBLD)
-void x87_fbld(X87State *state, uint64_t val1, uint64_t val2) {
-	SIMDGuard simdGuard;
+void x87_fbld_fast(X87State *state, uint64_t val1, uint64_t val2) {
+	X87_SIMD_GUARD(x87_fbld);
+	X87_PROFILE_SCOPE(x87_fbld);
 	LOG(1, "x87_fbld\n", 10);
 
 	// set C1 to 0
@@ -302,13 +372,10 @@ void x87_fbld(X87State *state, uint64_t val1, uint64_t val2) {
 	state->push();
 	state->setSt(0, value);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fbld, (X87State *state, uint64_t val, uint64_t a3), x9);
-#endif
 
-#if defined(X87_FBSTP)
-uint128_t x87_fbstp(X87State *state) {
-	SIMDGuardAndX0X7 simdGuard;
+uint128_t x87_fbstp_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fbstp);
+	X87_PROFILE_SCOPE(x87_fbstp);
 	LOG(1, "x87_fbstp\n", 11);
 
 	auto st0 = state->getSt(0);
@@ -318,10 +385,10 @@ uint128_t x87_fbstp(X87State *state) {
 	uint8_t bcd[10] = {0}; // Initialize all bytes to 0
 
 	// Handle sign
-	bool is_negative = signbit(st0);
+	bool is_negative = std::signbit(st0);
 
 	// Handle special cases
-	if (isnan(st0) || isinf(st0)) {
+	if (std::isnan(st0) || std::isinf(st0)) {
 		// Set to indefinite BCD value
 		memset(bcd, 0, 10);
 		if (is_negative) {
@@ -369,13 +436,10 @@ uint128_t x87_fbstp(X87State *state) {
 		.high = reinterpret_cast<uint64_t *>(bcd)[1],
 	};
 }
-#else
-X87_TRAMPOLINE_ARGS(uint128_t, x87_fbstp, (X87State *state), x9);
-#endif
 
-#if defined(X87_FCHS)
-void x87_fchs(X87State *state) {
-	SIMDGuard simdGuard;
+void x87_fchs_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fchs);
+	X87_PROFILE_SCOPE(x87_fchs);
 
 	LOG(1, "x87_fchs\n", 10);
 	// set C1 to 0
@@ -384,13 +448,10 @@ void x87_fchs(X87State *state) {
 	// Negate value in ST(0)
 	state->setStFast(0, -state->getStFast(0));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fchs, (X87State *state), x9);
-#endif
 
-#if defined(X87_FCMOV)
-void x87_fcmov(X87State *state, uint32_t condition, uint32_t st_offset) {
-	SIMDGuard simdGuard;
+void x87_fcmov_fast(X87State *state, uint32_t condition, uint32_t st_offset) {
+	X87_SIMD_GUARD(x87_fcmov);
+	X87_PROFILE_SCOPE(x87_fcmov);
 
 	LOG(1, "x87_fcmov\n", 11);
 
@@ -413,13 +474,10 @@ void x87_fcmov(X87State *state, uint32_t condition, uint32_t st_offset) {
 
 	state->setSt(0, value); // Perform the actual register move
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fcmov, (X87State *state, uint32_t condition, uint32_t st_offset), x9);
-#endif
 
-#if defined(X87_FCOM_ST)
-void x87_fcom_ST(X87State *state, uint32_t st_offset, uint32_t number_of_pops) {
-	SIMDGuard simdGuard;
+void x87_fcom_ST_fast(X87State *state, uint32_t st_offset, uint32_t number_of_pops) {
+	X87_SIMD_GUARD(x87_fcom_ST);
+	X87_PROFILE_SCOPE(x87_fcom_ST);
 
 	LOG(1, "x87_fcom_ST\n", 13);
 
@@ -440,7 +498,7 @@ void x87_fcom_ST(X87State *state, uint32_t st_offset, uint32_t number_of_pops) {
 	}
 
 	if ((state->controlWord & kInvalidOpMask) == kInvalidOpMask) {
-		if (isnan(st0) || isnan(src)) {
+		if (std::isnan(st0) || std::isnan(src)) {
 			state->statusWord |= kConditionCode0 | kConditionCode2 | kConditionCode3; // Set C0=C2=C3=1
 		}
 	}
@@ -450,13 +508,10 @@ void x87_fcom_ST(X87State *state, uint32_t st_offset, uint32_t number_of_pops) {
 		state->pop();
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fcom_ST, (X87State *state, uint32_t st_offset, uint32_t number_of_pops), x9);
-#endif
 
-#if defined(X87_FCOM_F32)
-void x87_fcom_f32(X87State *state, uint32_t fp32, bool pop) {
-	SIMDGuard simdGuard;
+void x87_fcom_f32_fast(X87State *state, uint32_t fp32, bool pop) {
+	X87_SIMD_GUARD(x87_fcom_f32);
+	X87_PROFILE_SCOPE(x87_fcom_f32);
 
 	LOG(1, "x87_fcom_f32\n", 14);
 	auto st0 = state->getSt(0);
@@ -473,7 +528,7 @@ void x87_fcom_f32(X87State *state, uint32_t fp32, bool pop) {
 	}
 
 	if ((state->controlWord & kInvalidOpMask) == kInvalidOpMask) {
-		if (isnan(st0) || isnan(src)) {
+		if (std::isnan(st0) || std::isnan(src)) {
 			state->statusWord |= kConditionCode0 | kConditionCode2 | kConditionCode3; // Set C0=C2=C3=1
 		}
 	}
@@ -482,13 +537,10 @@ void x87_fcom_f32(X87State *state, uint32_t fp32, bool pop) {
 		state->pop();
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fcom_f32, (X87State *state, uint32_t fp32, bool pop), x9);
-#endif
 
-#if defined(X87_FCOM_F64)
-void x87_fcom_f64(X87State *state, uint64_t fp64, bool pop) {
-	SIMDGuard simdGuard;
+void x87_fcom_f64_fast(X87State *state, uint64_t fp64, bool pop) {
+	X87_SIMD_GUARD(x87_fcom_f64);
+	X87_PROFILE_SCOPE(x87_fcom_f64);
 
 	LOG(1, "x87_fcom_f64\n", 14);
 	auto st0 = state->getSt(0);
@@ -505,7 +557,7 @@ void x87_fcom_f64(X87State *state, uint64_t fp64, bool pop) {
 	}
 
 	if ((state->controlWord & kInvalidOpMask) == kInvalidOpMask) {
-		if (isnan(st0) || isnan(src)) {
+		if (std::isnan(st0) || std::isnan(src)) {
 			state->statusWord |= kConditionCode0 | kConditionCode2 | kConditionCode3; // Set C0=C2=C3=1
 		}
 	}
@@ -514,13 +566,10 @@ void x87_fcom_f64(X87State *state, uint64_t fp64, bool pop) {
 		state->pop();
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fcom_f64, (X87State *state, uint64_t fp64, bool pop), x9);
-#endif
 
-#if defined(X87_FCOMI)
-uint32_t x87_fcomi(X87State *state, uint32_t st_offset, bool pop) {
-	SIMDGuard simdGuard;
+uint32_t x87_fcomi_fast(X87State *state, uint32_t st_offset, bool pop) {
+	X87_SIMD_GUARD(x87_fcomi);
+	X87_PROFILE_SCOPE(x87_fcomi);
 
 	LOG(1, "x87_fcomi\n", 11);
 	state->statusWord &= ~(kConditionCode0);
@@ -554,13 +603,10 @@ uint32_t x87_fcomi(X87State *state, uint32_t st_offset, bool pop) {
 
 	return flags;
 }
-#else
-X87_TRAMPOLINE_ARGS(uint32_t, x87_fcomi, (X87State *state, uint32_t st_offset, bool pop), x9);
-#endif
 
-#if defined(X87_FCOS)
-void x87_fcos(X87State *state) {
-	SIMDGuardFullAndX0X7 simdGuard;
+void x87_fcos_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fcos);
+	X87_PROFILE_SCOPE(x87_fcos);
 
 	LOG(1, "x87_fcos\n", 10);
 	state->statusWord &= ~(kConditionCode1 | kConditionCode2);
@@ -573,12 +619,10 @@ void x87_fcos(X87State *state) {
 	// Store result back in ST(0)
 	state->setStFast(0, result);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fcos, (X87State *state), x9);
-#endif
 
-#if defined(X87_FDECSTP)
-void x87_fdecstp(X87State *state) {
+void x87_fdecstp_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fdecstp);
+	X87_PROFILE_SCOPE(x87_fdecstp);
 	LOG(1, "x87_fdecstp\n", 13);
 
 	uint16_t current_top = (state->statusWord & X87StatusWordFlag::kTopOfStack) >> 11;
@@ -591,152 +635,78 @@ void x87_fdecstp(X87State *state) {
 	// Clear the top of stack bits and set the new value
 	state->statusWord = (state->statusWord & ~X87StatusWordFlag::kTopOfStack) | (new_top << 11);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdecstp, (X87State *state), x9);
-#endif
 
-#if defined(X87_FDIV_ST)
-void x87_fdiv_ST(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
-	SIMDGuard simdGuard;
+void x87_fdiv_ST_fast(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fdiv_ST);
+	X87_PROFILE_SCOPE(x87_fdiv_ST);
 
 	LOG(1, "x87_fdiv_ST\n", 13);
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get register indices and values
-	const auto val1 = state->getStFast(st_offset_1);
-	const auto val2 = state->getStFast(st_offset_2);
-
-	// Perform division and store result
-	state->setStFast(st_offset_1, val1 / val2);
 
-	if (pop_stack) {
-		state->pop();
-	}
+	fastArithmeticST<&fastDiv, false>(state, st_offset_1, st_offset_2, pop_stack);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdiv_ST, (X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack), x9);
-#endif
 
-#if defined(X87_FDIV_F32)
-void x87_fdiv_f32(X87State *state, uint32_t val) {
-	SIMDGuard simdGuard;
+void x87_fdiv_f32_fast(X87State *state, uint32_t val) {
+	X87_SIMD_GUARD(x87_fdiv_f32);
+	X87_PROFILE_SCOPE(x87_fdiv_f32);
 
 	LOG(1, "x87_fdiv_f32\n", 14);
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<float>(val);
-	auto st0 = state->getStFast(0);
 
-	state->setStFast(0, st0 / value);
+	fastArithmetic<&fastDiv, false>(state, std::bit_cast<float>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdiv_f32, (X87State *state, uint32_t val), x9);
-#endif
 
-#if defined(X87_FDIV_F64)
-void x87_fdiv_f64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fdiv_f64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fdiv_f64);
+	X87_PROFILE_SCOPE(x87_fdiv_f64);
 
 	LOG(1, "x87_fdiv_f64\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<double>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 / value);
+	fastArithmetic<&fastDiv, false>(state, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdiv_f64, (X87State *state, uint64_t val), x9);
-#endif
 
-#if defined(X87_FDIVR_ST)
-void x87_fdivr_ST(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
-	SIMDGuard simdGuard;
+void x87_fdivr_ST_fast(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fdivr_ST);
+	X87_PROFILE_SCOPE(x87_fdivr_ST);
 
 	LOG(1, "x87_fdivr_ST\n", 14);
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
 
-	// Get register indices and values
-	const auto val1 = state->getStFast(st_offset_1);
-	const auto val2 = state->getStFast(st_offset_2);
-
-	// Perform reversed division and store result
-	state->setStFast(st_offset_1, val2 / val1);
-
-	if (pop_stack) {
-		state->pop();
-	}
+	fastArithmeticST<&fastDiv, true>(state, st_offset_1, st_offset_2, pop_stack);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdivr_ST, (X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack), x9);
-#endif
 
-#if defined(X87_FDIVR_F32)
-void x87_fdivr_f32(X87State *state, uint32_t val) {
-	SIMDGuard simdGuard;
+void x87_fdivr_f32_fast(X87State *state, uint32_t val) {
+	X87_SIMD_GUARD(x87_fdivr_f32);
+	X87_PROFILE_SCOPE(x87_fdivr_f32);
 
 	LOG(1, "x87_fdivr_f32\n", 15);
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<float>(val);
-	auto st0 = state->getStFast(0);
 
-	state->setStFast(0, value / st0);
+	fastArithmetic<&fastDiv, true>(state, std::bit_cast<float>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdivr_f32, (X87State *state, uint32_t val), x9);
-#endif
 
-#if defined(X87_FDIVR_F64)
-void x87_fdivr_f64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fdivr_f64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fdivr_f64);
+	X87_PROFILE_SCOPE(x87_fdivr_f64);
 
 	LOG(1, "x87_fdivr_f64\n", 15);
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<double>(val);
-	auto st0 = state->getStFast(0);
 
-	state->setStFast(0, value / st0);
+	fastArithmetic<&fastDiv, true>(state, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fdivr_f64, (X87State *state, uint64_t val), x9);
-#endif
 
 void x87_ffree(X87State *state, uint32_t val) {
 	LOG(1, "x87_ffree\n", 11);
 	orig_x87_ffree(state, val);
 }
 
-#if defined(X87_FIADD)
-void x87_fiadd(X87State *state, int32_t m32int) {
-	SIMDGuard simdGuard;
+void x87_fiadd_fast(X87State *state, int32_t m32int) {
+	X87_SIMD_GUARD(x87_fiadd);
+	X87_PROFILE_SCOPE(x87_fiadd);
 
 	LOG(1, "x87_fiadd\n", 11);
-	// simplePrintf("m32int: %d\n", m32int);
 
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get value in ST(0)
-	auto st0 = state->getSt(0);
-
-	// Add integer value
-	st0 += m32int;
-
-	// Store result back in ST(0)
-	state->setSt(0, st0);
+	fastArithmetic<&fastAdd, false>(state, static_cast<double>(m32int));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fiadd, (X87State *state, int m32int), x9);
-#endif
 
-#if defined(X87_FICOM)
-void x87_ficom(X87State *state, int32_t src, bool pop) {
-	SIMDGuard simdGuard;
+void x87_ficom_fast(X87State *state, int32_t src, bool pop) {
+	X87_SIMD_GUARD(x87_ficom);
+	X87_PROFILE_SCOPE(x87_ficom);
 	LOG(1, "x87_ficom\n", 11);
 	auto st0 = state->getSt(0);
 
@@ -744,7 +714,7 @@ void x87_ficom(X87State *state, int32_t src, bool pop) {
 	state->statusWord &= ~(kConditionCode0 | kConditionCode2 | kConditionCode3);
 
 	// Set condition codes based on comparison
-	if (isnan(st0)) {
+	if (std::isnan(st0)) {
 		state->statusWord |= kConditionCode0 | kConditionCode2 | kConditionCode3; // Set C0=C2=C3=1
 	} else if (st0 > src) {
 		// Leave C0=C2=C3=0
@@ -759,83 +729,42 @@ void x87_ficom(X87State *state, int32_t src, bool pop) {
 		state->pop();
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_ficom, (X87State *state, int32_t src, bool pop), x9);
-#endif
 
-#if defined(X87_FIDIV)
-void x87_fidiv(X87State *state, int val) {
-	SIMDGuard simdGuard;
+void x87_fidiv_fast(X87State *state, int val) {
+	X87_SIMD_GUARD(x87_fidiv);
+	X87_PROFILE_SCOPE(x87_fidiv);
 
 	LOG(1, "x87_fidiv\n", 11);
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
 
-	// Get value in ST(0)
-	auto value = state->getSt(0);
-
-	// Divide by integer value
-	value /= val;
-
-	// Store result back in ST(0)
-	state->setSt(0, value);
+	fastArithmetic<&fastDiv, false>(state, static_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fidiv, (X87State *state, int val), x9);
-#endif
 
-#if defined(X87_FIDIVR)
-void x87_fidivr(X87State *state, int val) {
-	SIMDGuard simdGuard;
+void x87_fidivr_fast(X87State *state, int val) {
+	X87_SIMD_GUARD(x87_fidivr);
+	X87_PROFILE_SCOPE(x87_fidivr);
 
 	LOG(1, "x87_fidivr\n", 12);
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get value in ST(0)
-	auto value = state->getSt(0);
-
-	// Divide integer value by value in ST(0)
-	value = val / value;
 
-	// Store result back in ST(0)
-	state->setSt(0, value);
+	fastArithmetic<&fastDiv, true>(state, static_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fidivr, (X87State *state, int val), x9);
-#endif
 
-#if defined(X87_FILD)
-void x87_fild(X87State *state, int64_t value) {
-	SIMDGuard simdGuard;
+void x87_fild_fast(X87State *state, int64_t value) {
+	X87_SIMD_GUARD(x87_fild);
+	X87_PROFILE_SCOPE(x87_fild);
 	LOG(1, "x87_fild\n", 10);
 
 	state->push();
 	state->setSt(0, static_cast<double>(value));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fild, (X87State *state, int64_t value), x9);
-#endif
 
-#if defined(X87_FIMUL)
-void x87_fimul(X87State *state, int val) {
-	SIMDGuard simdGuard;
-	LOG(1, "x87_fimul\n", 11);
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get value in ST(0)
-	auto value = state->getSt(0);
+void x87_fimul_fast(X87State *state, int val) {
+	X87_SIMD_GUARD(x87_fimul);
+	X87_PROFILE_SCOPE(x87_fimul);
 
-	// Multiply by integer value
-	value *= val;
+	LOG(1, "x87_fimul\n", 11);
 
-	// Store result back in ST(0)
-	state->setSt(0, value);
+	fastArithmetic<&fastMul, false>(state, static_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fimul, (X87State *state, int val), x9);
-#endif
 
 void x87_fincstp(X87State *state) {
 	LOG(1, "x87_fincstp\n", 13);
@@ -854,9 +783,9 @@ void x87_fincstp(X87State *state) {
 	state->statusWord |= (top << 11);                     // Set new TOP value
 }
 
-#if defined(X87_FIST_I16)
-X87ResultStatusWord x87_fist_i16(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fist_i16_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fist_i16);
+	X87_PROFILE_SCOPE(x87_fist_i16);
 
 	LOG(1, "x87_fist_i16\n", 14);
 	auto [value, statusWord] = state->getStConst(0);
@@ -877,6 +806,10 @@ X87ResultStatusWord x87_fist_i16(X87State const *state) {
 	}
 
 	// Normal case
+#if defined(X87_ROUNDING_CONTROL)
+	// the dispatch runs the handler in the rounding mode of the control word
+	return { .signedResult = static_cast<int16_t>(fpRoundToInteger(value)), .statusWord = statusWord };
+#else
 	auto round_bits = state->controlWord & X87ControlWord::kRoundingControlMask;
 
 	switch (round_bits) {
@@ -903,16 +836,14 @@ X87ResultStatusWord x87_fist_i16(X87State const *state) {
 		}
 		break;
 	}
+#endif
 
 	return result;
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fist_i16, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FIST_I32)
-X87ResultStatusWord x87_fist_i32(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fist_i32_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fist_i32);
+	X87_PROFILE_SCOPE(x87_fist_i32);
 
 	LOG(1, "x87_fist_i32\n", 14);
 	auto [value, statusWord] = state->getStConst(0);
@@ -932,6 +863,10 @@ X87ResultStatusWord x87_fist_i32(X87State const *state) {
 		return result;
 	}
 
+#if defined(X87_ROUNDING_CONTROL)
+	// the dispatch runs the handler in the rounding mode of the control word
+	return { .signedResult = static_cast<int32_t>(fpRoundToInteger(value)), .statusWord = statusWord };
+#else
 	auto round_bits = state->controlWord & X87ControlWord::kRoundingControlMask;
 
 	switch (round_bits) {
@@ -958,16 +893,14 @@ X87ResultStatusWord x87_fist_i32(X87State const *state) {
 		}
 		break;
 	}
+#endif
 
 	return result;
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fist_i32, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FIST_I64)
-X87ResultStatusWord x87_fist_i64(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fist_i64_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fist_i64);
+	X87_PROFILE_SCOPE(x87_fist_i64);
 
 	LOG(1, "x87_fist_i64\n", 14);
 	// Get value in ST(0)
@@ -991,6 +924,10 @@ X87ResultStatusWord x87_fist_i64(X87State const *state) {
 
 	// Normal case
 
+#if defined(X87_ROUNDING_CONTROL)
+	// the dispatch runs the handler in the rounding mode of the control word
+	return { .signedResult = static_cast<int64_t>(fpRoundToInteger(value)), .statusWord = statusWord };
+#else
 	auto round_bits = state->controlWord & X87ControlWord::kRoundingControlMask;
 
 	switch (round_bits) {
@@ -1017,16 +954,14 @@ X87ResultStatusWord x87_fist_i64(X87State const *state) {
 		}
 		break;
 	}
+#endif
 
 	return result;
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fist_i64, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FISTT_I16)
-X87ResultStatusWord x87_fistt_i16(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fistt_i16_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fistt_i16);
+	X87_PROFILE_SCOPE(x87_fistt_i16);
 
 	LOG(1, "x87_fistt_i16\n", 15);
 	// Get value in ST(0)
@@ -1034,13 +969,10 @@ X87ResultStatusWord x87_fistt_i16(X87State const *state) {
 
 	return { .signedResult = static_cast<int16_t>(value), .statusWord = statusWord };
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fistt_i16, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FISTT_I32)
-X87ResultStatusWord x87_fistt_i32(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fistt_i32_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fistt_i32);
+	X87_PROFILE_SCOPE(x87_fistt_i32);
 
 	LOG(1, "x87_fistt_i32\n", 15);
 	// Get value in ST(0)
@@ -1048,13 +980,10 @@ X87ResultStatusWord x87_fistt_i32(X87State const *state) {
 
 	return { .signedResult = static_cast<int32_t>(value), .statusWord = statusWord };
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fistt_i32, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FISTT_I64)
-X87ResultStatusWord x87_fistt_i64(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fistt_i64_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fistt_i64);
+	X87_PROFILE_SCOPE(x87_fistt_i64);
 
 	LOG(1, "x87_fistt_i64\n", 15);
 	// Get value in ST(0)
@@ -1062,57 +991,29 @@ X87ResultStatusWord x87_fistt_i64(X87State const *state) {
 
 	return { .signedResult = static_cast<int64_t>(value), .statusWord = statusWord };
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fistt_i64, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FISUB)
-void x87_fisub(X87State *state, int val) {
-	SIMDGuard simdGuard;
+void x87_fisub_fast(X87State *state, int val) {
+	X87_SIMD_GUARD(x87_fisub);
+	X87_PROFILE_SCOPE(x87_fisub);
 
 	LOG(1, "x87_fisub\n", 11);
-	// Clear condition code 1
-	state->statusWord &= ~(X87StatusWordFlag::kConditionCode1);
 
-	// Get value in ST(0)
-	auto value = state->getSt(0);
-
-	// Subtract integer value
-	value -= val;
-
-	// Store result back in ST(0)
-	state->setSt(0, value);
+	fastArithmetic<&fastSub, false>(state, static_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fisub, (X87State *state, int val), x9);
-#endif
 
-#if defined(X87_FISUBR)
-void x87_fisubr(X87State *state, int val) {
-	SIMDGuard simdGuard;
+void x87_fisubr_fast(X87State *state, int val) {
+	X87_SIMD_GUARD(x87_fisubr);
+	X87_PROFILE_SCOPE(x87_fisubr);
 
 	LOG(1, "x87_fisubr\n", 12);
 
-	// Clear condition code 1
-	state->statusWord &= ~(X87StatusWordFlag::kConditionCode1);
-
-	// Get value in ST(0)
-	auto value = state->getSt(0);
-
-	// Subtract integer value
-	value = val - value;
-
-	// Store result back in ST(0)
-	state->setSt(0, value);
+	fastArithmetic<&fastSub, true>(state, static_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fisubr, (X87State *state, int val), x9);
-#endif
 
 // Push ST(i) onto the FPU register stack.
-#if defined(X87_FLD_STI)
-void x87_fld_STi(X87State *state, uint32_t st_offset) {
-	SIMDGuard simdGuard;
+void x87_fld_STi_fast(X87State *state, uint32_t st_offset) {
+	X87_SIMD_GUARD(x87_fld_STi);
+	X87_PROFILE_SCOPE(x87_fld_STi);
 
 	LOG(1, "x87_fld_STi\n", 13);
 	state->statusWord &= ~0x200u;
@@ -1126,13 +1027,10 @@ void x87_fld_STi(X87State *state, uint32_t st_offset) {
 	// Copy value from ST(i) to ST(0)
 	state->setSt(0, value);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fld_STi, (X87State *state, uint32_t st_offset), x9);
-#endif
 
-#if defined(X87_FLD_CONSTANT)
-void x87_fld_constant(X87State *state, X87Constant val) {
-	SIMDGuard simdGuard;
+void x87_fld_constant_fast(X87State *state, X87Constant val) {
+	X87_SIMD_GUARD(x87_fld_constant);
+	X87_PROFILE_SCOPE(x87_fld_constant);
 
 	LOG(1, "x87_fld_constant\n", 18);
 	// simplePrintf("x87_fld_constant %d\n", (int)val);
@@ -1190,13 +1088,10 @@ void x87_fld_constant(X87State *state, X87Constant val) {
 		break;
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fld_constant, (X87State *state, X87Constant val), x9);
-#endif
 
-#if defined(X87_FLD_FP32)
-void x87_fld_fp32(X87State *state, uint32_t val) {
-	SIMDGuard simdGuard;
+void x87_fld_fp32_fast(X87State *state, uint32_t val) {
+	X87_SIMD_GUARD(x87_fld_fp32);
+	X87_PROFILE_SCOPE(x87_fld_fp32);
 
 	LOG(1, "x87_fld_fp32\n", 14);
 
@@ -1205,13 +1100,10 @@ void x87_fld_fp32(X87State *state, uint32_t val) {
 
 	state->setSt(0, std::bit_cast<float>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fld_fp32, (X87State *state, uint32_t val), x9);
-#endif
 
-#if defined(X87_FLD_FP64)
-void x87_fld_fp64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fld_fp64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fld_fp64);
+	X87_PROFILE_SCOPE(x87_fld_fp64);
 
 	LOG(1, "x87_fld_fp64\n", 14);
 
@@ -1220,13 +1112,10 @@ void x87_fld_fp64(X87State *state, uint64_t val) {
 
 	state->setSt(0, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fld_fp64, (X87State *state, uint64_t val), x9);
-#endif
 
-#if defined(X87_FLD_FP80)
-void x87_fld_fp80(X87State *state, X87Float80 val) {
-	SIMDGuard simdGuard;
+void x87_fld_fp80_fast(X87State *state, X87Float80 val) {
+	X87_SIMD_GUARD(x87_fld_fp80);
+	X87_PROFILE_SCOPE(x87_fld_fp80);
 	LOG(1, "x87_fld_fp80\n", 14);
 
 	auto ieee754 = ConvertX87RegisterToFloat64(val, &state->statusWord);
@@ -1234,72 +1123,38 @@ void x87_fld_fp80(X87State *state, X87Float80 val) {
 	state->push();
 	state->setSt(0, ieee754);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fld_fp80, (X87State *state, X87Float80 val), x9);
-#endif
 
-#if defined(X87_FMUL_ST)
-void x87_fmul_ST(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
-	SIMDGuard simdGuard;
+void x87_fmul_ST_fast(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fmul_ST);
+	X87_PROFILE_SCOPE(x87_fmul_ST);
 
 	LOG(1, "x87_fmul_ST\n", 13);
 
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get register indices and values
-	const auto val1 = state->getStFast(st_offset_1);
-	const auto val2 = state->getStFast(st_offset_2);
-
-	// Perform multiplication and store result
-	state->setStFast(st_offset_1, val1 * val2);
-
-	if (pop_stack) {
-		state->pop();
-	}
+	fastArithmeticST<&fastMul, false>(state, st_offset_1, st_offset_2, pop_stack);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fmul_ST, (X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack), x9);
-#endif
 
-#if defined(X87_FMUL_F32)
-void x87_fmul_f32(X87State *state, uint32_t fp32) {
-	SIMDGuard simdGuard;
+void x87_fmul_f32_fast(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fmul_f32);
+	X87_PROFILE_SCOPE(x87_fmul_f32);
 
 	LOG(1, "x87_fmul_f32\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<float>(fp32);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 * value);
+	fastArithmetic<&fastMul, false>(state, std::bit_cast<float>(fp32));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fmul_f32, (X87State *state, uint32_t fp32), x9);
-#endif
 
-#if defined(X87_FMUL_F64)
-void x87_fmul_f64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fmul_f64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fmul_f64);
+	X87_PROFILE_SCOPE(x87_fmul_f64);
 
 	LOG(1, "x87_fmul_f64\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<double>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 * value);
+	fastArithmetic<&fastMul, false>(state, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fmul_f64, (X87State *state, uint64_t val), x9);
-#endif
 
 // Replace ST(1) with arctan(ST(1)/ST(0)) and pop the register stack.
-#if defined(X87_FPATAN)
-void x87_fpatan(X87State *state) {
-	SIMDGuardFull simdGuard;
+void x87_fpatan_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fpatan);
+	X87_PROFILE_SCOPE(x87_fpatan);
 
 	LOG(1, "x87_fpatan\n", 12);
 
@@ -1317,13 +1172,10 @@ void x87_fpatan(X87State *state) {
 
 	state->pop();
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fpatan, (X87State *state), x9);
-#endif
 
-#if defined(X87_FPREM)
-void x87_fprem(X87State *state) {
-	SIMDGuardAndX0X7 simdGuard;
+void x87_fprem_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fprem);
+	X87_PROFILE_SCOPE(x87_fprem);
 	LOG(1, "x87_fprem\n", 11);
 
 	// 1) Clear CC0–CC3
@@ -1334,12 +1186,12 @@ void x87_fprem(X87State *state) {
 	double st1 = state->getSt(1);
 
 	// 2) Special cases: NaN/div0/∞ → #IA, ∞ divisor → pass through
-	if (isnan(st0) || isnan(st1) || isinf(st0) || st1 == 0.0) {
+	if (std::isnan(st0) || std::isnan(st1) || std::isinf(st0) || st1 == 0.0) {
 		state->setSt(0, std::numeric_limits<double>::quiet_NaN());
 		state->statusWord |= kInvalidOperation;
 		return;
 	}
-	if (isinf(st1)) {
+	if (std::isinf(st1)) {
 		// remainder = dividend; no exception
 		return;
 	}
@@ -1369,13 +1221,10 @@ void x87_fprem(X87State *state) {
 		// (optional) you could iterate: rem -= std::ldexp(trunc(rem/st1), D);
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fprem, (X87State *state), x9);
-#endif
 
-#if defined(X87_FPREM1)
-void x87_fprem1(X87State *state) {
-	SIMDGuardAndX0X7 simdGuard;
+void x87_fprem1_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fprem1);
+	X87_PROFILE_SCOPE(x87_fprem1);
 	LOG(1, "x87_fprem1\n", 12);
 
 	// 1) clear condition-code bits CC0–CC3
@@ -1385,12 +1234,12 @@ void x87_fprem1(X87State *state) {
 	double st1 = state->getSt(1);
 
 	// 2) special cases: NaN/div0/∞ → #IA or pass through
-	if (isnan(st0) || isnan(st1) || isinf(st0) || st1 == 0.0) {
+	if (std::isnan(st0) || std::isnan(st1) || std::isinf(st0) || st1 == 0.0) {
 		state->setSt(0, std::numeric_limits<double>::quiet_NaN());
 		state->statusWord |= kInvalidOperation;
 		return;
 	}
-	if (isinf(st1)) {
+	if (std::isinf(st1)) {
 		// remainder = dividend; no exception
 		return;
 	}
@@ -1421,13 +1270,10 @@ void x87_fprem1(X87State *state) {
 	}
 	// else D<64 ⇒ CC2 stays clear (complete reduction)
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fprem1, (X87State *state), x9);
-#endif
 
-#if defined(X87_FPTAN)
-void x87_fptan(X87State *state) {
-	SIMDGuardFullAndX0X7 simdGuard;
+void x87_fptan_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fptan);
+	X87_PROFILE_SCOPE(x87_fptan);
 
 	LOG(1, "x87_fptan\n", 11);
 
@@ -1446,13 +1292,10 @@ void x87_fptan(X87State *state) {
 	state->push();
 	state->setSt(0, 1.0);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fptan, (X87State *state), x9);
-#endif
 
-#if defined(X87_FRNDINT)
-void x87_frndint(X87State *state) {
-	SIMDGuard simdGuard;
+void x87_frndint_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_frndint);
+	X87_PROFILE_SCOPE(x87_frndint);
 
 	LOG(1, "x87_frndint\n", 13);
 
@@ -1460,6 +1303,10 @@ void x87_frndint(X87State *state) {
 
 	// Get current value and round it
 	double value = state->getStFast(0);
+#if defined(X87_ROUNDING_CONTROL)
+	// the dispatch runs the handler in the rounding mode of the control word
+	const double rounded = fpRoundToIntegral(value);
+#else
 	double rounded;
 	auto round_bits = state->controlWord & X87ControlWord::kRoundingControlMask;
 
@@ -1484,17 +1331,15 @@ void x87_frndint(X87State *state) {
 		}
 		break;
 	}
+#endif
 
 	// Store rounded value and update tag
 	state->setStFast(0, rounded);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_frndint, (X87State *state), x9);
-#endif
 
-#if defined(X87_FSCALE)
-void x87_fscale(X87State *state) {
-	SIMDGuard simdGuard;
+void x87_fscale_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fscale);
+	X87_PROFILE_SCOPE(x87_fscale);
 
 	LOG(1, "x87_fscale\n", 12);
 
@@ -1518,13 +1363,10 @@ void x87_fscale(X87State *state) {
 	// Store result back in ST(0)
 	state->setSt(0, result);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fscale, (X87State *state), x9);
-#endif
 
-#if defined(X87_FSIN)
-void x87_fsin(X87State *state) {
-	SIMDGuardFullAndX0X7 simdGuard;
+void x87_fsin_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fsin);
+	X87_PROFILE_SCOPE(x87_fsin);
 
 	LOG(1, "x87_fsin\n", 10);
 
@@ -1536,13 +1378,10 @@ void x87_fsin(X87State *state) {
 	// Store result and update tag
 	state->setStFast(0, openlibm_sin(value));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsin, (X87State *state), x9);
-#endif
 
-#if defined(X87_FSINCOS)
-void x87_fsincos(X87State *state) {
-	SIMDGuardFullAndX0X7 simdGuard;
+void x87_fsincos_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fsincos);
+	X87_PROFILE_SCOPE(x87_fsincos);
 
 	LOG(1, "x87_fsincos\n", 13);
 
@@ -1551,9 +1390,13 @@ void x87_fsincos(X87State *state) {
 	// Get value from ST(0)
 	const auto value = state->getStFast(0);
 
-	// Calculate sine and cosine
-	auto sin_value = openlibm_sin(value);
-	auto cos_value = openlibm_cos(value);
+	// Calculate sine and cosine with a single argument reduction
+	double sin_value, cos_value;
+	if (state->isPrecision24() && std::abs(value) <= kPrecision24MaxAngle) {
+		sinCosPrecision24(value, &sin_value, &cos_value);
+	} else {
+		openlibm_sincos(value, &sin_value, &cos_value);
+	}
 
 	// Store sine in ST(0)
 	state->setStFast(0, sin_value);
@@ -1565,14 +1408,11 @@ void x87_fsincos(X87State *state) {
 	// Clear C2 condition code bit
 	state->statusWord &= ~X87StatusWordFlag::kConditionCode2;
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsincos, (X87State *state), x9);
-#endif
 
 // Computes square root of ST(0) and stores the result in ST(0).
-#if defined(X87_FSQRT)
-void x87_fsqrt(X87State *state) {
-	SIMDGuard simdGuard;
+void x87_fsqrt_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fsqrt);
+	X87_PROFILE_SCOPE(x87_fsqrt);
 
 	LOG(1, "x87_fsqrt\n", 11);
 
@@ -1581,18 +1421,20 @@ void x87_fsqrt(X87State *state) {
 	// Get current value and calculate sqrt
 	const double value = state->getStFast(0);
 
+	// every root counts as inexact unless X87_IEEE_EXCEPTIONS reports the flag
+	// the square root actually raised
+#if !defined(X87_IEEE_EXCEPTIONS)
 	state->statusWord |= X87StatusWordFlag::kPrecision;
+#endif
 
 	// Store result and update tag
-	state->setStFast(0, sqrt(value));
+	const double root = sqrt(value);
+	state->setStFast(0, state->roundToPrecision(root, [&] { return std::fma(-root, root, value); }));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsqrt, (X87State *state), x9);
-#endif
 
-#if defined(X87_FST_STI)
-void x87_fst_STi(X87State *state, uint32_t st_offset, bool pop) {
-	SIMDGuard simdGuard;
+void x87_fst_STi_fast(X87State *state, uint32_t st_offset, bool pop) {
+	X87_SIMD_GUARD(x87_fst_STi);
+	X87_PROFILE_SCOPE(x87_fst_STi);
 
 	LOG(1, "x87_fst_STi\n", 13);
 
@@ -1607,13 +1449,10 @@ void x87_fst_STi(X87State *state, uint32_t st_offset, bool pop) {
 		state->pop();
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fst_STi, (X87State * state, uint32_t st_offset, bool pop), x9);
-#endif
 
-#if defined(X87_FST_FP32)
-X87ResultStatusWord x87_fst_fp32(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fst_fp32_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fst_fp32);
+	X87_PROFILE_SCOPE(x87_fst_fp32);
 
 	LOG(1, "x87_fst_fp32\n", 14);
 
@@ -1621,13 +1460,10 @@ X87ResultStatusWord x87_fst_fp32(X87State const *state) {
 	float tmp = value;
 	return {std::bit_cast<uint32_t>(tmp), statusWord};
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fst_fp32, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FST_FP64)
-X87ResultStatusWord x87_fst_fp64(X87State const *state) {
-	SIMDGuard simdGuard;
+X87ResultStatusWord x87_fst_fp64_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fst_fp64);
+	X87_PROFILE_SCOPE(x87_fst_fp64);
 
 	LOG(1, "x87_fst_fp64\n", 14);
 
@@ -1636,13 +1472,10 @@ X87ResultStatusWord x87_fst_fp64(X87State const *state) {
 	double tmp = value;
 	return {std::bit_cast<uint64_t>(tmp), statusWord};
 }
-#else
-X87_TRAMPOLINE_ARGS(X87ResultStatusWord, x87_fst_fp64, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FST_FP80)
-X87Float80StatusWordResult x87_fst_fp80(X87State const *state) {
-	SIMDGuard simdGuard;
+X87Float80StatusWordResult x87_fst_fp80_fast(X87State const *state) {
+	X87_SIMD_GUARD(x87_fst_fp80);
+	X87_PROFILE_SCOPE(x87_fst_fp80);
 
 	LOG(1, "x87_fst_fp80\n", 14);
 
@@ -1696,129 +1529,64 @@ X87Float80StatusWordResult x87_fst_fp80(X87State const *state) {
 
 	return result;
 }
-#else
-X87_TRAMPOLINE_ARGS(X87Float80StatusWordResult, x87_fst_fp80, (X87State const *state), x9);
-#endif
 
-#if defined(X87_FSUB_ST)
-void x87_fsub_ST(X87State *state, uint32_t st_offset1, uint32_t st_offset2, bool pop) {
-	SIMDGuard simdGuard;
+void x87_fsub_ST_fast(X87State *state, uint32_t st_offset1, uint32_t st_offset2, bool pop) {
+	X87_SIMD_GUARD(x87_fsub_ST);
+	X87_PROFILE_SCOPE(x87_fsub_ST);
 
 	LOG(1, "x87_fsub_ST\n", 13);
 
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get register indices and values
-	const auto val1 = state->getStFast(st_offset1);
-	const auto val2 = state->getStFast(st_offset2);
-
-	// Perform subtraction and store result in ST(st_offset1)
-	state->setStFast(st_offset1, val1 - val2);
-
-	if (pop) {
-		state->pop();
-	}
+	fastArithmeticST<&fastSub, false>(state, st_offset1, st_offset2, pop);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsub_ST, (X87State * state, uint32_t st_offset1, uint32_t st_offset2, bool pop), x9);
-#endif
 
-#if defined(X87_FSUB_F32)
-void x87_fsub_f32(X87State *state, uint32_t val) {
-	SIMDGuard simdGuard;
+void x87_fsub_f32_fast(X87State *state, uint32_t val) {
+	X87_SIMD_GUARD(x87_fsub_f32);
+	X87_PROFILE_SCOPE(x87_fsub_f32);
 
 	LOG(1, "x87_fsub_f32\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<float>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 - value);
+	fastArithmetic<&fastSub, false>(state, std::bit_cast<float>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsub_f32, (X87State *state, uint32_t val), x9);
-#endif
 
-#if defined(X87_FSUB_F64)
-void x87_fsub_f64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fsub_f64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fsub_f64);
+	X87_PROFILE_SCOPE(x87_fsub_f64);
 
 	LOG(1, "x87_fsub_f64\n", 14);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<double>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, st0 - value);
+	fastArithmetic<&fastSub, false>(state, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsub_f64, (X87State *state, uint64_t val), x9);
-#endif
 
-#if defined(X87_FSUBR_ST)
-void x87_fsubr_ST(X87State *state, uint32_t st_offset1, uint32_t st_offset2, bool pop) {
-	SIMDGuard simdGuard;
+void x87_fsubr_ST_fast(X87State *state, uint32_t st_offset1, uint32_t st_offset2, bool pop) {
+	X87_SIMD_GUARD(x87_fsubr_ST);
+	X87_PROFILE_SCOPE(x87_fsubr_ST);
 
 	LOG(1, "x87_fsubr_ST\n", 14);
 
-	// Clear condition code 1 and exception flags
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	// Get register indices and values
-	const auto val1 = state->getStFast(st_offset1);
-	const auto val2 = state->getStFast(st_offset2);
-
-	// Perform reversed subtraction and store result in ST(st_offset1)
-	state->setStFast(st_offset1, val2 - val1);
-
-	if (pop) {
-		state->pop();
-	}
+	fastArithmeticST<&fastSub, true>(state, st_offset1, st_offset2, pop);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsubr_ST, (X87State *state, uint32_t st_offset1, uint32_t st_offset2, bool pop), x9);
-#endif
 
-#if defined(X87_FSUBR_F32)
-void x87_fsubr_f32(X87State *state, unsigned int val) {
-	SIMDGuard simdGuard;
+void x87_fsubr_f32_fast(X87State *state, unsigned int val) {
+	X87_SIMD_GUARD(x87_fsubr_f32);
+	X87_PROFILE_SCOPE(x87_fsubr_f32);
 
 	LOG(1, "x87_fsubr_f32\n", 15);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<float>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, value - st0);
+	fastArithmetic<&fastSub, true>(state, std::bit_cast<float>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsubr_f32, (X87State *state, uint32_t val), x9);
-#endif
 
-#if defined(X87_FSUBR_F64)
-void x87_fsubr_f64(X87State *state, uint64_t val) {
-	SIMDGuard simdGuard;
+void x87_fsubr_f64_fast(X87State *state, uint64_t val) {
+	X87_SIMD_GUARD(x87_fsubr_f64);
+	X87_PROFILE_SCOPE(x87_fsubr_f64);
 
 	LOG(1, "x87_fsubr_f64\n", 15);
 
-	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
-
-	auto value = std::bit_cast<double>(val);
-	auto st0 = state->getStFast(0);
-
-	state->setStFast(0, value - st0);
+	fastArithmetic<&fastSub, true>(state, std::bit_cast<double>(val));
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fsubr_f64, (X87State *state, uint64_t val), x9);
-#endif
 
-#if defined(X87_FUCOM)
-void x87_fucom(X87State *state, uint32_t st_offset, uint32_t pop) {
-	SIMDGuard simdGuard;
+void x87_fucom_fast(X87State *state, uint32_t st_offset, uint32_t pop) {
+	X87_SIMD_GUARD(x87_fucom);
+	X87_PROFILE_SCOPE(x87_fucom);
 
 	LOG(1, "x87_fucom\n", 11);
 	auto st0 = state->getSt(0);
@@ -1828,7 +1596,7 @@ void x87_fucom(X87State *state, uint32_t st_offset, uint32_t pop) {
 	state->statusWord &= ~(kConditionCode0 | kConditionCode2 | kConditionCode3);
 
 	// Set condition codes based on comparison
-	if (isnan(st0) || isnan(src)) {
+	if (std::isnan(st0) || std::isnan(src)) {
 		state->statusWord |= kConditionCode0 | kConditionCode2 | kConditionCode3; // Set C0=C2=C3=1
 	} else if (st0 > src) {
 		// Leave C0=C2=C3=0
@@ -1843,13 +1611,10 @@ void x87_fucom(X87State *state, uint32_t st_offset, uint32_t pop) {
 		state->pop();
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fucom, (X87State *state, uint32_t st_offset, uint32_t pop), x9);
-#endif
 
-#if defined(X87_FUCOMI)
-uint32_t x87_fucomi(X87State *state, uint32_t st_offset, bool pop_stack) {
-	SIMDGuard simdGuard;
+uint32_t x87_fucomi_fast(X87State *state, uint32_t st_offset, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fucomi);
+	X87_PROFILE_SCOPE(x87_fucomi);
 
 	LOG(1, "x87_fucomi\n", 12);
 
@@ -1884,18 +1649,15 @@ uint32_t x87_fucomi(X87State *state, uint32_t st_offset, bool pop_stack) {
 
 	return flags;
 }
-#else
-X87_TRAMPOLINE_ARGS(uint32_t, x87_fucomi, (X87State *state, uint32_t st_offset, bool pop_stack), x9);
-#endif
 
-#if defined(X87_FXAM)
-void x87_fxam(X87State *state) {
-	SIMDGuard simdGuard;
+void x87_fxam_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fxam);
+	X87_PROFILE_SCOPE(x87_fxam);
 
 	LOG(1, "x87_fxam\n", 10);
 
 	// Get tag state for ST(0)
-	X87TagState tag = state->getStTag(0);
+	X87TagState tag = state->getStTagFull(0);
 
 	// simplePrintf("tag: %d\n", tag);
 
@@ -1920,28 +1682,25 @@ void x87_fxam(X87State *state) {
 	auto value = state->getSt(0);
 
 	// Set C1 based on sign
-	if (signbit(value)) {
+	if (std::signbit(value)) {
 		state->statusWord |= X87StatusWordFlag::kConditionCode1;
 	}
 
 	// Set C3,C2,C0 based on value type
-	if (isnan(value)) {
+	if (std::isnan(value)) {
 		state->statusWord |= X87StatusWordFlag::kConditionCode0; // 001
-	} else if (isinf(value)) {
+	} else if (std::isinf(value)) {
 		state->statusWord |= X87StatusWordFlag::kConditionCode2 | X87StatusWordFlag::kConditionCode0; // 011
-	} else if (fpclassify(value) == FP_SUBNORMAL) {
+	} else if (std::fpclassify(value) == FP_SUBNORMAL) {
 		state->statusWord |= X87StatusWordFlag::kConditionCode3 | X87StatusWordFlag::kConditionCode2; // 110
 	} else {
 		state->statusWord |= X87StatusWordFlag::kConditionCode2; // 010 (normal)
 	}
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fxam, (X87State *state), x9);
-#endif
 
-#if defined(X87_FXCH)
-void x87_fxch(X87State *state, uint32_t st_offset) {
-	SIMDGuard simdGuard;
+void x87_fxch_fast(X87State *state, uint32_t st_offset) {
+	X87_SIMD_GUARD(x87_fxch);
+	X87_PROFILE_SCOPE(x87_fxch);
 
 	LOG(1, "x87_fxch\n", 10);
 
@@ -1954,13 +1713,10 @@ void x87_fxch(X87State *state, uint32_t st_offset) {
 	state->setSt(0, sti);
 	state->setSt(st_offset, st0);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fxch, (X87State *state, uint32_t st_offset), x9);
-#endif
 
-#if defined(X87_FXTRACT)
-void x87_fxtract(X87State *state) {
-	SIMDGuardFull simdGuard;
+void x87_fxtract_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fxtract);
+	X87_PROFILE_SCOPE(x87_fxtract);
 
 	LOG(1, "x87_fxtract\n", 13);
 
@@ -1975,14 +1731,14 @@ void x87_fxtract(X87State *state) {
 		return;
 	}
 
-	if (isinf(st0)) {
+	if (std::isinf(st0)) {
 		state->setSt(0, st0);
 		state->push();
 		state->setSt(0, std::numeric_limits<double>::infinity());
 		return;
 	}
 
-	auto e = std::floor(openlibm_log2(abs(st0)));
+	auto e = std::floor(openlibm_log2(std::abs(st0)));
 	auto m = st0 / openlibm_pow(2.0, e);
 
 	state->setSt(0, e);
@@ -1990,9 +1746,6 @@ void x87_fxtract(X87State *state) {
 	state->push();
 	state->setSt(0, m);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fxtract, (X87State *state), x9);
-#endif
 
 static inline __attribute__((always_inline))
 void fyl2x_common(X87State *state, double constant) {
@@ -2004,7 +1757,16 @@ void fyl2x_common(X87State *state, double constant) {
 	auto st1 = state->getSt(1);
 
 	// Calculate y * log2(x)
-	auto result = st1 * (openlibm_log2(st0 + constant));
+	double log2Value;
+	if (!state->isPrecision24()) {
+		log2Value = openlibm_log2(st0 + constant);
+	} else if (constant != 0.0) {
+		// fyl2xp1 is only defined for |x| < 1 - sqrt(1/2)
+		log2Value = std::abs(st0) <= 0.29289321881345248 ? log2p1Precision24(st0) : openlibm_log2(st0 + constant);
+	} else if (!log2Precision24(st0, &log2Value)) {
+		log2Value = openlibm_log2(st0);
+	}
+	auto result = st1 * log2Value;
 
 	// Pop ST(0)
 	state->pop();
@@ -2014,47 +1776,24 @@ void fyl2x_common(X87State *state, double constant) {
 }
 
 // Replace ST(1) with (ST(1) ∗ log2ST(0)) and pop the register stack.
-#if defined(X87_FYL2X)
-void x87_fyl2x(X87State *state) {
-	SIMDGuardFull simdGuard;
+void x87_fyl2x_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fyl2x);
+	X87_PROFILE_SCOPE(x87_fyl2x);
 	LOG(1, "x87_fyl2x\n", 12);
 
 	fyl2x_common(state, 0.0);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fyl2x, (X87State *state), x9);
-#endif
 
 // Replace ST(1) with (ST(1) ∗ log2ST(0 + 1.0)) and pop the register stack.
-#if defined(X87_FYL2XP1)
-void x87_fyl2xp1(X87State *state) {
-	SIMDGuardFull simdGuard;
+void x87_fyl2xp1_fast(X87State *state) {
+	X87_SIMD_GUARD(x87_fyl2xp1);
+	X87_PROFILE_SCOPE(x87_fyl2xp1);
 	LOG(1, "x87_fyl2xp1\n", 14);
 
 	fyl2x_common(state, 1.0);
 }
-#else
-X87_TRAMPOLINE_ARGS(void, x87_fyl2xp1, (X87State *state), x9);
-#endif
-
-X87_TRAMPOLINE(sse_pcmpestri, x9)
-X87_TRAMPOLINE(sse_pcmpestrm, x9)
-X87_TRAMPOLINE(sse_pcmpistri, x9)
-X87_TRAMPOLINE(sse_pcmpistrm, x9)
-X87_TRAMPOLINE(is_ldt_initialized, x9)
-X87_TRAMPOLINE(get_ldt, x9)
-X87_TRAMPOLINE(set_ldt, x9)
-X87_TRAMPOLINE(execution_mode_for_code_segment_selector, x9)
-X87_TRAMPOLINE(mov_segment, x9)
-X87_TRAMPOLINE(abi_for_address, x9)
-
-X87_TRAMPOLINE(determine_state_recovery_action, x9)
-X87_TRAMPOLINE(get_segment_limit, x9)
-X87_TRAMPOLINE(translator_set_variant, x9)
 
-#if defined(X87_CONVERT_TO_FP80)
-X87_TRAMPOLINE_ARGS(void, x87_set_init_state, (X87State *state), x9);
-#else
+#if !defined(X87_CONVERT_TO_FP80)
 void x87_set_init_state(X87State *state) {
 	SIMDGuard simdGuard;
 	LOG(1, "x87_set_init_state\n", 9);
@@ -2067,7 +1806,3 @@ void x87_set_init_state(X87State *state) {
 	}
 }
 #endif
-
-X87_TRAMPOLINE(runtime_cpuid, x22)
-X87_TRAMPOLINE(runtime_wide_udiv_64, x9)
-X87_TRAMPOLINE(runtime_wide_sdiv_64, x9)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #include "X87Float80.h"
@@ -11,7 +12,6 @@ enum TranslationMode {};
 enum ExecutionMode {};
 struct ModuleResult {};
 struct TranslationResult {};
-struct X86FloatState64 {};
 enum X87Constant {
 	kOne = 0,
 	kZero = 1,
@@ -41,6 +41,40 @@ struct X87ResultStatusWord {
 };
 static_assert(sizeof(X87ResultStatusWord) == 0x10);
 
+// FXSAVE style x87/SSE state, laid out like Darwin's x86_float_state64_t.
+// stmm[i] holds ST(i) relative to the top of stack, while each bit of the
+// abridged tag byte covers a physical register (1 = non-empty).
+#pragma pack(push, 4)
+struct X86FloatState64 {
+	uint32_t reserved[2];
+	uint16_t fcw;
+	uint16_t fsw;
+	uint8_t ftw;
+	uint8_t reserved1;
+	uint16_t fop;
+	uint32_t ip;
+	uint16_t cs;
+	uint16_t reserved2;
+	uint32_t dp;
+	uint16_t ds;
+	uint16_t reserved3;
+	uint32_t mxcsr;
+	uint32_t mxcsrmask;
+	struct {
+		X87Float80 value;
+		uint8_t reserved[6];
+	} stmm[8];
+	uint8_t xmm[16][16];
+	uint8_t reserved4[96];
+	uint32_t reserved5;
+};
+#pragma pack(pop)
+static_assert(sizeof(X86FloatState64) == 524, "Invalid size for X86FloatState64");
+static_assert(offsetof(X86FloatState64, fcw) == 8, "Invalid offset for X86FloatState64::fcw");
+static_assert(offsetof(X86FloatState64, ftw) == 12, "Invalid offset for X86FloatState64::ftw");
+static_assert(offsetof(X86FloatState64, stmm) == 40, "Invalid offset for X86FloatState64::stmm");
+static_assert(offsetof(X86FloatState64, xmm) == 168, "Invalid offset for X86FloatState64::xmm");
+
 void *init_library(SymbolList const *, uint64_t, ThreadContextOffsets const *);
 using init_library_t = decltype(&init_library);
 
@@ -101,10 +135,10 @@ using translator_apply_fixups_t = decltype(&translator_apply_fixups);
 void x87_init(X87State *);
 using x87_init_t = decltype(&x87_init);
 
-void x87_state_from_x86_float_state();
+void x87_state_from_x86_float_state(X87State *, X86FloatState64 const *);
 using x87_state_from_x86_float_state_t = decltype(&x87_state_from_x86_float_state);
 
-void x87_state_to_x86_float_state();
+void x87_state_to_x86_float_state(X87State const *, X86FloatState64 *);
 using x87_state_to_x86_float_state_t = decltype(&x87_state_to_x86_float_state);
 
 void x87_pop_register_stack(X87State *state);
@@ -378,3 +412,88 @@ using runtime_wide_udiv_64_t = decltype(&runtime_wide_udiv_64);
 
 void runtime_wide_sdiv_64();
 using runtime_wide_sdiv_64_t = decltype(&runtime_wide_sdiv_64);
+
+// x87 handlers that have a native implementation. Each of them is exported
+// through a dispatch slot that init_library points at either the native
+// NAME_fast implementation or the original Rosetta handler, see HandlerConfig.h.
+#define X87_HANDLER_LIST(X) \
+	X(void, x87_f2xm1, (X87State *)) \
+	X(void, x87_fabs, (X87State *)) \
+	X(void, x87_fadd_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fadd_f32, (X87State *, uint32_t)) \
+	X(void, x87_fadd_f64, (X87State *, uint64_t)) \
+	X(void, x87_fbld, (X87State *, uint64_t, uint64_t)) \
+	X(uint128_t, x87_fbstp, (X87State *)) \
+	X(void, x87_fchs, (X87State *)) \
+	X(void, x87_fcmov, (X87State *, uint32_t, uint32_t)) \
+	X(void, x87_fcom_ST, (X87State *, uint32_t, uint32_t)) \
+	X(void, x87_fcom_f32, (X87State *, uint32_t, bool)) \
+	X(void, x87_fcom_f64, (X87State *, uint64_t, bool)) \
+	X(uint32_t, x87_fcomi, (X87State *, uint32_t, bool)) \
+	X(void, x87_fcos, (X87State *)) \
+	X(void, x87_fdecstp, (X87State *)) \
+	X(void, x87_fdiv_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fdiv_f32, (X87State *, uint32_t)) \
+	X(void, x87_fdiv_f64, (X87State *, uint64_t)) \
+	X(void, x87_fdivr_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fdivr_f32, (X87State *, uint32_t)) \
+	X(void, x87_fdivr_f64, (X87State *, uint64_t)) \
+	X(void, x87_fiadd, (X87State *, int32_t)) \
+	X(void, x87_ficom, (X87State *, int32_t, bool)) \
+	X(void, x87_fidiv, (X87State *, int32_t)) \
+	X(void, x87_fidivr, (X87State *, int32_t)) \
+	X(void, x87_fild, (X87State *, int64_t)) \
+	X(void, x87_fimul, (X87State *, int32_t)) \
+	X(X87ResultStatusWord, x87_fist_i16, (X87State const *)) \
+	X(X87ResultStatusWord, x87_fist_i32, (X87State const *)) \
+	X(X87ResultStatusWord, x87_fist_i64, (X87State const *)) \
+	X(X87ResultStatusWord, x87_fistt_i16, (X87State const *)) \
+	X(X87ResultStatusWord, x87_fistt_i32, (X87State const *)) \
+	X(X87ResultStatusWord, x87_fistt_i64, (X87State const *)) \
+	X(void, x87_fisub, (X87State *, int32_t)) \
+	X(void, x87_fisubr, (X87State *, int32_t)) \
+	X(void, x87_fld_STi, (X87State *, uint32_t)) \
+	X(void, x87_fld_constant, (X87State *, X87Constant)) \
+	X(void, x87_fld_fp32, (X87State *, uint32_t)) \
+	X(void, x87_fld_fp64, (X87State *, uint64_t)) \
+	X(void, x87_fld_fp80, (X87State *, X87Float80)) \
+	X(void, x87_fmul_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fmul_f32, (X87State *, uint32_t)) \
+	X(void, x87_fmul_f64, (X87State *, uint64_t)) \
+	X(void, x87_fpatan, (X87State *)) \
+	X(void, x87_fprem, (X87State *)) \
+	X(void, x87_fprem1, (X87State *)) \
+	X(void, x87_fptan, (X87State *)) \
+	X(void, x87_frndint, (X87State *)) \
+	X(void, x87_fscale, (X87State *)) \
+	X(void, x87_fsin, (X87State *)) \
+	X(void, x87_fsincos, (X87State *)) \
+	X(void, x87_fsqrt, (X87State *)) \
+	X(void, x87_fst_STi, (X87State *, uint32_t, bool)) \
+	X(X87ResultStatusWord, x87_fst_fp32, (X87State const *)) \
+	X(X87ResultStatusWord, x87_fst_fp64, (X87State const *)) \
+	X(X87Float80StatusWordResult, x87_fst_fp80, (X87State const *)) \
+	X(void, x87_fsub_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fsub_f32, (X87State *, uint32_t)) \
+	X(void, x87_fsub_f64, (X87State *, uint64_t)) \
+	X(void, x87_fsubr_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fsubr_f32, (X87State *, uint32_t)) \
+	X(void, x87_fsubr_f64, (X87State *, uint64_t)) \
+	X(void, x87_fucom, (X87State *, uint32_t, uint32_t)) \
+	X(uint32_t, x87_fucomi, (X87State *, uint32_t, bool)) \
+	X(void, x87_fxam, (X87State *)) \
+	X(void, x87_fxch, (X87State *, uint32_t)) \
+	X(void, x87_fxtract, (X87State *)) \
+	X(void, x87_fyl2x, (X87State *)) \
+	X(void, x87_fyl2xp1, (X87State *))
+
+#define X87_DECLARE_FAST(RETURN, NAME, ARGS) RETURN NAME##_fast ARGS;
+X87_HANDLER_LIST(X87_DECLARE_FAST)
+#undef X87_DECLARE_FAST
+
+enum class X87HandlerId : uint32_t {
+#define X87_HANDLER_ID(RETURN, NAME, ARGS) NAME,
+	X87_HANDLER_LIST(X87_HANDLER_ID)
+#undef X87_HANDLER_ID
+	kCount
+};
@@ -0,0 +1,387 @@
+#include "X87Exact.h"
+#include "DoubleDouble.h"
+#include "Log.h"
+#include "Profile.h"
+#include "SIMDGuard.h"
+#include "X87SoftFloat.h"
+
+#if defined(X87_CONVERT_TO_FP80)
+
+// Sets C3, C2 and C0 for fcom, fucom and ficom.
+__attribute__((always_inline)) static inline auto exactConditionCodes(X87State *state, SoftFloat80Order order) -> void {
+	switch (order) {
+	case SoftFloat80Order::kLess:
+		state->statusWord |= X87StatusWordFlag::kConditionCode0;
+		break;
+	case SoftFloat80Order::kEqual:
+		state->statusWord |= X87StatusWordFlag::kConditionCode3;
+		break;
+	case SoftFloat80Order::kUnordered:
+		state->statusWord |= X87StatusWordFlag::kConditionCode0 | X87StatusWordFlag::kConditionCode2 | X87StatusWordFlag::kConditionCode3;
+		break;
+	case SoftFloat80Order::kGreater:
+		break;
+	}
+}
+
+// fcomi and fucomi return the host flags: Z is ZF and C the inverted CF, see
+// the fast handlers. Unordered sets ZF and CF, PF is not part of the result.
+__attribute__((always_inline)) static inline auto exactFlags(SoftFloat80Order order) -> uint32_t {
+	switch (order) {
+	case SoftFloat80Order::kLess:
+		return 0x00000000;
+	case SoftFloat80Order::kGreater:
+		return 0x20000000;
+	case SoftFloat80Order::kEqual:
+		return 0x60000000;
+	default:
+		return 0x40000000;
+	}
+}
+
+static constexpr uint16_t kCompareConditionCodes =
+	X87StatusWordFlag::kConditionCode0 | X87StatusWordFlag::kConditionCode1 | X87StatusWordFlag::kConditionCode2 | X87StatusWordFlag::kConditionCode3;
+
+void x87_fadd_ST_exact(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fadd_ST);
+	X87_PROFILE_SCOPE(x87_fadd_ST);
+
+	LOG(1, "x87_fadd_ST_exact\n", 19);
+
+	exactArithmeticST<&softFloat80Add, false>(state, st_offset_1, st_offset_2, pop_stack);
+}
+
+void x87_fadd_f32_exact(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fadd_f32);
+	X87_PROFILE_SCOPE(x87_fadd_f32);
+
+	LOG(1, "x87_fadd_f32_exact\n", 20);
+
+	exactArithmetic<&softFloat80Add, false>(state, softFloat80FromFloat32(fp32, &state->statusWord));
+}
+
+void x87_fadd_f64_exact(X87State *state, uint64_t fp64) {
+	X87_SIMD_GUARD(x87_fadd_f64);
+	X87_PROFILE_SCOPE(x87_fadd_f64);
+
+	LOG(1, "x87_fadd_f64_exact\n", 20);
+
+	exactArithmetic<&softFloat80Add, false>(state, softFloat80FromFloat64(fp64, &state->statusWord));
+}
+
+void x87_fsub_ST_exact(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fsub_ST);
+	X87_PROFILE_SCOPE(x87_fsub_ST);
+
+	LOG(1, "x87_fsub_ST_exact\n", 19);
+
+	exactArithmeticST<&softFloat80Sub, false>(state, st_offset_1, st_offset_2, pop_stack);
+}
+
+void x87_fsub_f32_exact(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fsub_f32);
+	X87_PROFILE_SCOPE(x87_fsub_f32);
+
+	LOG(1, "x87_fsub_f32_exact\n", 20);
+
+	exactArithmetic<&softFloat80Sub, false>(state, softFloat80FromFloat32(fp32, &state->statusWord));
+}
+
+void x87_fsub_f64_exact(X87State *state, uint64_t fp64) {
+	X87_SIMD_GUARD(x87_fsub_f64);
+	X87_PROFILE_SCOPE(x87_fsub_f64);
+
+	LOG(1, "x87_fsub_f64_exact\n", 20);
+
+	exactArithmetic<&softFloat80Sub, false>(state, softFloat80FromFloat64(fp64, &state->statusWord));
+}
+
+void x87_fsubr_ST_exact(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fsubr_ST);
+	X87_PROFILE_SCOPE(x87_fsubr_ST);
+
+	LOG(1, "x87_fsubr_ST_exact\n", 20);
+
+	exactArithmeticST<&softFloat80Sub, true>(state, st_offset_1, st_offset_2, pop_stack);
+}
+
+void x87_fsubr_f32_exact(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fsubr_f32);
+	X87_PROFILE_SCOPE(x87_fsubr_f32);
+
+	LOG(1, "x87_fsubr_f32_exact\n", 21);
+
+	exactArithmetic<&softFloat80Sub, true>(state, softFloat80FromFloat32(fp32, &state->statusWord));
+}
+
+void x87_fsubr_f64_exact(X87State *state, uint64_t fp64) {
+	X87_SIMD_GUARD(x87_fsubr_f64);
+	X87_PROFILE_SCOPE(x87_fsubr_f64);
+
+	LOG(1, "x87_fsubr_f64_exact\n", 21);
+
+	exactArithmetic<&softFloat80Sub, true>(state, softFloat80FromFloat64(fp64, &state->statusWord));
+}
+
+void x87_fmul_ST_exact(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fmul_ST);
+	X87_PROFILE_SCOPE(x87_fmul_ST);
+
+	LOG(1, "x87_fmul_ST_exact\n", 19);
+
+	exactArithmeticST<&softFloat80Mul, false>(state, st_offset_1, st_offset_2, pop_stack);
+}
+
+void x87_fmul_f32_exact(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fmul_f32);
+	X87_PROFILE_SCOPE(x87_fmul_f32);
+
+	LOG(1, "x87_fmul_f32_exact\n", 20);
+
+	exactArithmetic<&softFloat80Mul, false>(state, softFloat80FromFloat32(fp32, &state->statusWord));
+}
+
+void x87_fmul_f64_exact(X87State *state, uint64_t fp64) {
+	X87_SIMD_GUARD(x87_fmul_f64);
+	X87_PROFILE_SCOPE(x87_fmul_f64);
+
+	LOG(1, "x87_fmul_f64_exact\n", 20);
+
+	exactArithmetic<&softFloat80Mul, false>(state, softFloat80FromFloat64(fp64, &state->statusWord));
+}
+
+void x87_fdiv_ST_exact(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fdiv_ST);
+	X87_PROFILE_SCOPE(x87_fdiv_ST);
+
+	LOG(1, "x87_fdiv_ST_exact\n", 19);
+
+	exactArithmeticST<&doubleDouble80Div, false>(state, st_offset_1, st_offset_2, pop_stack);
+}
+
+void x87_fdiv_f32_exact(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fdiv_f32);
+	X87_PROFILE_SCOPE(x87_fdiv_f32);
+
+	LOG(1, "x87_fdiv_f32_exact\n", 20);
+
+	exactArithmetic<&doubleDouble80Div, false>(state, softFloat80FromFloat32(fp32, &state->statusWord));
+}
+
+void x87_fdiv_f64_exact(X87State *state, uint64_t fp64) {
+	X87_SIMD_GUARD(x87_fdiv_f64);
+	X87_PROFILE_SCOPE(x87_fdiv_f64);
+
+	LOG(1, "x87_fdiv_f64_exact\n", 20);
+
+	exactArithmetic<&doubleDouble80Div, false>(state, softFloat80FromFloat64(fp64, &state->statusWord));
+}
+
+void x87_fdivr_ST_exact(X87State *state, uint32_t st_offset_1, uint32_t st_offset_2, bool pop_stack) {
+	X87_SIMD_GUARD(x87_fdivr_ST);
+	X87_PROFILE_SCOPE(x87_fdivr_ST);
+
+	LOG(1, "x87_fdivr_ST_exact\n", 20);
+
+	exactArithmeticST<&doubleDouble80Div, true>(state, st_offset_1, st_offset_2, pop_stack);
+}
+
+void x87_fdivr_f32_exact(X87State *state, uint32_t fp32) {
+	X87_SIMD_GUARD(x87_fdivr_f32);
+	X87_PROFILE_SCOPE(x87_fdivr_f32);
+
+	LOG(1, "x87_fdivr_f32_exact\n", 21);
+
+	exactArithmetic<&doubleDouble80Div, true>(state, softFloat80FromFloat32(fp32, &state->statusWord));
+}
+
+void x87_fdivr_f64_exact(X87State *state, uint64_t fp64) {
+	X87_SIMD_GUARD(x87_fdivr_f64);
+	X87_PROFILE_SCOPE(x87_fdivr_f64);
+
+	LOG(1, "x87_fdivr_f64_exact\n", 21);
+
+	exactArithmetic<&doubleDouble80Div, true>(state, softFloat80FromFloat64(fp64, &state->statusWord));
+}
+
+void x87_fiadd_exact(X87State *state, int32_t value) {
+	X87_SIMD_GUARD(x87_fiadd);
+	X87_PROFILE_SCOPE(x87_fiadd);
+
+	LOG(1, "x87_fiadd_exact\n", 17);
+
+	exactArithmetic<&softFloat80Add, false>(state, softFloat80FromInt32(value));
+}
+
+void x87_fisub_exact(X87State *state, int32_t value) {
+	X87_SIMD_GUARD(x87_fisub);
+	X87_PROFILE_SCOPE(x87_fisub);
+
+	LOG(1, "x87_fisub_exact\n", 17);
+
+	exactArithmetic<&softFloat80Sub, false>(state, softFloat80FromInt32(value));
+}
+
+void x87_fisubr_exact(X87State *state, int32_t value) {
+	X87_SIMD_GUARD(x87_fisubr);
+	X87_PROFILE_SCOPE(x87_fisubr);
+
+	LOG(1, "x87_fisubr_exact\n", 18);
+
+	exactArithmetic<&softFloat80Sub, true>(state, softFloat80FromInt32(value));
+}
+
+void x87_fimul_exact(X87State *state, int32_t value) {
+	X87_SIMD_GUARD(x87_fimul);
+	X87_PROFILE_SCOPE(x87_fimul);
+
+	LOG(1, "x87_fimul_exact\n", 17);
+
+	exactArithmetic<&softFloat80Mul, false>(state, softFloat80FromInt32(value));
+}
+
+void x87_fidiv_exact(X87State *state, int32_t value) {
+	X87_SIMD_GUARD(x87_fidiv);
+	X87_PROFILE_SCOPE(x87_fidiv);
+
+	LOG(1, "x87_fidiv_exact\n", 17);
+
+	exactArithmetic<&doubleDouble80Div, false>(state, softFloat80FromInt32(value));
+}
+
+void x87_fidivr_exact(X87State *state, int32_t value) {
+	X87_SIMD_GUARD(x87_fidivr);
+	X87_PROFILE_SCOPE(x87_fidivr);
+
+	LOG(1, "x87_fidivr_exact\n", 18);
+
+	exactArithmetic<&doubleDouble80Div, true>(state, softFloat80FromInt32(value));
+}
+
+void x87_fsqrt_exact(X87State *state) {
+	X87_SIMD_GUARD(x87_fsqrt);
+	X87_PROFILE_SCOPE(x87_fsqrt);
+
+	LOG(1, "x87_fsqrt_exact\n", 17);
+
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+	const auto st0 = exactReadSt(state, 0);
+	exactWriteSt(state, 0, doubleDouble80Sqrt(st0, state->controlWord, &state->statusWord));
+}
+
+void x87_fcom_ST_exact(X87State *state, uint32_t st_offset, uint32_t number_of_pops) {
+	X87_SIMD_GUARD(x87_fcom_ST);
+	X87_PROFILE_SCOPE(x87_fcom_ST);
+
+	LOG(1, "x87_fcom_ST_exact\n", 19);
+
+	state->statusWord &= ~kCompareConditionCodes;
+	const auto st0 = exactReadSt(state, 0);
+	const auto src = exactReadSt(state, st_offset);
+	exactConditionCodes(state, softFloat80Compare(st0, src, false, &state->statusWord));
+
+	for (uint32_t i = 0; i < number_of_pops; i++) {
+		state->pop();
+	}
+}
+
+void x87_fcom_f32_exact(X87State *state, uint32_t fp32, bool pop) {
+	X87_SIMD_GUARD(x87_fcom_f32);
+	X87_PROFILE_SCOPE(x87_fcom_f32);
+
+	LOG(1, "x87_fcom_f32_exact\n", 20);
+
+	state->statusWord &= ~kCompareConditionCodes;
+	const auto st0 = exactReadSt(state, 0);
+	const auto src = softFloat80FromFloat32(fp32, &state->statusWord);
+	exactConditionCodes(state, softFloat80Compare(st0, src, false, &state->statusWord));
+
+	if (pop) {
+		state->pop();
+	}
+}
+
+void x87_fcom_f64_exact(X87State *state, uint64_t fp64, bool pop) {
+	X87_SIMD_GUARD(x87_fcom_f64);
+	X87_PROFILE_SCOPE(x87_fcom_f64);
+
+	LOG(1, "x87_fcom_f64_exact\n", 20);
+
+	state->statusWord &= ~kCompareConditionCodes;
+	const auto st0 = exactReadSt(state, 0);
+	const auto src = softFloat80FromFloat64(fp64, &state->statusWord);
+	exactConditionCodes(state, softFloat80Compare(st0, src, false, &state->statusWord));
+
+	if (pop) {
+		state->pop();
+	}
+}
+
+void x87_ficom_exact(X87State *state, int32_t value, bool pop) {
+	X87_SIMD_GUARD(x87_ficom);
+	X87_PROFILE_SCOPE(x87_ficom);
+
+	LOG(1, "x87_ficom_exact\n", 17);
+
+	state->statusWord &= ~kCompareConditionCodes;
+	const auto st0 = exactReadSt(state, 0);
+	exactConditionCodes(state, softFloat80Compare(st0, softFloat80FromInt32(value), false, &state->statusWord));
+
+	if (pop) {
+		state->pop();
+	}
+}
+
+void x87_fucom_exact(X87State *state, uint32_t st_offset, uint32_t pop) {
+	X87_SIMD_GUARD(x87_fucom);
+	X87_PROFILE_SCOPE(x87_fucom);
+
+	LOG(1, "x87_fucom_exact\n", 17);
+
+	state->statusWord &= ~kCompareConditionCodes;
+	const auto st0 = exactReadSt(state, 0);
+	const auto src = exactReadSt(state, st_offset);
+	exactConditionCodes(state, softFloat80Compare(st0, src, true, &state->statusWord));
+
+	for (uint32_t i = 0; i < pop; i++) {
+		state->pop();
+	}
+}
+
+uint32_t x87_fcomi_exact(X87State *state, uint32_t st_offset, bool pop) {
+	X87_SIMD_GUARD(x87_fcomi);
+	X87_PROFILE_SCOPE(x87_fcomi);
+
+	LOG(1, "x87_fcomi_exact\n", 17);
+
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+	const auto st0 = exactReadSt(state, 0);
+	const auto src = exactReadSt(state, st_offset);
+	const auto flags = exactFlags(softFloat80Compare(st0, src, false, &state->statusWord));
+
+	if (pop) {
+		state->pop();
+	}
+
+	return flags;
+}
+
+uint32_t x87_fucomi_exact(X87State *state, uint32_t st_offset, bool pop) {
+	X87_SIMD_GUARD(x87_fucomi);
+	X87_PROFILE_SCOPE(x87_fucomi);
+
+	LOG(1, "x87_fucomi_exact\n", 18);
+
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+	const auto st0 = exactReadSt(state, 0);
+	const auto src = exactReadSt(state, st_offset);
+	const auto flags = exactFlags(softFloat80Compare(st0, src, true, &state->statusWord));
+
+	if (pop) {
+		state->pop();
+	}
+
+	return flags;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#pragma once
+
+// Native bit exact handlers, computing on the 80 bit registers with the
+// extended precision engine in X87SoftFloat.h. Division and square root first
+// try the faster double-double arithmetic in DoubleDouble.h, which gives the
+// same results. They need the FP80 register layout and are only built with
+// X87_CONVERT_TO_FP80. The exact mode of ROSETTA_X87_HANDLERS selects them,
+// handlers without an exact implementation fall back to Rosetta's own.
+
+#include "X87.h"
+#include "X87SoftFloat.h"
+#include "X87State.h"
+
+#define X87_EXACT_HANDLER_LIST(X) \
+	X(void, x87_fadd_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fadd_f32, (X87State *, uint32_t)) \
+	X(void, x87_fadd_f64, (X87State *, uint64_t)) \
+	X(void, x87_fcom_ST, (X87State *, uint32_t, uint32_t)) \
+	X(void, x87_fcom_f32, (X87State *, uint32_t, bool)) \
+	X(void, x87_fcom_f64, (X87State *, uint64_t, bool)) \
+	X(uint32_t, x87_fcomi, (X87State *, uint32_t, bool)) \
+	X(void, x87_fdiv_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fdiv_f32, (X87State *, uint32_t)) \
+	X(void, x87_fdiv_f64, (X87State *, uint64_t)) \
+	X(void, x87_fdivr_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fdivr_f32, (X87State *, uint32_t)) \
+	X(void, x87_fdivr_f64, (X87State *, uint64_t)) \
+	X(void, x87_fiadd, (X87State *, int32_t)) \
+	X(void, x87_ficom, (X87State *, int32_t, bool)) \
+	X(void, x87_fidiv, (X87State *, int32_t)) \
+	X(void, x87_fidivr, (X87State *, int32_t)) \
+	X(void, x87_fimul, (X87State *, int32_t)) \
+	X(void, x87_fisub, (X87State *, int32_t)) \
+	X(void, x87_fisubr, (X87State *, int32_t)) \
+	X(void, x87_fmul_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fmul_f32, (X87State *, uint32_t)) \
+	X(void, x87_fmul_f64, (X87State *, uint64_t)) \
+	X(void, x87_fsqrt, (X87State *)) \
+	X(void, x87_fsub_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fsub_f32, (X87State *, uint32_t)) \
+	X(void, x87_fsub_f64, (X87State *, uint64_t)) \
+	X(void, x87_fsubr_ST, (X87State *, uint32_t, uint32_t, bool)) \
+	X(void, x87_fsubr_f32, (X87State *, uint32_t)) \
+	X(void, x87_fsubr_f64, (X87State *, uint64_t)) \
+	X(void, x87_fucom, (X87State *, uint32_t, uint32_t)) \
+	X(uint32_t, x87_fucomi, (X87State *, uint32_t, bool))
+
+#if defined(X87_CONVERT_TO_FP80)
+#define X87_DECLARE_EXACT(RETURN, NAME, ARGS) RETURN NAME##_exact ARGS;
+X87_EXACT_HANDLER_LIST(X87_DECLARE_EXACT)
+#undef X87_DECLARE_EXACT
+
+// Helpers shared by the exact handlers.
+
+using SoftFloat80Operation = auto (*)(X87Float80, X87Float80, uint16_t, uint16_t *) -> X87Float80;
+
+// Reads ST(i). An empty register is a stack underflow and reads as the real
+// indefinite, which every operation propagates without raising more flags.
+__attribute__((always_inline)) inline auto exactReadSt(X87State *state, uint32_t stOffset) -> X87Float80 {
+	const uint32_t regIdx = state->getStIndex(stOffset);
+	if (((state->tagWord >> (regIdx * 2)) & 3) == static_cast<int>(X87TagState::kEmpty)) {
+		state->statusWord |= X87StatusWordFlag::kStackFault | X87StatusWordFlag::kInvalidOperation;
+		return softFloat80Indefinite();
+	}
+	return state->st[regIdx];
+}
+
+__attribute__((always_inline)) inline auto exactWriteSt(X87State *state, uint32_t stOffset, X87Float80 value) -> void {
+	const uint32_t regIdx = state->getStIndex(stOffset);
+	state->st[regIdx] = value;
+	state->tagWord &= ~(3 << (regIdx * 2));
+#if !defined(X87_LAZY_TAG_WORD)
+	state->tagWord |= static_cast<int>(classifyTag(value)) << (regIdx * 2);
+#endif
+}
+
+// ST(i) = ST(i) op ST(j), or ST(j) op ST(i) for the reversed forms.
+template <SoftFloat80Operation kOperation, bool kReverse>
+__attribute__((always_inline)) inline auto exactArithmeticST(X87State *state, uint32_t stOffset1, uint32_t stOffset2, bool pop) -> void {
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+
+	const auto a = exactReadSt(state, stOffset1);
+	const auto b = exactReadSt(state, stOffset2);
+	exactWriteSt(state, stOffset1, kReverse ? kOperation(b, a, state->controlWord, &state->statusWord) : kOperation(a, b, state->controlWord, &state->statusWord));
+
+	if (pop) {
+		state->pop();
+	}
+}
+
+// ST(0) = ST(0) op operand, or operand op ST(0) for the reversed forms. The
+// operand is converted before, so that its denormal flag is raised.
+template <SoftFloat80Operation kOperation, bool kReverse>
+__attribute__((always_inline)) inline auto exactArithmetic(X87State *state, X87Float80 operand) -> void {
+	state->statusWord &= ~X87StatusWordFlag::kConditionCode1;
+
+	const auto st0 = exactReadSt(state, 0);
+	exactWriteSt(state, 0, kReverse ? kOperation(operand, st0, state->controlWord, &state->statusWord) : kOperation(st0, operand, state->controlWord, &state->statusWord));
+}
+#endif
+
+// Address of the exact implementation of a handler, nullptr if there is none.
+template <X87HandlerId kId>
+struct X87ExactHandler {
+	static auto address() -> void * {
+		return nullptr;
+	}
+};
+
+#if defined(X87_CONVERT_TO_FP80)
+#define X87_EXACT_HANDLER(RETURN, NAME, ARGS)                    \
+	template <>                                              \
+	struct X87ExactHandler<X87HandlerId::NAME> {             \
+		static auto address() -> void * {                \
+			return (void *)&NAME##_exact;            \
+		}                                                \
+	};
+X87_EXACT_HANDLER_LIST(X87_EXACT_HANDLER)
+#undef X87_EXACT_HANDLER
+#endif
@@ -0,0 +1,586 @@
+#pragma once
+
+// Extended precision arithmetic on X87Float80 values, used by the exact
+// handlers. Results are rounded once, to the precision and rounding control of
+// the control word, from significands held in 128 bit integers. Exception flags
+// and C1 (result rounded up) are accumulated in the status word the way the x87
+// reports them, tininess is detected after rounding. Exceptions always get
+// their masked response, like in the fast handlers: invalid operations return
+// the real indefinite, overflows infinity or the largest finite value and
+// underflows a denormal.
+//
+// Nothing here calls into a runtime library, 128 by 64 bit division is done
+// in 32 bit digits and the square root is refined from a double estimate.
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "X87Float80.h"
+#include "X87State.h"
+
+using UInt128 = unsigned __int128;
+
+constexpr int32_t kFloat80Bias = 16383;
+constexpr int32_t kFloat80MaxExponent = 0x7FFF;
+constexpr uint64_t kFloat80IntegerBit = 0x8000000000000000ULL;
+constexpr uint64_t kFloat80QuietBit = 0x4000000000000000ULL;
+
+enum class SoftFloat80Class : uint8_t {
+	kZero,
+	kFinite, // normals and denormals
+	kInfinity,
+	kNaN,
+	kUnsupported, // unnormals, pseudo-infinities and pseudo-NaNs
+};
+
+enum class SoftFloat80Order : uint8_t {
+	kLess,
+	kEqual,
+	kGreater,
+	kUnordered,
+};
+
+__attribute__((always_inline)) inline auto softFloat80Make(bool sign, int32_t exponent, uint64_t mantissa) -> X87Float80 {
+	X87Float80 result;
+	result.mantissa = mantissa;
+	result.exponent = static_cast<uint16_t>((sign ? 0x8000 : 0) | exponent);
+	return result;
+}
+
+// Negative quiet NaN returned by masked invalid operations.
+__attribute__((always_inline)) inline auto softFloat80Indefinite() -> X87Float80 {
+	return softFloat80Make(true, kFloat80MaxExponent, kFloat80IntegerBit | kFloat80QuietBit);
+}
+
+__attribute__((always_inline)) inline auto softFloat80Sign(X87Float80 value) -> bool {
+	return (value.exponent >> 15) != 0;
+}
+
+__attribute__((always_inline)) inline auto softFloat80Classify(X87Float80 value) -> SoftFloat80Class {
+	const int32_t exponent = value.exponent & kFloat80MaxExponent;
+	const bool integerBit = (value.mantissa & kFloat80IntegerBit) != 0;
+	if (exponent == kFloat80MaxExponent) {
+		if (!integerBit) {
+			return SoftFloat80Class::kUnsupported;
+		}
+		return (value.mantissa << 1) == 0 ? SoftFloat80Class::kInfinity : SoftFloat80Class::kNaN;
+	}
+	if (exponent == 0) {
+		// pseudo-denormals (integer bit set) are accepted like denormals
+		return value.mantissa == 0 ? SoftFloat80Class::kZero : SoftFloat80Class::kFinite;
+	}
+	return integerBit ? SoftFloat80Class::kFinite : SoftFloat80Class::kUnsupported;
+}
+
+__attribute__((always_inline)) inline auto softFloat80IsDenormal(X87Float80 value) -> bool {
+	return (value.exponent & kFloat80MaxExponent) == 0 && value.mantissa != 0;
+}
+
+__attribute__((always_inline)) inline auto softFloat80IsSignaling(X87Float80 value) -> bool {
+	return (value.mantissa & kFloat80QuietBit) == 0;
+}
+
+// Returns the mantissa of a finite non-zero value shifted so that the integer
+// bit is set, and the matching exponent, which is below 1 for denormals.
+__attribute__((always_inline)) inline auto softFloat80Normalize(X87Float80 value, int32_t *exponent) -> uint64_t {
+	uint64_t mantissa = value.mantissa;
+	int32_t biased = value.exponent & kFloat80MaxExponent;
+	if (biased == 0) {
+		// denormals have the exponent of the smallest normal
+		const int shift = __builtin_clzll(mantissa);
+		mantissa <<= shift;
+		biased = 1 - shift;
+	}
+	*exponent = biased;
+	return mantissa;
+}
+
+__attribute__((always_inline)) inline auto softFloat80CountLeadingZeros(UInt128 value) -> int32_t {
+	const uint64_t high = static_cast<uint64_t>(value >> 64);
+	return high != 0 ? __builtin_clzll(high) : 64 + __builtin_clzll(static_cast<uint64_t>(value));
+}
+
+// Shifts right, folding the bits shifted out into bit 0.
+__attribute__((always_inline)) inline auto softFloat80ShiftRightJamming(UInt128 value, uint32_t count) -> UInt128 {
+	if (count == 0) {
+		return value;
+	}
+	if (count >= 128) {
+		return value != 0;
+	}
+	return (value >> count) | ((value << (128 - count)) != 0);
+}
+
+// Divides high:low by divisor, which must have bit 63 set and be larger than
+// high (Hacker's Delight divlu with 32 bit digits).
+__attribute__((always_inline)) inline auto softFloat80Divide128(uint64_t high, uint64_t low, uint64_t divisor, uint64_t *remainder) -> uint64_t {
+	const uint64_t divisorHigh = divisor >> 32;
+	const uint64_t divisorLow = divisor & 0xFFFFFFFFULL;
+	const uint64_t lowHigh = low >> 32;
+	const uint64_t lowLow = low & 0xFFFFFFFFULL;
+
+	uint64_t quotientHigh = high / divisorHigh;
+	uint64_t rest = high - quotientHigh * divisorHigh;
+	while ((quotientHigh >> 32) != 0 || quotientHigh * divisorLow > ((rest << 32) | lowHigh)) {
+		quotientHigh--;
+		rest += divisorHigh;
+		if ((rest >> 32) != 0) {
+			break;
+		}
+	}
+
+	const uint64_t middle = (high << 32) + lowHigh - quotientHigh * divisor;
+	uint64_t quotientLow = middle / divisorHigh;
+	rest = middle - quotientLow * divisorHigh;
+	while ((quotientLow >> 32) != 0 || quotientLow * divisorLow > ((rest << 32) | lowLow)) {
+		quotientLow--;
+		rest += divisorHigh;
+		if ((rest >> 32) != 0) {
+			break;
+		}
+	}
+
+	*remainder = (middle << 32) + lowLow - quotientLow * divisor;
+	return (quotientHigh << 32) | quotientLow;
+}
+
+// Rounds significand * 2^(exponent - kFloat80Bias - 127) to the precision
+// control and packs it. The significand must have bit 127 set, the exponent
+// may be out of range.
+inline auto softFloat80RoundPack(bool sign, int32_t exponent, UInt128 significand, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	// number of significand bits below the rounding position
+	uint32_t roundBits;
+	switch (controlWord & X87ControlWord::kPrecisionControl) {
+	case X87ControlWord::kPrecision24Bit:
+		roundBits = 128 - 24;
+		break;
+	case X87ControlWord::kPrecision53Bit:
+		roundBits = 128 - 53;
+		break;
+	default:
+		roundBits = 128 - 64;
+		break;
+	}
+	const UInt128 roundMask = (static_cast<UInt128>(1) << roundBits) - 1;
+	const UInt128 half = static_cast<UInt128>(1) << (roundBits - 1);
+	const uint16_t rounding = controlWord & X87ControlWord::kRoundingControlMask;
+
+	const auto roundsUp = [&](UInt128 value) -> bool {
+		const UInt128 rest = value & roundMask;
+		switch (rounding) {
+		case X87ControlWord::kRoundToNearest:
+			return rest > half || (rest == half && ((value >> roundBits) & 1) != 0);
+		case X87ControlWord::kRoundDown:
+			return sign && rest != 0;
+		case X87ControlWord::kRoundUp:
+			return !sign && rest != 0;
+		default:
+			return false;
+		}
+	};
+
+	bool tiny = false;
+	if (exponent <= 0) {
+		// tiny unless rounding with an unbounded exponent reaches the smallest normal
+		tiny = exponent < 0 || !roundsUp(significand) || (significand | roundMask) != ~static_cast<UInt128>(0);
+		significand = softFloat80ShiftRightJamming(significand, static_cast<uint32_t>(1 - exponent));
+		exponent = 0;
+	}
+
+	const bool inexact = (significand & roundMask) != 0;
+	const bool up = roundsUp(significand);
+	significand &= ~roundMask;
+	if (up) {
+		significand += static_cast<UInt128>(1) << roundBits;
+		if (significand == 0) {
+			significand = static_cast<UInt128>(1) << 127;
+			exponent++;
+		}
+	}
+
+	uint64_t mantissa = static_cast<uint64_t>(significand >> 64);
+	if (exponent == 0 && (mantissa & kFloat80IntegerBit) != 0) {
+		// a denormal rounded up to the smallest normal
+		exponent = 1;
+	}
+
+	uint16_t flags = (inexact ? X87StatusWordFlag::kPrecision : 0) | (tiny && inexact ? X87StatusWordFlag::kUnderflow : 0);
+	bool roundedUp = up;
+	if (exponent >= kFloat80MaxExponent) {
+		flags |= X87StatusWordFlag::kOverflow | X87StatusWordFlag::kPrecision;
+		const bool toInfinity = rounding == X87ControlWord::kRoundToNearest ||
+		                        (rounding == X87ControlWord::kRoundUp && !sign) || (rounding == X87ControlWord::kRoundDown && sign);
+		if (toInfinity) {
+			exponent = kFloat80MaxExponent;
+			mantissa = kFloat80IntegerBit;
+		} else {
+			exponent = kFloat80MaxExponent - 1;
+			mantissa = ~0ULL << (roundBits - 64);
+		}
+		roundedUp = toInfinity;
+	}
+
+	*statusWord = (*statusWord & ~X87StatusWordFlag::kConditionCode1) | flags | (roundedUp ? X87StatusWordFlag::kConditionCode1 : 0);
+	return softFloat80Make(sign, exponent, mantissa);
+}
+
+// NaN operand rules of the x87: a signaling NaN raises an invalid operation,
+// a quiet NaN wins over a signaling one, otherwise the larger significand.
+inline auto softFloat80PropagateNaN(X87Float80 a, X87Float80 b, uint16_t *statusWord) -> X87Float80 {
+	const bool aNaN = softFloat80Classify(a) == SoftFloat80Class::kNaN;
+	const bool bNaN = softFloat80Classify(b) == SoftFloat80Class::kNaN;
+	const bool aSignaling = aNaN && softFloat80IsSignaling(a);
+	const bool bSignaling = bNaN && softFloat80IsSignaling(b);
+	if (aSignaling || bSignaling) {
+		*statusWord |= X87StatusWordFlag::kInvalidOperation;
+	}
+
+	X87Float80 result = aNaN ? a : b;
+	if (aNaN && bNaN) {
+		if (aSignaling != bSignaling) {
+			result = aSignaling ? b : a;
+		} else {
+			result = (b.mantissa & ~kFloat80QuietBit) > (a.mantissa & ~kFloat80QuietBit) ? b : a;
+		}
+	}
+	result.mantissa |= kFloat80QuietBit;
+	return result;
+}
+
+// Handles unsupported and NaN operands of a binary operation. Returns true if
+// result holds the final result.
+__attribute__((always_inline)) inline auto softFloat80CheckOperands(X87Float80 a, X87Float80 b, SoftFloat80Class aClass, SoftFloat80Class bClass, uint16_t *statusWord,
+                                                                    X87Float80 *result) -> bool {
+	if (aClass == SoftFloat80Class::kUnsupported || bClass == SoftFloat80Class::kUnsupported) {
+		*statusWord |= X87StatusWordFlag::kInvalidOperation;
+		*result = softFloat80Indefinite();
+		return true;
+	}
+	if (aClass == SoftFloat80Class::kNaN || bClass == SoftFloat80Class::kNaN) {
+		*result = softFloat80PropagateNaN(a, b, statusWord);
+		return true;
+	}
+	return false;
+}
+
+__attribute__((always_inline)) inline auto softFloat80CheckDenormal(X87Float80 a, X87Float80 b, uint16_t *statusWord) -> void {
+	if (softFloat80IsDenormal(a) || softFloat80IsDenormal(b)) {
+		*statusWord |= X87StatusWordFlag::kDenormalizedOperand;
+	}
+}
+
+// Rounds a finite non-zero value to the precision control, as every
+// arithmetic result is.
+__attribute__((always_inline)) inline auto softFloat80Round(X87Float80 value, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	int32_t exponent;
+	const uint64_t mantissa = softFloat80Normalize(value, &exponent);
+	return softFloat80RoundPack(softFloat80Sign(value), exponent, static_cast<UInt128>(mantissa) << 64, controlWord, statusWord);
+}
+
+// a + b, or a - b with negateB.
+inline auto softFloat80AddSub(X87Float80 a, X87Float80 b, bool negateB, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	const auto aClass = softFloat80Classify(a);
+	const auto bClass = softFloat80Classify(b);
+	X87Float80 result;
+	if (softFloat80CheckOperands(a, b, aClass, bClass, statusWord, &result)) {
+		return result;
+	}
+
+	softFloat80CheckDenormal(a, b, statusWord);
+
+	bool aSign = softFloat80Sign(a);
+	bool bSign = softFloat80Sign(b) != negateB;
+
+	if (aClass == SoftFloat80Class::kInfinity || bClass == SoftFloat80Class::kInfinity) {
+		if (aClass == bClass && aSign != bSign) {
+			*statusWord |= X87StatusWordFlag::kInvalidOperation;
+			return softFloat80Indefinite();
+		}
+		return softFloat80Make(aClass == SoftFloat80Class::kInfinity ? aSign : bSign, kFloat80MaxExponent, kFloat80IntegerBit);
+	}
+	if (aClass == SoftFloat80Class::kZero && bClass == SoftFloat80Class::kZero) {
+		// exact zero sums are positive except when rounding down
+		const bool sign = aSign == bSign ? aSign : (controlWord & X87ControlWord::kRoundingControlMask) == X87ControlWord::kRoundDown;
+		return softFloat80Make(sign, 0, 0);
+	}
+	if (aClass == SoftFloat80Class::kZero) {
+		return softFloat80Round(softFloat80Make(bSign, b.exponent & kFloat80MaxExponent, b.mantissa), controlWord, statusWord);
+	}
+	if (bClass == SoftFloat80Class::kZero) {
+		return softFloat80Round(a, controlWord, statusWord);
+	}
+
+	int32_t aExponent, bExponent;
+	uint64_t aMantissa = softFloat80Normalize(a, &aExponent);
+	uint64_t bMantissa = softFloat80Normalize(b, &bExponent);
+
+	// a is the operand with the larger magnitude
+	if (aExponent < bExponent || (aExponent == bExponent && aMantissa < bMantissa)) {
+		std::swap(aExponent, bExponent);
+		std::swap(aMantissa, bMantissa);
+		std::swap(aSign, bSign);
+	}
+
+	// integer bits at 126, the sum cannot carry out of 128 bits
+	const UInt128 aSignificand = static_cast<UInt128>(aMantissa) << 63;
+	const UInt128 bSignificand = softFloat80ShiftRightJamming(static_cast<UInt128>(bMantissa) << 63, static_cast<uint32_t>(aExponent - bExponent));
+
+	UInt128 significand;
+	if (aSign == bSign) {
+		significand = aSignificand + bSignificand;
+	} else {
+		significand = aSignificand - bSignificand;
+		if (significand == 0) {
+			return softFloat80Make((controlWord & X87ControlWord::kRoundingControlMask) == X87ControlWord::kRoundDown, 0, 0);
+		}
+	}
+
+	const int32_t shift = softFloat80CountLeadingZeros(significand);
+	return softFloat80RoundPack(aSign, aExponent + 1 - shift, significand << shift, controlWord, statusWord);
+}
+
+inline auto softFloat80Add(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	return softFloat80AddSub(a, b, false, controlWord, statusWord);
+}
+
+inline auto softFloat80Sub(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	return softFloat80AddSub(a, b, true, controlWord, statusWord);
+}
+
+inline auto softFloat80Mul(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	const auto aClass = softFloat80Classify(a);
+	const auto bClass = softFloat80Classify(b);
+	X87Float80 result;
+	if (softFloat80CheckOperands(a, b, aClass, bClass, statusWord, &result)) {
+		return result;
+	}
+
+	softFloat80CheckDenormal(a, b, statusWord);
+
+	const bool sign = softFloat80Sign(a) != softFloat80Sign(b);
+	if (aClass == SoftFloat80Class::kInfinity || bClass == SoftFloat80Class::kInfinity) {
+		if (aClass == SoftFloat80Class::kZero || bClass == SoftFloat80Class::kZero) {
+			*statusWord |= X87StatusWordFlag::kInvalidOperation;
+			return softFloat80Indefinite();
+		}
+		return softFloat80Make(sign, kFloat80MaxExponent, kFloat80IntegerBit);
+	}
+	if (aClass == SoftFloat80Class::kZero || bClass == SoftFloat80Class::kZero) {
+		return softFloat80Make(sign, 0, 0);
+	}
+
+	int32_t aExponent, bExponent;
+	const uint64_t aMantissa = softFloat80Normalize(a, &aExponent);
+	const uint64_t bMantissa = softFloat80Normalize(b, &bExponent);
+
+	// the product of two integer bits lands at bit 126 or 127
+	UInt128 significand = static_cast<UInt128>(aMantissa) * bMantissa;
+	int32_t exponent = aExponent + bExponent - kFloat80Bias + 1;
+	if ((significand >> 127) == 0) {
+		significand <<= 1;
+		exponent--;
+	}
+	return softFloat80RoundPack(sign, exponent, significand, controlWord, statusWord);
+}
+
+inline auto softFloat80Div(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	const auto aClass = softFloat80Classify(a);
+	const auto bClass = softFloat80Classify(b);
+	X87Float80 result;
+	if (softFloat80CheckOperands(a, b, aClass, bClass, statusWord, &result)) {
+		return result;
+	}
+
+	const bool sign = softFloat80Sign(a) != softFloat80Sign(b);
+	// a zero divisor takes precedence over the denormal flag
+	if (bClass == SoftFloat80Class::kZero) {
+		if (aClass == SoftFloat80Class::kZero) {
+			*statusWord |= X87StatusWordFlag::kInvalidOperation;
+			return softFloat80Indefinite();
+		}
+		if (aClass != SoftFloat80Class::kInfinity) {
+			*statusWord |= X87StatusWordFlag::kZeroDivide;
+		}
+		return softFloat80Make(sign, kFloat80MaxExponent, kFloat80IntegerBit);
+	}
+	softFloat80CheckDenormal(a, b, statusWord);
+
+	if (aClass == SoftFloat80Class::kInfinity) {
+		if (bClass == SoftFloat80Class::kInfinity) {
+			*statusWord |= X87StatusWordFlag::kInvalidOperation;
+			return softFloat80Indefinite();
+		}
+		return softFloat80Make(sign, kFloat80MaxExponent, kFloat80IntegerBit);
+	}
+	if (bClass == SoftFloat80Class::kInfinity) {
+		return softFloat80Make(sign, 0, 0);
+	}
+	if (aClass == SoftFloat80Class::kZero) {
+		return softFloat80Make(sign, 0, 0);
+	}
+
+	int32_t aExponent, bExponent;
+	const uint64_t aMantissa = softFloat80Normalize(a, &aExponent);
+	const uint64_t bMantissa = softFloat80Normalize(b, &bExponent);
+
+	// 128 quotient bits with the leading one at bit 127, the dividend is halved
+	// when its mantissa is not below the divisor's
+	int32_t exponent = aExponent - bExponent + kFloat80Bias;
+	uint64_t high = aMantissa;
+	uint64_t low = 0;
+	if (aMantissa >= bMantissa) {
+		high = aMantissa >> 1;
+		low = aMantissa << 63;
+	} else {
+		exponent--;
+	}
+
+	uint64_t remainder;
+	const uint64_t quotientHigh = softFloat80Divide128(high, low, bMantissa, &remainder);
+	const uint64_t quotientLow = softFloat80Divide128(remainder, 0, bMantissa, &remainder);
+	const UInt128 significand = (static_cast<UInt128>(quotientHigh) << 64) | quotientLow | (remainder != 0);
+	return softFloat80RoundPack(sign, exponent, significand, controlWord, statusWord);
+}
+
+inline auto softFloat80Sqrt(X87Float80 a, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	const auto aClass = softFloat80Classify(a);
+	X87Float80 result;
+	if (softFloat80CheckOperands(a, a, aClass, aClass, statusWord, &result)) {
+		return result;
+	}
+	if (aClass == SoftFloat80Class::kZero) {
+		return a;
+	}
+	if (softFloat80Sign(a)) {
+		*statusWord |= X87StatusWordFlag::kInvalidOperation;
+		return softFloat80Indefinite();
+	}
+	if (aClass == SoftFloat80Class::kInfinity) {
+		return a;
+	}
+	softFloat80CheckDenormal(a, a, statusWord);
+
+	int32_t aExponent;
+	const uint64_t aMantissa = softFloat80Normalize(a, &aExponent);
+
+	// sqrt(m * 2^e) with an even e, the radicand has its leading one at bit
+	// 126 or 127 so the root has exactly 64 bits
+	const int32_t unbiased = aExponent - kFloat80Bias;
+	const UInt128 radicand = static_cast<UInt128>(aMantissa) << ((unbiased & 1) != 0 ? 64 : 63);
+
+	const double estimate = std::sqrt(static_cast<double>(static_cast<uint64_t>(radicand >> 64)) * 0x1p64 + static_cast<double>(static_cast<uint64_t>(radicand)));
+	uint64_t root = estimate >= 0x1p64 ? ~0ULL : static_cast<uint64_t>(estimate);
+
+	// one Newton step takes the estimate from about 2^12 to within a unit
+	const UInt128 square = static_cast<UInt128>(root) * root;
+	const UInt128 difference = square > radicand ? square - radicand : radicand - square;
+	uint64_t unused;
+	const uint64_t step = softFloat80Divide128(static_cast<uint64_t>(difference >> 64), static_cast<uint64_t>(difference), root, &unused) >> 1;
+	root = square > radicand ? root - step : root + step;
+	while (static_cast<UInt128>(root) * root > radicand) {
+		root--;
+	}
+	while (root != ~0ULL && static_cast<UInt128>(root + 1) * (root + 1) <= radicand) {
+		root++;
+	}
+
+	// the root is never exactly halfway, remainder > root means above half
+	const UInt128 remainder = radicand - static_cast<UInt128>(root) * root;
+	const UInt128 significand = (static_cast<UInt128>(root) << 64) | (remainder > root ? kFloat80IntegerBit : 0) | (remainder != 0);
+	return softFloat80RoundPack(false, (unbiased >> 1) + kFloat80Bias, significand, controlWord, statusWord);
+}
+
+// Orders a and b. Unordered operands raise an invalid operation if either is
+// a signaling NaN, or any NaN unless quiet is set (fucom).
+inline auto softFloat80Compare(X87Float80 a, X87Float80 b, bool quiet, uint16_t *statusWord) -> SoftFloat80Order {
+	const auto aClass = softFloat80Classify(a);
+	const auto bClass = softFloat80Classify(b);
+	if (aClass == SoftFloat80Class::kUnsupported || bClass == SoftFloat80Class::kUnsupported) {
+		*statusWord |= X87StatusWordFlag::kInvalidOperation;
+		return SoftFloat80Order::kUnordered;
+	}
+	if (aClass == SoftFloat80Class::kNaN || bClass == SoftFloat80Class::kNaN) {
+		const bool signaling = (aClass == SoftFloat80Class::kNaN && softFloat80IsSignaling(a)) || (bClass == SoftFloat80Class::kNaN && softFloat80IsSignaling(b));
+		if (signaling || !quiet) {
+			*statusWord |= X87StatusWordFlag::kInvalidOperation;
+		}
+		return SoftFloat80Order::kUnordered;
+	}
+	if (softFloat80IsDenormal(a) || softFloat80IsDenormal(b)) {
+		*statusWord |= X87StatusWordFlag::kDenormalizedOperand;
+	}
+	if (aClass == SoftFloat80Class::kZero && bClass == SoftFloat80Class::kZero) {
+		return SoftFloat80Order::kEqual;
+	}
+
+	const bool aSign = softFloat80Sign(a);
+	const bool bSign = softFloat80Sign(b);
+	if (aSign != bSign) {
+		return aSign ? SoftFloat80Order::kLess : SoftFloat80Order::kGreater;
+	}
+
+	// magnitudes order like (exponent, mantissa), pseudo-denormals count as exponent 1
+	const auto key = [](X87Float80 value) -> UInt128 {
+		uint32_t exponent = value.exponent & kFloat80MaxExponent;
+		if (exponent == 0 && (value.mantissa & kFloat80IntegerBit) != 0) {
+			exponent = 1;
+		}
+		return (static_cast<UInt128>(exponent) << 64) | value.mantissa;
+	};
+	const UInt128 aKey = key(a);
+	const UInt128 bKey = key(b);
+	if (aKey == bKey) {
+		return SoftFloat80Order::kEqual;
+	}
+	return (aKey < bKey) != aSign ? SoftFloat80Order::kLess : SoftFloat80Order::kGreater;
+}
+
+// Exact conversions of memory operands. NaNs keep their signaling state so
+// that the operation using them raises the invalid operation, denormals raise
+// the denormal flag.
+inline auto softFloat80FromFloat32(uint32_t bits, uint16_t *statusWord) -> X87Float80 {
+	const bool sign = (bits >> 31) != 0;
+	const int32_t exponent = (bits >> 23) & 0xFF;
+	const uint64_t fraction = bits & 0x7FFFFF;
+	if (exponent == 0xFF) {
+		return softFloat80Make(sign, kFloat80MaxExponent, kFloat80IntegerBit | (fraction << 40));
+	}
+	if (exponent == 0) {
+		if (fraction == 0) {
+			return softFloat80Make(sign, 0, 0);
+		}
+		*statusWord |= X87StatusWordFlag::kDenormalizedOperand;
+		const int shift = __builtin_clzll(fraction);
+		return softFloat80Make(sign, kFloat80Bias - 126 - (shift - 40), fraction << shift);
+	}
+	return softFloat80Make(sign, exponent - 127 + kFloat80Bias, kFloat80IntegerBit | (fraction << 40));
+}
+
+inline auto softFloat80FromFloat64(uint64_t bits, uint16_t *statusWord) -> X87Float80 {
+	const bool sign = (bits >> 63) != 0;
+	const int32_t exponent = (bits >> 52) & 0x7FF;
+	const uint64_t fraction = bits & 0xFFFFFFFFFFFFFULL;
+	if (exponent == 0x7FF) {
+		return softFloat80Make(sign, kFloat80MaxExponent, kFloat80IntegerBit | (fraction << 11));
+	}
+	if (exponent == 0) {
+		if (fraction == 0) {
+			return softFloat80Make(sign, 0, 0);
+		}
+		*statusWord |= X87StatusWordFlag::kDenormalizedOperand;
+		const int shift = __builtin_clzll(fraction);
+		return softFloat80Make(sign, kFloat80Bias - 1022 - (shift - 11), fraction << shift);
+	}
+	return softFloat80Make(sign, exponent - 1023 + kFloat80Bias, kFloat80IntegerBit | (fraction << 11));
+}
+
+inline auto softFloat80FromInt32(int32_t value) -> X87Float80 {
+	if (value == 0) {
+		return softFloat80Make(false, 0, 0);
+	}
+	const uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+	const int shift = __builtin_clzll(magnitude);
+	return softFloat80Make(value < 0, kFloat80Bias + 63 - shift, magnitude << shift);
+}
@@ -4,17 +4,31 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <utility>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "Log.h"
 #include "X87Float80.h"
 #include "X87StackRegister.h"
 
 // Option to convert 64 bit float to 80 bit x87 format to be compatible with
 // original rosetta x87 implementation This must be used if you want to
-// selectively enable x87 instructions.
+// selectively enable x87 instructions or use the exact handlers. Also set by
+// the ROSETTA_X87_FP80 CMake option.
 // #define X87_CONVERT_TO_FP80
 
+// With X87_LAZY_TAG_WORD (ROSETTA_X87_LAZY_TAGS CMake option) stores only mark
+// a register as non-empty instead of classifying the value as zero, special or
+// valid. The handlers that need the full tag call getStTagFull, which
+// classifies the stored value on demand. The empty bits are always exact,
+// which is all the abridged FXSAVE tag byte encodes, but fstenv and fsave run
+// in Rosetta and read the tag word as stored, so they report every non-empty
+// register as valid.
+
 enum X87StatusWordFlag : uint16_t {
 	// Exception flags
 	kInvalidOperation = 0x0001,    // Invalid Operation Exception
@@ -151,8 +165,9 @@ return_float32:
 	result.u = bits;
 	return result.f;
 }
+#endif
 
-inline X87Float80 ConvertFloat64ToX87Register(double value, uint16_t *statusFlags) {
+inline X87Float80 ConvertFloat64ToX87RegisterSlow(double value, uint16_t *statusFlags) {
 	X87Float80 result;
 	union {
 		double v;
@@ -186,8 +201,9 @@ inline X87Float80 ConvertFloat64ToX87Register(double value, uint16_t *statusFlag
 	if (exp == 0) {
 		if (statusFlags)
 			*statusFlags |= X87StatusWordFlag::kDenormalizedOperand;
+		// move the leading one to the implicit bit position 52
 		int shift = __builtin_clzll(mantissa) - 11;
-		mantissa <<= (shift + 1);
+		mantissa <<= shift;
 		exp = 1 - shift;
 	}
 
@@ -198,9 +214,7 @@ inline X87Float80 ConvertFloat64ToX87Register(double value, uint16_t *statusFlag
 	return result;
 }
 
-#endif
-
-double inline ConvertX87RegisterToFloat64(X87Float80 x87, uint16_t *statusFlags) {
+double inline ConvertX87RegisterToFloat64Slow(X87Float80 x87, uint16_t *statusFlags) {
 	uint64_t mantissa = x87.mantissa;
 	uint16_t biasedExp = x87.exponent & 0x7FFF;
 	uint64_t sign = (x87.exponent & 0x8000) ? 0x8000000000000000ULL : 0;
@@ -277,6 +291,241 @@ double inline ConvertX87RegisterToFloat64(X87Float80 x87, uint16_t *statusFlags)
 	return result.value;
 }
 
+// The registers hold doubles stored by the native handlers most of the time.
+// Those convert in both directions by moving the exponent and the mantissa,
+// without flags, zeros, specials and values needing rounding take the full
+// conversions above.
+__attribute__((always_inline)) inline auto ConvertFloat64ToX87Register(double value, uint16_t *statusFlags) -> X87Float80 {
+	const auto bits = std::bit_cast<uint64_t>(value);
+	const uint64_t biasedExp = (bits >> 52) & 0x7FF;
+	if (biasedExp - 1 < 0x7FE) [[likely]] {
+		X87Float80 result;
+		result.exponent = static_cast<uint16_t>(((bits >> 48) & 0x8000) | (biasedExp - 1023 + 16383));
+		result.mantissa = (bits << 11) | 0x8000000000000000ULL;
+		return result;
+	}
+	return ConvertFloat64ToX87RegisterSlow(value, statusFlags);
+}
+
+__attribute__((always_inline)) inline auto ConvertX87RegisterToFloat64(X87Float80 x87, uint16_t *statusFlags) -> double {
+	const uint32_t biasedExp = x87.exponent & 0x7FFF;
+	// normal in double range, integer bit set and the 11 bits below the double
+	// mantissa clear
+	if (biasedExp - (16383 - 1022) < 2046 && (x87.mantissa & 0x80000000000007FFULL) == 0x8000000000000000ULL) [[likely]] {
+		return std::bit_cast<double>((static_cast<uint64_t>(x87.exponent & 0x8000) << 48) | (static_cast<uint64_t>(biasedExp - 16383 + 1023) << 52) |
+		                             ((x87.mantissa >> 11) & 0x000FFFFFFFFFFFFFULL));
+	}
+	return ConvertX87RegisterToFloat64Slow(x87, statusFlags);
+}
+
+// Batch conversions of a whole register file, for state import and export.
+// Register i is the X87Float80 registerStride bytes after register i - 1 and
+// pairs with values[(first + i) & 7], so the register stack can be rotated by
+// the top of stack on the way. No status flags are raised. Normal values and
+// zeros convert with masks instead of branches, two lanes per instruction with
+// NEON, every other lane takes the scalar conversion afterwards. Without NEON
+// the lanes run one at a time through the same masks.
+constexpr uint32_t kRegisterFileSize = 8;
+
+// One lane of ConvertFloat64ToX87Registers, the NEON masks on a single value.
+// Returns false if the lane has to be converted by
+// ConvertFloat64ToX87RegisterSlow.
+__attribute__((always_inline)) inline auto ConvertFloat64ToX87Lane(uint64_t value, X87Float80 *result) -> bool {
+	const uint64_t biasedExp = (value >> 52) & 0x7FF;
+	const uint64_t normal = 0 - static_cast<uint64_t>(biasedExp - 1 < 0x7FE);
+	const uint64_t zero = 0 - static_cast<uint64_t>((value << 1) == 0);
+	result->mantissa = ((value << 11) | 0x8000000000000000ULL) & normal;
+	result->exponent = static_cast<uint16_t>(((value >> 48) & 0x8000) | ((biasedExp + 16383 - 1023) & normal));
+	return ((normal | zero) & 1) != 0;
+}
+
+// One lane of ConvertX87RegistersToFloat64. Returns false if the lane has to
+// be converted by ConvertX87RegisterToFloat64Slow.
+__attribute__((always_inline)) inline auto ConvertX87ToFloat64Lane(X87Float80 x87, uint64_t *result) -> bool {
+	const uint64_t mantissa = x87.mantissa;
+	const uint64_t exponent = x87.exponent;
+	const uint64_t biasedExp = exponent & 0x7FFF;
+	const uint64_t normal = (0 - static_cast<uint64_t>(biasedExp - (16383 - 1022) < 2046)) & static_cast<uint64_t>(static_cast<int64_t>(mantissa) >> 63);
+	const uint64_t zero = 0 - static_cast<uint64_t>((mantissa | biasedExp) == 0);
+
+	// rounds to nearest even like the NEON lanes
+	const uint64_t sticky = (mantissa & 0x3FF) != 0;
+	const uint64_t lsb = (mantissa >> 11) & 1;
+	const uint64_t round = (mantissa >> 10) & (sticky | lsb) & 1;
+	const uint64_t packed = (((biasedExp + 1023 - 16383) << 52) | ((mantissa >> 11) & 0x000FFFFFFFFFFFFFULL)) + round;
+	*result = ((exponent & 0x8000) << 48) | (packed & normal);
+	return ((normal | zero) & 1) != 0;
+}
+
+__attribute__((always_inline)) inline auto registerAt(X87Float80 *registers, size_t registerStride, uint32_t i) -> X87Float80 * {
+	return reinterpret_cast<X87Float80 *>(reinterpret_cast<uint8_t *>(registers) + i * registerStride);
+}
+
+__attribute__((always_inline)) inline auto registerAt(const X87Float80 *registers, size_t registerStride, uint32_t i) -> const X87Float80 * {
+	return reinterpret_cast<const X87Float80 *>(reinterpret_cast<const uint8_t *>(registers) + i * registerStride);
+}
+
+inline auto ConvertFloat64ToX87Registers(const double *values, uint32_t first, X87Float80 *registers, size_t registerStride) -> void {
+#if defined(__ARM_NEON)
+	const auto *bits = reinterpret_cast<const uint64_t *>(values);
+	uint32_t special = 0;
+	const uint64x2_t one = vdupq_n_u64(1);
+	for (uint32_t i = 0; i < kRegisterFileSize; i += 2) {
+		const uint64x2_t value = vcombine_u64(vld1_u64(&bits[(first + i) & 7]), vld1_u64(&bits[(first + i + 1) & 7]));
+		const uint64x2_t biasedExp = vandq_u64(vshrq_n_u64(value, 52), vdupq_n_u64(0x7FF));
+		const uint64x2_t normal = vcltq_u64(vsubq_u64(biasedExp, one), vdupq_n_u64(0x7FE));
+		const uint64x2_t zero = vceqzq_u64(vshlq_n_u64(value, 1));
+		const uint64x2_t mantissa = vandq_u64(vorrq_u64(vshlq_n_u64(value, 11), vdupq_n_u64(0x8000000000000000ULL)), normal);
+		const uint64x2_t exponent =
+			vorrq_u64(vandq_u64(vshrq_n_u64(value, 48), vdupq_n_u64(0x8000)), vandq_u64(vaddq_u64(biasedExp, vdupq_n_u64(16383 - 1023)), normal));
+		const uint64x2_t handled = vorrq_u64(normal, zero);
+
+		vst1q_lane_u64(&registerAt(registers, registerStride, i)->mantissa, mantissa, 0);
+		vst1q_lane_u64(&registerAt(registers, registerStride, i + 1)->mantissa, mantissa, 1);
+		registerAt(registers, registerStride, i)->exponent = static_cast<uint16_t>(vgetq_lane_u64(exponent, 0));
+		registerAt(registers, registerStride, i + 1)->exponent = static_cast<uint16_t>(vgetq_lane_u64(exponent, 1));
+		special |= static_cast<uint32_t>((~vgetq_lane_u64(handled, 0) & 1) | ((~vgetq_lane_u64(handled, 1) & 1) << 1)) << i;
+	}
+#else
+	const auto *bits = reinterpret_cast<const uint64_t *>(values);
+	uint32_t special = 0;
+	for (uint32_t i = 0; i < kRegisterFileSize; i++) {
+		special |= static_cast<uint32_t>(!ConvertFloat64ToX87Lane(bits[(first + i) & 7], registerAt(registers, registerStride, i))) << i;
+	}
+#endif
+	while (special != 0) {
+		const uint32_t i = __builtin_ctz(special);
+		*registerAt(registers, registerStride, i) = ConvertFloat64ToX87RegisterSlow(values[(first + i) & 7], nullptr);
+		special &= special - 1;
+	}
+}
+
+inline auto ConvertX87RegistersToFloat64(const X87Float80 *registers, size_t registerStride, double *values, uint32_t first) -> void {
+#if defined(__ARM_NEON)
+	auto *bits = reinterpret_cast<uint64_t *>(values);
+	uint32_t special = 0;
+	const uint64x2_t one = vdupq_n_u64(1);
+	for (uint32_t i = 0; i < kRegisterFileSize; i += 2) {
+		const X87Float80 *low = registerAt(registers, registerStride, i);
+		const X87Float80 *high = registerAt(registers, registerStride, i + 1);
+		const uint64x2_t mantissa = vcombine_u64(vcreate_u64(low->mantissa), vcreate_u64(high->mantissa));
+		const uint64x2_t exponent = vcombine_u64(vcreate_u64(low->exponent), vcreate_u64(high->exponent));
+
+		const uint64x2_t biasedExp = vandq_u64(exponent, vdupq_n_u64(0x7FFF));
+		const uint64x2_t normal = vandq_u64(vcltq_u64(vsubq_u64(biasedExp, vdupq_n_u64(16383 - 1022)), vdupq_n_u64(2046)),
+		                                    vreinterpretq_u64_s64(vshrq_n_s64(vreinterpretq_s64_u64(mantissa), 63)));
+		const uint64x2_t zero = vceqzq_u64(vorrq_u64(mantissa, biasedExp));
+
+		// rounds to nearest even by adding the round bit to the packed double, a
+		// carry moves into the exponent and may reach infinity
+		const uint64x2_t sticky = vandq_u64(vtstq_u64(mantissa, vdupq_n_u64(0x3FF)), one);
+		const uint64x2_t lsb = vandq_u64(vshrq_n_u64(mantissa, 11), one);
+		const uint64x2_t round = vandq_u64(vshrq_n_u64(mantissa, 10), vandq_u64(vorrq_u64(sticky, lsb), one));
+		const uint64x2_t packed = vaddq_u64(vorrq_u64(vshlq_n_u64(vaddq_u64(biasedExp, vdupq_n_u64(1023 - 16383)), 52),
+		                                              vandq_u64(vshrq_n_u64(mantissa, 11), vdupq_n_u64(0x000FFFFFFFFFFFFFULL))),
+		                                    round);
+		const uint64x2_t sign = vshlq_n_u64(vandq_u64(exponent, vdupq_n_u64(0x8000)), 48);
+		const uint64x2_t result = vorrq_u64(sign, vandq_u64(packed, normal));
+
+		vst1q_lane_u64(&bits[(first + i) & 7], result, 0);
+		vst1q_lane_u64(&bits[(first + i + 1) & 7], result, 1);
+		const uint64x2_t handled = vorrq_u64(normal, zero);
+		special |= static_cast<uint32_t>((~vgetq_lane_u64(handled, 0) & 1) | ((~vgetq_lane_u64(handled, 1) & 1) << 1)) << i;
+	}
+#else
+	auto *bits = reinterpret_cast<uint64_t *>(values);
+	uint32_t special = 0;
+	for (uint32_t i = 0; i < kRegisterFileSize; i++) {
+		special |= static_cast<uint32_t>(!ConvertX87ToFloat64Lane(*registerAt(registers, registerStride, i), &bits[(first + i) & 7])) << i;
+	}
+#endif
+	while (special != 0) {
+		const uint32_t i = __builtin_ctz(special);
+		values[(first + i) & 7] = ConvertX87RegisterToFloat64Slow(*registerAt(registers, registerStride, i), nullptr);
+		special &= special - 1;
+	}
+}
+
+// Rounds the result of an operation to odd, given a value with the sign of the
+// rounding error, exact result minus value, or zero if the result is exact.
+// Inexact results are truncated toward zero and get their last bit set, which
+// keeps a later rounding to 24 bits from rounding a second time: 53 bits are
+// more than the 2 * 24 + 2 this needs.
+__attribute__((always_inline)) inline auto roundToOdd(double value, double error) -> double {
+	auto bits = std::bit_cast<uint64_t>(value);
+	// exact, or an infinity or NaN whose error is not meaningful
+	if (!(error > 0 || error < 0) || (bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL) {
+		return value;
+	}
+
+	if (value == 0) {
+		// underflowed to zero, the exact result lies on the side of the error
+		bits = error < 0 ? 0x8000000000000000ULL : 0;
+	} else if ((error < 0) != (value < 0)) {
+		// the exact result is smaller in magnitude
+		bits -= 1;
+	}
+	return std::bit_cast<double>(bits | 1);
+}
+
+// Rounds the significand to 24 bits in the given x87 rounding control,
+// keeping the double exponent range. This is what the x87 does to the results
+// of fadd, fsub, fmul, fdiv and fsqrt when the precision control is set to 24
+// bits. To match rounding the exact result, the value has to be rounded to odd
+// when rounding to nearest, and in the same direction otherwise.
+__attribute__((always_inline)) inline auto roundToPrecision24(double value, uint16_t rounding) -> double {
+	constexpr uint64_t kDropped = 0x1FFFFFFFULL;
+
+	auto bits = std::bit_cast<uint64_t>(value);
+	// infinities and NaNs keep their payload
+	if ((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL) {
+		return value;
+	}
+
+	// rounding away from zero adds just below one unit in the last place and
+	// truncates, a carry into the exponent is the next binade or infinity
+	const bool negative = (bits >> 63) != 0;
+	switch (rounding) {
+	case X87ControlWord::kRoundToNearest:
+		bits += (kDropped >> 1) + ((bits >> 29) & 1);
+		break;
+	case X87ControlWord::kRoundDown:
+		bits += negative ? kDropped : 0;
+		break;
+	case X87ControlWord::kRoundUp:
+		bits += negative ? 0 : kDropped;
+		break;
+	default:
+		break;
+	}
+	return std::bit_cast<double>(bits & ~kDropped);
+}
+
+// Classifies a stored value the way the x87 tag word does.
+__attribute__((always_inline)) inline auto classifyTag(double value) -> X87TagState {
+	if (value == 0.0) {
+		return X87TagState::kZero;
+	}
+	if (std::isnan(value) || std::isinf(value) || std::fpclassify(value) == FP_SUBNORMAL) {
+		return X87TagState::kSpecial;
+	}
+	return X87TagState::kValid;
+}
+
+#if defined(X87_CONVERT_TO_FP80)
+__attribute__((always_inline)) inline auto classifyTag(X87Float80 value) -> X87TagState {
+	const uint16_t biasedExp = value.exponent & 0x7FFF;
+	if (biasedExp == 0) {
+		return value.mantissa == 0 ? X87TagState::kZero : X87TagState::kSpecial;
+	}
+	// NaN, infinity and unnormals (integer bit clear)
+	if (biasedExp == 0x7FFF || (value.mantissa >> 63) == 0) {
+		return X87TagState::kSpecial;
+	}
+	return X87TagState::kValid;
+}
+#endif
+
 #pragma pack(push, 1)
 struct X87State {
 	uint16_t controlWord;
@@ -297,6 +546,36 @@ struct X87State {
 		}
 	}
 
+	// With X87_PRECISION_CONTROL, true if the control word selects 24 bit
+	// precision, as Direct3D 9 does by default.
+	__attribute__((always_inline)) auto isPrecision24() const -> bool {
+#if defined(X87_PRECISION_CONTROL)
+		return (controlWord & X87ControlWord::kPrecisionControl) == X87ControlWord::kPrecision24Bit;
+#else
+		return false;
+#endif
+	}
+
+	// Rounds the result of an arithmetic instruction to the precision control.
+	// Doubles already carry the 53 bit precision, 64 bit precision is out of
+	// reach. error computes the sign of the rounding error of value, see
+	// roundToOdd, and is only called for 24 bit precision.
+	template <typename Error>
+	__attribute__((always_inline)) auto roundToPrecision(double value, Error error) const -> double {
+		if (!isPrecision24()) {
+			return value;
+		}
+#if defined(X87_ROUNDING_CONTROL)
+		// the handlers run in the directed modes, rounding twice in the same
+		// direction rounds like once
+		const uint16_t rounding = controlWord & X87ControlWord::kRoundingControlMask;
+		if (rounding != X87ControlWord::kRoundToNearest) {
+			return roundToPrecision24(value, rounding);
+		}
+#endif
+		return roundToPrecision24(roundToOdd(value, error()), X87ControlWord::kRoundToNearest);
+	}
+
 	// Get index of top register
 	auto topIndex() const -> uint32_t {
 		return (statusWord >> 11) & 7;
@@ -362,11 +641,32 @@ struct X87State {
 #endif
 	}
 
+	// Tag bits as stored. With X87_LAZY_TAG_WORD only kEmpty is reliable, every
+	// other register reads as kValid.
 	__attribute__((always_inline)) auto getStTag(uint32_t stOffset) const -> X87TagState {
 		const uint32_t regIdx = getStIndex(stOffset);
 		return static_cast<X87TagState>((tagWord >> (regIdx * 2)) & 3);
 	}
 
+	// Tag of the physical register regIdx, classifying the value if tags are lazy.
+	auto getRegisterTagFull(uint32_t regIdx) const -> X87TagState {
+		const auto tag = static_cast<X87TagState>((tagWord >> (regIdx * 2)) & 3);
+#if defined(X87_LAZY_TAG_WORD)
+		if (tag != X87TagState::kEmpty) {
+#if defined(X87_CONVERT_TO_FP80)
+			return classifyTag(st[regIdx]);
+#else
+			return classifyTag(st[regIdx].ieee754);
+#endif
+		}
+#endif
+		return tag;
+	}
+
+	auto getStTagFull(uint32_t stOffset) const -> X87TagState {
+		return getRegisterTagFull(getStIndex(stOffset));
+	}
+
 	// Push value to FPU stack
 	auto push() -> void {
 		const int currentTop = topIndex();
@@ -393,18 +693,20 @@ struct X87State {
 #else
 		st[stIdx].ieee754 = value;
 #endif
-		X87TagState tag;
-		if (value == 0.0) {
-			tag = X87TagState::kZero;
-		} else if (std::isnan(value) || std::isinf(value) || std::fpclassify(value) == FP_SUBNORMAL) {
-			tag = X87TagState::kSpecial;
-		} else {
-			tag = X87TagState::kValid;
-		}
 
-		// Clear existing tag bits and set new state
+#if defined(X87_LAZY_TAG_WORD)
+		// Only mark the register non-empty, the tag is classified on demand
+		tagWord &= ~(3 << (stIdx * 2));
+#else
+		// Clear existing tag bits and set new state, classifying the register
+		// as stored: denormal doubles are normal in 80 bits
 		tagWord &= ~(3 << (stIdx * 2));
-		tagWord |= (static_cast<int>(tag) << (stIdx * 2));
+#if defined(X87_CONVERT_TO_FP80)
+		tagWord |= (static_cast<int>(classifyTag(st[stIdx])) << (stIdx * 2));
+#else
+		tagWord |= (static_cast<int>(classifyTag(value)) << (stIdx * 2));
+#endif
+#endif
 	}
 
 	__attribute__((always_inline)) auto setStFast(uint32_t stOffset, double value) -> void {
@@ -0,0 +1,59 @@
+/*-
+ * ====================================================
+ * Copyright (C) 1993 by Sun Microsystems, Inc. All rights reserved.
+ *
+ * Developed at SunSoft, a Sun Microsystems, Inc. business.
+ * Permission to use, copy, modify, and distribute this
+ * software is freely granted, provided that this notice
+ * is preserved.
+ * ====================================================
+ *
+ * k_sin.c and k_cos.c merged by Steven G. Kargl.
+ */
+
+//__FBSDID("$FreeBSD: src/lib/msun/src/k_sincos.h,v 1.1 2017/03/06 22:56:39 kargl Exp $");
+
+/* __kernel_sincos( x, y, iy, sn, cs)
+ * kernel sin and cos functions on ~[-pi/4, pi/4], evaluated together so that
+ * x*x and x*x*x*x are only computed once. See k_sin.h and k_cos.h for the
+ * algorithms, the polynomials are the same.
+ */
+
+#include "math_private.h"
+
+static inline __attribute__((always_inline))
+void
+__kernel_sincos(double x, double y, int iy, double *sn, double *cs) {
+	static const double
+		half = 5.00000000000000000000e-01, /* 0x3FE00000, 0x00000000 */
+		one = 1.00000000000000000000e+00,  /* 0x3FF00000, 0x00000000 */
+		S1 = -1.66666666666666324348e-01,  /* 0xBFC55555, 0x55555549 */
+		S2 = 8.33333333332248946124e-03,   /* 0x3F811111, 0x1110F8A6 */
+		S3 = -1.98412698298579493134e-04,  /* 0xBF2A01A0, 0x19C161D5 */
+		S4 = 2.75573137070700676789e-06,   /* 0x3EC71DE3, 0x57B1FE7D */
+		S5 = -2.50507602534068634195e-08,  /* 0xBE5AE5E6, 0x8A2B9CEB */
+		S6 = 1.58969099521155010221e-10,   /* 0x3DE5D93A, 0x5ACFD57C */
+		C1 = 4.16666666666666019037e-02,   /* 0x3FA55555, 0x5555554C */
+		C2 = -1.38888888888741095749e-03,  /* 0xBF56C16C, 0x16C15177 */
+		C3 = 2.48015872894767294178e-05,   /* 0x3EFA01A0, 0x19CB1590 */
+		C4 = -2.75573143513906633035e-07,  /* 0xBE927E4F, 0x809C52AD */
+		C5 = 2.08757232129817482790e-09,   /* 0x3E21EE9E, 0xBDB4B1C4 */
+		C6 = -1.13596475577881948265e-11;  /* 0xBDA8FAE9, 0xBE8838D4 */
+
+	double hz, r, v, w, z;
+
+	z = x * x;
+	w = z * z;
+	r = S2 + z * (S3 + z * S4) + z * w * (S5 + z * S6);
+	v = z * x;
+
+	if (iy == 0)
+		*sn = x + v * (S1 + z * r);
+	else
+		*sn = x - ((z * (half * y - v * r) - y) - v * S1);
+
+	r = z * (C1 + z * (C2 + z * C3)) + w * w * (C4 + z * (C5 + z * C6));
+	hz = half * z;
+	w = one - hz;
+	*cs = w + (((one - w) - hz) + (z * r - x * y));
+}
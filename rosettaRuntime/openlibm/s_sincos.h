@@ -0,0 +1,91 @@
+/*-
+ * ====================================================
+ * Copyright (C) 1993 by Sun Microsystems, Inc. All rights reserved.
+ *
+ * Developed at SunPro, a Sun Microsystems, Inc. business.
+ * Permission to use, copy, modify, and distribute this
+ * software is freely granted, provided that this notice
+ * is preserved.
+ * ====================================================
+ *
+ * s_sin.c and s_cos.c merged by Steven G. Kargl.  Descriptions of the
+ * algorithms are contained in the original files.
+ */
+
+//__FBSDID("$FreeBSD: src/lib/msun/src/s_sincos.c,v 1.1 2017/03/06 22:56:39 kargl Exp $");
+
+/* sincos(x, sn, cs)
+ * Return sine and cosine of x, sharing one argument reduction.
+ *
+ * kernel function:
+ *      __kernel_sincos         ... sine and cosine function on [-pi/4,pi/4]
+ *      __ieee754_rem_pio2      ... argument reduction routine
+ *
+ * Method.
+ *      Reduce the argument x to y1+y2 = x-k*pi/2 in [-pi/4 , +pi/4] once,
+ *      evaluate S and C together and pick the quadrant as in s_sin.h.
+ *
+ * Special cases:
+ *      sincos(+-INF) is NaN, NaN, with signals;
+ *      sincos(NaN)   is that NaN, that NaN;
+ *
+ * Accuracy:
+ *      Same as openlibm_sin and openlibm_cos.
+ */
+
+#include <float.h>
+
+#include "math_private.h"
+#include "k_sincos.h"
+
+static inline __attribute__((always_inline))
+void
+openlibm_sincos(double x, double *sn, double *cs) {
+	double y[2];
+	int32_t n, ix;
+
+	/* High word of x. */
+	GET_HIGH_WORD(ix, x);
+
+	/* |x| ~< pi/4 */
+	ix &= 0x7fffffff;
+	if (ix <= 0x3fe921fb) {
+		if (ix < 0x3e400000) { /* |x| < 2**-27 */
+			if ((int)x == 0) { /* generate inexact */
+				*sn = x;
+				*cs = 1;
+				return;
+			}
+		}
+		__kernel_sincos(x, 0, 0, sn, cs);
+		return;
+	}
+
+	/* If x = Inf or NaN, then sin(x) = NaN and cos(x) = NaN. */
+	if (ix >= 0x7ff00000) {
+		*sn = x - x;
+		*cs = x - x;
+		return;
+	}
+
+	/* argument reduction needed */
+	n = __ieee754_rem_pio2(x, y);
+
+	switch (n & 3) {
+	case 0:
+		__kernel_sincos(y[0], y[1], 1, sn, cs);
+		break;
+	case 1:
+		__kernel_sincos(y[0], y[1], 1, cs, sn);
+		*cs = -*cs;
+		break;
+	case 2:
+		__kernel_sincos(y[0], y[1], 1, sn, cs);
+		*sn = -*sn;
+		*cs = -*cs;
+		break;
+	default:
+		__kernel_sincos(y[0], y[1], 1, cs, sn);
+		*sn = -*sn;
+	}
+}
@@ -0,0 +1,110 @@
+// Host check of the double-double division and square root of the exact
+// handlers, links against x87core.
+//
+//   x87doubledoubletest [iterations]
+//
+// Compares doubleDouble80Div and doubleDouble80Sqrt bit for bit, results and
+// status words, with the 128 bit engine in every precision and rounding
+// control. Besides random operands it builds the cases the double-double
+// result cannot decide by itself: exact quotients and squares, and quotients
+// within a few units of the last place of a tie. Exits with 1 on any
+// difference.
+
+#include "DoubleDouble.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+constexpr uint16_t kPrecisions[] = {X87ControlWord::kPrecision24Bit, X87ControlWord::kPrecision53Bit, X87ControlWord::kPrecision64Bit};
+constexpr uint16_t kRoundingModes[] = {X87ControlWord::kRoundToNearest, X87ControlWord::kRoundDown, X87ControlWord::kRoundUp, X87ControlWord::kRoundToZero};
+
+size_t failures = 0;
+
+auto randomFloat80(std::mt19937_64 &rng, int range) -> X87Float80 {
+	const auto exponent = static_cast<uint16_t>(kFloat80Bias + static_cast<int>(rng() % (2 * range + 1)) - range);
+	return X87Float80{.mantissa = rng() | kFloat80IntegerBit, .exponent = static_cast<uint16_t>(exponent | ((rng() & 1) << 15))};
+}
+
+// A normal value with the 64 bit significand, shifted up if its top bit is clear.
+auto normalized(unsigned __int128 significand, int32_t exponent) -> X87Float80 {
+	const bool low = (significand >> 63) == 0;
+	return X87Float80{.mantissa = static_cast<uint64_t>(significand << (low ? 1 : 0)), .exponent = static_cast<uint16_t>(exponent - (low ? 1 : 0))};
+}
+
+auto same(X87Float80 result, uint16_t status, X87Float80 expected, uint16_t expectedStatus) -> bool {
+	return result.mantissa == expected.mantissa && result.exponent == expected.exponent && status == expectedStatus;
+}
+
+auto checkDiv(X87Float80 a, X87Float80 b) -> void {
+	for (const auto precision : kPrecisions) {
+		for (const auto rounding : kRoundingModes) {
+			const uint16_t controlWord = 0x007F | precision | rounding;
+			uint16_t status = 0;
+			uint16_t expectedStatus = 0;
+			const auto result = doubleDouble80Div(a, b, controlWord, &status);
+			const auto expected = softFloat80Div(a, b, controlWord, &expectedStatus);
+			if (!same(result, status, expected, expectedStatus) && failures++ < 20) {
+				std::printf("div %04x:%016llx / %04x:%016llx cw %04x: %04x:%016llx sw %04x, expected %04x:%016llx sw %04x\n", a.exponent,
+				            static_cast<unsigned long long>(a.mantissa), b.exponent, static_cast<unsigned long long>(b.mantissa), controlWord, result.exponent,
+				            static_cast<unsigned long long>(result.mantissa), status, expected.exponent, static_cast<unsigned long long>(expected.mantissa), expectedStatus);
+			}
+		}
+	}
+}
+
+auto checkSqrt(X87Float80 a) -> void {
+	for (const auto precision : kPrecisions) {
+		for (const auto rounding : kRoundingModes) {
+			const uint16_t controlWord = 0x007F | precision | rounding;
+			uint16_t status = 0;
+			uint16_t expectedStatus = 0;
+			const auto result = doubleDouble80Sqrt(a, controlWord, &status);
+			const auto expected = softFloat80Sqrt(a, controlWord, &expectedStatus);
+			if (!same(result, status, expected, expectedStatus) && failures++ < 20) {
+				std::printf("sqrt %04x:%016llx cw %04x: %04x:%016llx sw %04x, expected %04x:%016llx sw %04x\n", a.exponent, static_cast<unsigned long long>(a.mantissa),
+				            controlWord, result.exponent, static_cast<unsigned long long>(result.mantissa), status, expected.exponent,
+				            static_cast<unsigned long long>(expected.mantissa), expectedStatus);
+			}
+		}
+	}
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	std::mt19937_64 rng(0x87);
+
+	for (size_t i = 0; i < iterations && failures < 20; i++) {
+		const auto b = randomFloat80(rng, 200);
+		checkDiv(randomFloat80(rng, 200), b);
+
+		// a quotient of 32 bit significands
+		const uint64_t quotient = (rng() >> 32) | 0x80000000ULL;
+		const uint64_t divisor = (rng() >> 32) | 0x80000000ULL;
+		checkDiv(normalized(static_cast<unsigned __int128>(quotient) * divisor, kFloat80Bias + 40), X87Float80{.mantissa = divisor << 32, .exponent = b.exponent});
+
+		// a quotient next to the midpoint between two 64 bit significands
+		const uint64_t below = rng() | kFloat80IntegerBit;
+		const auto product = static_cast<unsigned __int128>(below) * b.mantissa + (b.mantissa >> 1);
+		const auto shift = (product >> 127) != 0 ? 64 : 63;
+		const auto dividend = static_cast<uint64_t>(product >> shift) + static_cast<uint64_t>(rng() % 5) - 2;
+		checkDiv(X87Float80{.mantissa = dividend | kFloat80IntegerBit, .exponent = static_cast<uint16_t>(kFloat80Bias - 40)}, b);
+
+		checkSqrt(X87Float80{.mantissa = b.mantissa, .exponent = static_cast<uint16_t>(b.exponent & 0x7FFF)});
+
+		// the square of a 32 bit significand, with both exponent parities
+		const uint64_t root = (rng() >> 32) | 0x80000000ULL;
+		checkSqrt(normalized(static_cast<unsigned __int128>(root) * root, kFloat80Bias + 2 * static_cast<int32_t>(rng() % 40) - 40 + static_cast<int32_t>(rng() & 1)));
+	}
+
+	if (failures != 0) {
+		std::printf("%zu results differ\n", failures);
+		return 1;
+	}
+	std::printf("all results match\n");
+	return 0;
+}
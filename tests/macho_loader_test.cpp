@@ -0,0 +1,167 @@
+// Host check of the Mach-O loader against the small image in
+// tests/fixtures/runtime.macho.
+//
+//   x87machotest FIXTURE [iterations]
+//
+// The fixture has a __TEXT segment with __text, a __DATA segment with the
+// exports and imports sections and a zerofill __bss, an LC_UUID and an empty
+// __LINKEDIT. Opens it, checks the segments, sections and image size, then
+// checks that copies with a corrupted header or load command are rejected.
+// Finally times opening the image and looking up its sections. Exits with 1
+// on any failed check.
+
+#include "macho_loader.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+auto check(bool condition, const char *what) -> void {
+	if (!condition) {
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+}
+
+auto readFile(std::filesystem::path const &path) -> std::vector<uint8_t> {
+	std::ifstream file(path, std::ios::binary);
+	return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+auto writeFile(std::filesystem::path const &path, std::vector<uint8_t> const &data) -> void {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+template <typename T>
+auto store(std::vector<uint8_t> &data, size_t offset, T value) -> void {
+	std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+auto checkFixture(MachoLoader const &loader) -> void {
+	check(loader.imageSize() == 0xC000, "the image size is the end of __DATA rounded up to 16 KB pages");
+
+	auto text = loader.getSection("__TEXT", "__text");
+	check(text != nullptr && text->addr == 0x280 && text->size == 0x80, "__TEXT,__text");
+	auto exports = loader.getSection("__DATA", "exports");
+	check(exports != nullptr && exports->addr == 0x4000 && exports->size == 0x40, "__DATA,exports");
+	auto imports = loader.getSection("__DATA", "imports");
+	check(imports != nullptr && imports->addr == 0x4040 && imports->size == 0x40, "__DATA,imports");
+	auto bss = loader.getSection("__DATA", "__bss");
+	check(bss != nullptr && bss->size == 0x4080, "__DATA,__bss");
+	check(loader.getSection("__DATA", "__text") == nullptr, "sections are looked up in their own segment");
+	check(loader.getSection("__LINKEDIT", "exports") == nullptr, "missing sections are not found");
+
+	std::vector<std::string> names;
+	loader.forEachSegment([&](macho::segment_command_64 const *segm) {
+		names.emplace_back(segm->segname, strnlen(segm->segname, sizeof(segm->segname)));
+		if (names.back() == "__DATA") {
+			// the fixture fills __DATA with its own offsets
+			auto data = loader.segmentData(segm);
+			check(segm->filesize == 0x80 && data[0] == 0x00 && data[0x41] == 0x41 && data[0x7F] == 0x7F, "__DATA contents");
+		}
+	});
+	check(names == std::vector<std::string>{"__TEXT", "__DATA"}, "segments without sections are skipped");
+}
+
+// Every copy of the fixture with one field corrupted must fail to open.
+auto checkCorrupted(std::vector<uint8_t> const &fixture, MachoLoader const &loader, std::filesystem::path const &path) -> void {
+	const auto header = reinterpret_cast<uint8_t const *>(loader.machHeader());
+	size_t dataSegment = 0;
+	loader.forEachSegment([&](macho::segment_command_64 const *segm) {
+		if (std::strcmp(segm->segname, "__DATA") == 0) {
+			dataSegment = reinterpret_cast<uint8_t const *>(segm) - header;
+		}
+	});
+	check(dataSegment != 0, "__DATA is found");
+
+	struct Corruption {
+		const char *name;
+		size_t offset;
+		uint32_t value;
+	};
+	const Corruption corruptions[] = {
+		{"bad magic", offsetof(macho::mach_header_64, magic), 0xFEEDFACE},
+		{"load commands larger than the file", offsetof(macho::mach_header_64, sizeofcmds), 0x1000},
+		{"more load commands than fit", offsetof(macho::mach_header_64, ncmds), 5},
+		{"empty load command", sizeof(macho::mach_header_64) + offsetof(macho::load_command, cmdsize), 0},
+		{"segment contents past the end of the file", dataSegment + offsetof(macho::segment_command_64, filesize), 0x81},
+		{"segment offset past the end of the file", dataSegment + offsetof(macho::segment_command_64, fileoff), 0x381},
+		{"more sections than the command holds", dataSegment + offsetof(macho::segment_command_64, nsects), 4},
+	};
+
+	for (const auto &corruption : corruptions) {
+		auto data = fixture;
+		store(data, corruption.offset, corruption.value);
+		writeFile(path, data);
+		MachoLoader corrupted;
+		if (corrupted.open(path)) {
+			std::printf("failed: %s is accepted\n", corruption.name);
+			failures++;
+		}
+	}
+
+	writeFile(path, std::vector<uint8_t>(fixture.begin(), fixture.begin() + 16));
+	MachoLoader truncated;
+	check(!truncated.open(path), "a truncated header is rejected");
+
+	writeFile(path, {});
+	MachoLoader empty;
+	check(!empty.open(path), "an empty file is rejected");
+
+	std::filesystem::remove(path);
+	MachoLoader missing;
+	check(!missing.open(path), "a missing file is rejected");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s FIXTURE [iterations]\n", argv[0]);
+		return 2;
+	}
+	const std::filesystem::path fixturePath = argv[1];
+	const size_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+
+	MachoLoader loader;
+	if (!loader.open(fixturePath)) {
+		std::printf("failed: %s does not open\n", fixturePath.c_str());
+		return 1;
+	}
+	checkFixture(loader);
+
+	const auto corruptedPath = std::filesystem::temp_directory_path() / ("x87machotest." + std::to_string(getpid()));
+	checkCorrupted(readFile(fixturePath), loader, corruptedPath);
+
+	// opening maps the file and indexes the load commands once, the lookups
+	// only walk the indexed segments
+	const auto start = std::chrono::steady_clock::now();
+	size_t found = 0;
+	for (size_t i = 0; i < iterations; i++) {
+		MachoLoader timed;
+		found += timed.open(fixturePath) && timed.getSection("__DATA", "exports") != nullptr && timed.getSection("__DATA", "imports") != nullptr;
+	}
+	const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	check(found == iterations, "every timed open succeeds");
+	std::printf("open and look up sections: %.0f ns\n", iterations != 0 ? elapsed / iterations : 0.0);
+
+	if (failures != 0) {
+		std::printf("%zu checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,218 @@
+// Host check of the runtime offset search on synthetic binaries.
+//
+//   x87offsettest [megabytes]
+//
+// Checks findSignatures on buffers with signatures at aligned, unaligned,
+// repeated and truncated positions, then runs searchOffsets on files holding
+// unique, repeated and missing signatures, and loadKnownOffsets on files with
+// and without the signatures at the offsets of the known runtimes. The offset
+// cache, kept in a temporary HOME, must only be used while the signatures are
+// still at the cached offsets. Finally
+// times the search over a random buffer of the given size. Exits with 1 on
+// any failed check.
+
+#include "offset_finder.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t failures = 0;
+
+auto check(bool condition, const char *what) -> void {
+	if (!condition) {
+		std::printf("failed: %s\n", what);
+		failures++;
+	}
+}
+
+// Random instruction words that never start a signature.
+auto randomBinary(std::mt19937_64 &rng, size_t size) -> std::vector<unsigned char> {
+	bool firstBytes[256] = {};
+	for (const auto &signature : runtimeSignatures()) {
+		firstBytes[signature.bytes[0]] = true;
+	}
+
+	std::vector<unsigned char> data(size);
+	for (auto &byte : data) {
+		byte = static_cast<unsigned char>(rng());
+	}
+	for (size_t offset = 0; offset < size; offset += 4) {
+		while (firstBytes[data[offset]]) {
+			data[offset] = static_cast<unsigned char>(rng());
+		}
+	}
+	return data;
+}
+
+auto place(std::vector<unsigned char> &data, size_t offset, Signature const &signature) -> void {
+	std::memcpy(data.data() + offset, signature.bytes.data(), signature.bytes.size());
+}
+
+auto checkFind(std::mt19937_64 &rng) -> void {
+	const std::vector<Signature> signatures = {
+		{ "short", { 0x11, 0x22, 0x33, 0x44 } },
+		{ "long", { 0x11, 0x22, 0x33, 0x55, 0x66, 0x77, 0x88, 0x99 } },
+	};
+
+	auto data = randomBinary(rng, 4096);
+	for (auto &byte : data) {
+		// keep 0x11 out of the background, randomBinary only knows the runtime signatures
+		byte = byte == 0x11 ? 0x12 : byte;
+	}
+	place(data, 0x100, signatures[0]);
+	place(data, 0x40, signatures[0]);
+	place(data, 0x201, signatures[0]);
+	place(data, 0x300, signatures[1]);
+	// only the first half of the long signature fits
+	std::memcpy(data.data() + data.size() - 4, signatures[1].bytes.data(), 4);
+
+	auto matches = findSignatures(data.data(), data.size(), signatures);
+	check(matches[0] == std::vector<std::uint64_t>{ 0x40, 0x100 }, "repeated matches are reported in order, unaligned ones are skipped");
+	check(matches[1] == std::vector<std::uint64_t>{ 0x300 }, "a signature running past the end is not matched");
+
+	matches = findSignatures(data.data(), 0, signatures);
+	check(matches.size() == 2 && matches[0].empty() && matches[1].empty(), "an empty binary has no matches");
+}
+
+using Lookup = auto (OffsetFinder::*)(int fd, std::uint64_t size) -> bool;
+
+auto search(std::vector<unsigned char> const &data, OffsetFinder &finder, Lookup lookup = &OffsetFinder::searchOffsets) -> bool {
+	const auto path = std::filesystem::temp_directory_path() / ("x87offsettest." + std::to_string(getpid()));
+	auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0 || write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+		std::printf("failed: cannot write %s\n", path.c_str());
+		std::exit(1);
+	}
+	const auto found = (finder.*lookup)(fd, data.size());
+	close(fd);
+	std::filesystem::remove(path);
+	return found;
+}
+
+auto checkSearch(std::mt19937_64 &rng) -> void {
+	const auto &signatures = runtimeSignatures();
+	const auto background = randomBinary(rng, 0x10000);
+	OffsetFinder finder = {};
+
+	auto data = background;
+	place(data, 0xFA8C, signatures[0]);
+	place(data, 0x1998, signatures[1]);
+	check(search(data, finder) && finder.offsetExportsFetch_ == 0xFA8C && finder.offsetSvcCallEntry_ == 0x1998 && finder.offsetSvcCallRet_ == 0x19A4, "unique signatures give their offsets");
+
+	// the ambiguity is only warned about
+	place(data, 0x8000, signatures[1]);
+	place(data, 0x4000, signatures[0]);
+	finder = {};
+	check(search(data, finder) && finder.offsetExportsFetch_ == 0x4000 && finder.offsetSvcCallEntry_ == 0x1998, "ambiguous signatures use the first match");
+
+	data = background;
+	place(data, 0x1998, signatures[1]);
+	check(!search(data, finder), "a missing signature fails the search");
+}
+
+// The table starts with the macOS 26.0 runtime, at any size.
+auto checkKnown(std::mt19937_64 &rng) -> void {
+	const auto &signatures = runtimeSignatures();
+	const auto background = randomBinary(rng, 0x10000);
+	OffsetFinder finder = {};
+
+	auto data = background;
+	place(data, 0xFA8C, signatures[0]);
+	place(data, 0x1998, signatures[1]);
+	check(search(data, finder, &OffsetFinder::loadKnownOffsets) && finder.offsetExportsFetch_ == 0xFA8C && finder.offsetSvcCallEntry_ == 0x1998 &&
+	          finder.offsetSvcCallRet_ == 0x19A4,
+	      "a known runtime gives its offsets");
+
+	data = background;
+	place(data, 0xFA90, signatures[0]);
+	place(data, 0x1998, signatures[1]);
+	check(!search(data, finder, &OffsetFinder::loadKnownOffsets), "a runtime with a signature elsewhere is not known");
+
+	place(data, 0xFA8C, signatures[0]);
+	data.resize(0xFA90);
+	check(!search(data, finder, &OffsetFinder::loadKnownOffsets), "a runtime ending before a signature is not known");
+}
+
+// Loads the cache for a file holding data, with the identity it was stored for.
+auto loadCached(std::vector<unsigned char> const &data, OffsetFinder &finder, RuntimeIdentity const &identity) -> bool {
+	const auto path = std::filesystem::temp_directory_path() / ("x87offsettest." + std::to_string(getpid()));
+	auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0 || write(fd, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+		std::printf("failed: cannot write %s\n", path.c_str());
+		std::exit(1);
+	}
+	const auto found = finder.loadCachedOffsets(fd, identity);
+	close(fd);
+	std::filesystem::remove(path);
+	return found;
+}
+
+auto checkCache(std::mt19937_64 &rng) -> void {
+	const auto home = std::filesystem::temp_directory_path() / ("x87offsettest.home." + std::to_string(getpid()));
+	std::filesystem::create_directories(home / "Library" / "Caches");
+	setenv("HOME", home.c_str(), 1);
+
+	const auto &signatures = runtimeSignatures();
+	auto data = randomBinary(rng, 0x10000);
+	place(data, 0x4000, signatures[0]);
+	place(data, 0x2000, signatures[1]);
+	const RuntimeIdentity identity = { .size = data.size(), .mtimeSeconds = 1, .mtimeNanoseconds = 2, .hash = 3 };
+
+	OffsetFinder stored = {};
+	check(search(data, stored), "the runtime is searched");
+	stored.storeCachedOffsets(identity);
+
+	OffsetFinder finder = {};
+	check(loadCached(data, finder, identity) && finder.offsetExportsFetch_ == 0x4000 && finder.offsetSvcCallEntry_ == 0x2000 && finder.offsetSvcCallRet_ == 0x200C,
+	      "cached offsets are used for the same runtime");
+	check(!loadCached(data, finder, RuntimeIdentity{ .size = data.size(), .mtimeSeconds = 1, .mtimeNanoseconds = 2, .hash = 4 }), "another identity misses the cache");
+
+	// the same identity, but the code moved
+	auto moved = randomBinary(rng, 0x10000);
+	place(moved, 0x4100, signatures[0]);
+	place(moved, 0x2000, signatures[1]);
+	check(!loadCached(moved, finder, identity), "cached offsets without their signatures miss the cache");
+
+	std::filesystem::remove_all(home);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t megabytes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16;
+	std::mt19937_64 rng(0x87);
+
+	checkFind(rng);
+	checkSearch(rng);
+	checkKnown(rng);
+	checkCache(rng);
+
+	// random words pass the first byte table at one in 128 offsets, the
+	// runtime itself is about 1 MB
+	std::vector<unsigned char> data(megabytes << 20);
+	for (auto &byte : data) {
+		byte = static_cast<unsigned char>(rng());
+	}
+	const auto start = std::chrono::steady_clock::now();
+	const auto matches = findSignatures(data.data(), data.size(), runtimeSignatures());
+	const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	check(matches.size() == 2, "every signature is searched");
+	std::printf("search %zu MB: %.2f ms\n", megabytes, elapsed);
+
+	if (failures != 0) {
+		std::printf("%zu checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all checks passed\n");
+	return 0;
+}
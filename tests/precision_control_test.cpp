@@ -0,0 +1,144 @@
+// Host check of the native arithmetic under 24 bit precision control, links
+// against x87core.
+//
+//   x87precisiontest [iterations]
+//
+// Runs fadd, fsub, fsubr, fmul, fdiv, fdivr and fsqrt through the wrappers the
+// dispatch slots use and compares every result bit for bit with the 80 bit
+// soft float engine, which rounds the exact result once to the precision and
+// rounding control of the control word like the x87 does. Operands are chosen
+// so that the results stay normal doubles. Exits with 1 on any difference.
+
+#include "FPRounding.h"
+#include "X87.h"
+#include "X87SoftFloat.h"
+#include "X87State.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+struct Operation {
+	const char *name;
+	void (*handler)(X87State *, uint64_t);
+	X87Float80 (*reference)(X87Float80, X87Float80, uint16_t, uint16_t *);
+};
+
+auto reverseSub(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	return softFloat80Sub(b, a, controlWord, statusWord);
+}
+
+auto reverseDiv(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	return softFloat80Div(b, a, controlWord, statusWord);
+}
+
+auto sqrtOperand(X87Float80 a, X87Float80, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	return softFloat80Sqrt(a, controlWord, statusWord);
+}
+
+auto sqrtHandler(X87State *state, uint64_t) -> void {
+	fpEnvironmentHandler<X87HandlerId::x87_fsqrt, &x87_fsqrt_fast>()(state);
+}
+
+const Operation kOperations[] = {
+	{"fadd", fpEnvironmentHandler<X87HandlerId::x87_fadd_f64, &x87_fadd_f64_fast>(), softFloat80Add},
+	{"fsub", fpEnvironmentHandler<X87HandlerId::x87_fsub_f64, &x87_fsub_f64_fast>(), softFloat80Sub},
+	{"fsubr", fpEnvironmentHandler<X87HandlerId::x87_fsubr_f64, &x87_fsubr_f64_fast>(), reverseSub},
+	{"fmul", fpEnvironmentHandler<X87HandlerId::x87_fmul_f64, &x87_fmul_f64_fast>(), softFloat80Mul},
+	{"fdiv", fpEnvironmentHandler<X87HandlerId::x87_fdiv_f64, &x87_fdiv_f64_fast>(), softFloat80Div},
+	{"fdivr", fpEnvironmentHandler<X87HandlerId::x87_fdivr_f64, &x87_fdivr_f64_fast>(), reverseDiv},
+	{"fsqrt", sqrtHandler, sqrtOperand},
+};
+
+// The rounding modes the native handlers honor.
+#if defined(X87_ROUNDING_CONTROL)
+constexpr uint16_t kRoundingModes[] = {X87ControlWord::kRoundToNearest, X87ControlWord::kRoundDown, X87ControlWord::kRoundUp, X87ControlWord::kRoundToZero};
+#else
+constexpr uint16_t kRoundingModes[] = {X87ControlWord::kRoundToNearest};
+#endif
+
+auto roundingName(uint16_t rounding) -> const char * {
+	switch (rounding) {
+	case X87ControlWord::kRoundToNearest:
+		return "nearest";
+	case X87ControlWord::kRoundDown:
+		return "down";
+	case X87ControlWord::kRoundUp:
+		return "up";
+	default:
+		return "zero";
+	}
+}
+
+// Doubles with a random sign and significand and an exponent in
+// [-range, range], with a run of trailing zero or one bits now and then so
+// that ties and carries come up.
+auto randomDouble(std::mt19937_64 &rng, int range) -> double {
+	auto mantissa = rng() & 0x000FFFFFFFFFFFFFULL;
+	switch (rng() & 3) {
+	case 0:
+		mantissa &= ~((1ULL << (rng() % 52)) - 1);
+		break;
+	case 1:
+		mantissa |= (1ULL << (rng() % 52)) - 1;
+		break;
+	}
+	const auto exponent = static_cast<uint64_t>(1023 + static_cast<int>(rng() % (2 * range + 1)) - range);
+	return std::bit_cast<double>((rng() & 0x8000000000000000ULL) | (exponent << 52) | mantissa);
+}
+
+auto run(const Operation &operation, uint16_t rounding, double a, double b) -> bool {
+	const uint16_t controlWord = 0x007F | X87ControlWord::kPrecision24Bit | rounding;
+
+	X87State state;
+	state.controlWord = controlWord;
+	state.push();
+	state.setStFast(0, a);
+	operation.handler(&state, std::bit_cast<uint64_t>(b));
+	const double result = state.getStFast(0);
+
+	uint16_t statusWord = 0;
+	const auto exact = operation.reference(ConvertFloat64ToX87Register(a, nullptr), ConvertFloat64ToX87Register(b, nullptr), controlWord, &statusWord);
+	const double expected = ConvertX87RegisterToFloat64(exact, nullptr);
+
+	if (std::bit_cast<uint64_t>(result) == std::bit_cast<uint64_t>(expected)) {
+		return true;
+	}
+	std::printf("%s %s: %a, %a = %a, expected %a\n", operation.name, roundingName(rounding), a, b, result, expected);
+	return false;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	std::mt19937_64 rng(0x87);
+	size_t failures = 0;
+
+	for (const auto &operation : kOperations) {
+		for (const auto rounding : kRoundingModes) {
+			// a result just above a tie, which rounds to the tie when rounding
+			// to double first, and one between two single precision values
+			failures += !run(operation, rounding, 1.0, 0x1p-24 * (1 + 0x1p-52));
+			failures += !run(operation, rounding, 1.0, 0.75 * 0x1p-23);
+
+			for (size_t i = 0; i < iterations && failures < 20; i++) {
+				const double a = randomDouble(rng, 100);
+				// operands of close magnitude cancel and carry in fadd and fsub
+				const double b = std::ldexp(randomDouble(rng, 0), std::ilogb(a) - static_cast<int>(rng() % 64));
+				failures += !run(operation, rounding, operation.reference == sqrtOperand ? std::fabs(a) : a, b);
+			}
+		}
+	}
+
+	if (failures != 0) {
+		std::printf("%zu results differ\n", failures);
+		return 1;
+	}
+	std::printf("all results match\n");
+	return 0;
+}
@@ -0,0 +1,149 @@
+// Host check of the batch register file conversions used for state import and
+// export, links against x87core.
+//
+//   x87registertest [iterations]
+//
+// Converts register files with ConvertFloat64ToX87Registers and
+// ConvertX87RegistersToFloat64 and compares every register bit for bit with
+// the scalar ConvertFloat64ToX87Register and ConvertX87RegisterToFloat64. The
+// edge cases cover every biased exponent of both formats with the mantissas
+// around the lane masks: zeros, denormals, unnormals, infinities and NaNs,
+// ties and the rounding carries into the exponent and to infinity. Random
+// values follow. Every file is converted at each top of stack, packed and with
+// the 16 byte stride of the fxsave area. Exits with 1 on any difference.
+
+#include "X87State.h"
+
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct StrideRegister {
+	X87Float80 value;
+	uint8_t padding[16];
+};
+
+size_t failures = 0;
+
+auto checkToFloat80(const double (&values)[kRegisterFileSize]) -> void {
+	for (uint32_t first = 0; first < kRegisterFileSize; first++) {
+		X87Float80 packed[kRegisterFileSize];
+		StrideRegister strided[kRegisterFileSize];
+		ConvertFloat64ToX87Registers(values, first, packed, sizeof(packed[0]));
+		ConvertFloat64ToX87Registers(values, first, &strided[0].value, sizeof(strided[0]));
+
+		for (uint32_t i = 0; i < kRegisterFileSize; i++) {
+			const auto value = values[(first + i) & 7];
+			const auto expected = ConvertFloat64ToX87Register(value, nullptr);
+			for (const auto &result : {packed[i], strided[i].value}) {
+				if ((result.mantissa != expected.mantissa || result.exponent != expected.exponent) && failures++ < 20) {
+					std::printf("%016llx: %04x:%016llx, expected %04x:%016llx\n", static_cast<unsigned long long>(std::bit_cast<uint64_t>(value)), result.exponent,
+					            static_cast<unsigned long long>(result.mantissa), expected.exponent, static_cast<unsigned long long>(expected.mantissa));
+				}
+			}
+		}
+	}
+}
+
+auto checkToFloat64(const X87Float80 (&registers)[kRegisterFileSize]) -> void {
+	StrideRegister strided[kRegisterFileSize];
+	for (uint32_t i = 0; i < kRegisterFileSize; i++) {
+		strided[i].value = registers[i];
+	}
+
+	for (uint32_t first = 0; first < kRegisterFileSize; first++) {
+		double packed[kRegisterFileSize];
+		double fromStrided[kRegisterFileSize];
+		ConvertX87RegistersToFloat64(registers, sizeof(registers[0]), packed, first);
+		ConvertX87RegistersToFloat64(&strided[0].value, sizeof(strided[0]), fromStrided, first);
+
+		for (uint32_t i = 0; i < kRegisterFileSize; i++) {
+			const auto expected = std::bit_cast<uint64_t>(ConvertX87RegisterToFloat64(registers[i], nullptr));
+			for (const auto result : {std::bit_cast<uint64_t>(packed[(first + i) & 7]), std::bit_cast<uint64_t>(fromStrided[(first + i) & 7])}) {
+				if (result != expected && failures++ < 20) {
+					std::printf("%04x:%016llx: %016llx, expected %016llx\n", registers[i].exponent, static_cast<unsigned long long>(registers[i].mantissa),
+					            static_cast<unsigned long long>(result), static_cast<unsigned long long>(expected));
+				}
+			}
+		}
+	}
+}
+
+// Fills register files from a list of values, eight at a time, so that every
+// file mixes lanes of different kinds.
+template <typename T, typename Check>
+auto checkFiles(const std::vector<T> &values, Check check) -> void {
+	for (size_t offset = 0; offset < values.size(); offset += kRegisterFileSize) {
+		T file[kRegisterFileSize];
+		for (uint32_t i = 0; i < kRegisterFileSize; i++) {
+			file[i] = values[(offset + i) % values.size()];
+		}
+		check(file);
+	}
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	std::mt19937_64 rng(0x87);
+
+	std::vector<double> doubles;
+	const uint64_t doubleMantissas[] = {0, 1, 0x0008000000000000ULL, 0x000FFFFFFFFFFFFFULL, 0x0000000000000400ULL};
+	for (uint64_t biasedExp = 0; biasedExp < 0x800; biasedExp++) {
+		for (const auto mantissa : doubleMantissas) {
+			for (const uint64_t sign : {0ULL, 0x8000000000000000ULL}) {
+				doubles.push_back(std::bit_cast<double>(sign | (biasedExp << 52) | mantissa));
+			}
+		}
+		doubles.push_back(std::bit_cast<double>((biasedExp << 52) | (rng() & 0x800FFFFFFFFFFFFFULL)));
+	}
+	checkFiles(doubles, checkToFloat80);
+
+	std::vector<X87Float80> registers;
+	const uint64_t x87Mantissas[] = {
+		0,
+		0x8000000000000000ULL, // exact
+		0x8000000000000400ULL, // tie, even
+		0x8000000000000C00ULL, // tie, odd
+		0x80000000000003FFULL, // below the tie
+		0x8000000000000401ULL, // above the tie
+		0xFFFFFFFFFFFFFC00ULL, // carries into the exponent
+		0xFFFFFFFFFFFFFFFFULL,
+		0x7FFFFFFFFFFFF800ULL, // unnormal
+		0x0000000000000001ULL,
+		0xC000000000000000ULL, // quiet NaN with the maximum exponent
+	};
+	for (uint32_t biasedExp = 0; biasedExp < 0x8000; biasedExp++) {
+		for (const auto mantissa : x87Mantissas) {
+			for (const uint16_t sign : {0, 0x8000}) {
+				registers.push_back(X87Float80{.mantissa = mantissa, .exponent = static_cast<uint16_t>(sign | biasedExp)});
+			}
+		}
+	}
+	checkFiles(registers, checkToFloat64);
+
+	for (size_t i = 0; i < iterations && failures < 20; i++) {
+		double values[kRegisterFileSize];
+		X87Float80 file[kRegisterFileSize];
+		for (uint32_t lane = 0; lane < kRegisterFileSize; lane++) {
+			values[lane] = std::bit_cast<double>(rng());
+			// mostly exponents in the double range, where the masks apply
+			const auto exponent = static_cast<uint16_t>((rng() & 0x8000) | (rng() & 3 ? 16383 - 1100 + rng() % 2200 : rng() & 0x7FFF));
+			file[lane] = X87Float80{.mantissa = rng() | (rng() & 7 ? 0x8000000000000000ULL : 0), .exponent = exponent};
+		}
+		checkToFloat80(values);
+		checkToFloat64(file);
+	}
+
+	if (failures != 0) {
+		std::printf("%zu conversions differ\n", failures);
+		return 1;
+	}
+	std::printf("all conversions match\n");
+	return 0;
+}
@@ -0,0 +1,204 @@
+// Host check of the 80 bit soft float engine against the x87 of an x86-64
+// host, links against x87core.
+//
+//   x87softfloattest [iterations]
+//
+// Runs softFloat80Add, Sub, Mul, Div, Sqrt and Compare and the matching x87
+// instructions on the same operands in every precision and rounding control,
+// with every exception masked, and compares the results bit for bit together
+// with the IE, DE, ZE, OE, UE and PE flags and C1, or the condition codes of
+// the compares. Operands are normal values with short and full significands,
+// values near the overflow and underflow thresholds, denormals, zeros,
+// infinities, quiet and signaling NaNs and unnormals. Exits with 1 on any
+// difference.
+
+#include "X87SoftFloat.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+constexpr uint16_t kPrecisions[] = {X87ControlWord::kPrecision24Bit, X87ControlWord::kPrecision53Bit, X87ControlWord::kPrecision64Bit};
+constexpr uint16_t kRoundingModes[] = {X87ControlWord::kRoundToNearest, X87ControlWord::kRoundDown, X87ControlWord::kRoundUp, X87ControlWord::kRoundToZero};
+
+// The exception flags and C1, the stack fault and the top are not compared.
+constexpr uint16_t kArithmeticFlags = 0x003F | X87StatusWordFlag::kConditionCode1;
+constexpr uint16_t kCompareFlags = X87StatusWordFlag::kInvalidOperation | X87StatusWordFlag::kDenormalizedOperand | X87StatusWordFlag::kConditionCode0 |
+                                   X87StatusWordFlag::kConditionCode2 | X87StatusWordFlag::kConditionCode3;
+
+// The x87 computes ST(0) = a op b. Every call starts from an initialized FPU
+// and leaves it initialized, the host code itself uses SSE.
+#define X87_HARDWARE_BINARY(NAME, INSTRUCTION)                                                                          \
+	auto NAME(X87Float80 a, X87Float80 b, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {                     \
+		X87Float80 result = {};                                                                                          \
+		asm volatile("fninit\n\t"                                                                                        \
+		             "fldcw %[cw]\n\t"                                                                                   \
+		             "fldt %[b]\n\t"                                                                                     \
+		             "fldt %[a]\n\t" INSTRUCTION "\n\t"                                                                  \
+		             "fnstsw %[sw]\n\t"                                                                                  \
+		             "fstpt %[result]\n\t"                                                                               \
+		             "fninit"                                                                                            \
+		             : [result] "=m"(result), [sw] "=m"(*statusWord)                                                      \
+		             : [a] "m"(a), [b] "m"(b), [cw] "m"(controlWord));                                                   \
+		return result;                                                                                                   \
+	}
+
+X87_HARDWARE_BINARY(hardwareAdd, "fadd %%st(1), %%st")
+X87_HARDWARE_BINARY(hardwareSub, "fsub %%st(1), %%st")
+X87_HARDWARE_BINARY(hardwareMul, "fmul %%st(1), %%st")
+X87_HARDWARE_BINARY(hardwareDiv, "fdiv %%st(1), %%st")
+X87_HARDWARE_BINARY(hardwareCompare, "fcom %%st(1)")
+X87_HARDWARE_BINARY(hardwareCompareQuiet, "fucom %%st(1)")
+
+#undef X87_HARDWARE_BINARY
+
+auto hardwareSqrt(X87Float80 a, X87Float80, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	X87Float80 result = {};
+	asm volatile("fninit\n\t"
+	             "fldcw %[cw]\n\t"
+	             "fldt %[a]\n\t"
+	             "fsqrt\n\t"
+	             "fnstsw %[sw]\n\t"
+	             "fstpt %[result]\n\t"
+	             "fninit"
+	             : [result] "=m"(result), [sw] "=m"(*statusWord)
+	             : [a] "m"(a), [cw] "m"(controlWord));
+	return result;
+}
+
+auto softSqrt(X87Float80 a, X87Float80, uint16_t controlWord, uint16_t *statusWord) -> X87Float80 {
+	return softFloat80Sqrt(a, controlWord, statusWord);
+}
+
+using Operation = auto (*)(X87Float80, X87Float80, uint16_t, uint16_t *) -> X87Float80;
+
+struct Arithmetic {
+	const char *name;
+	Operation soft;
+	Operation hardware;
+};
+
+const Arithmetic kArithmetic[] = {
+	{"add", softFloat80Add, hardwareAdd},
+	{"sub", softFloat80Sub, hardwareSub},
+	{"mul", softFloat80Mul, hardwareMul},
+	{"div", softFloat80Div, hardwareDiv},
+	{"sqrt", softSqrt, hardwareSqrt},
+};
+
+size_t failures = 0;
+
+auto report(const char *name, X87Float80 a, X87Float80 b, uint16_t controlWord, X87Float80 result, uint16_t status, X87Float80 expected, uint16_t expectedStatus) -> void {
+	if (failures++ < 20) {
+		std::printf("%s %04x:%016llx, %04x:%016llx cw %04x: %04x:%016llx sw %04x, x87 %04x:%016llx sw %04x\n", name, a.exponent,
+		            static_cast<unsigned long long>(a.mantissa), b.exponent, static_cast<unsigned long long>(b.mantissa), controlWord, result.exponent,
+		            static_cast<unsigned long long>(result.mantissa), status, expected.exponent, static_cast<unsigned long long>(expected.mantissa), expectedStatus);
+	}
+}
+
+auto check(X87Float80 a, X87Float80 b) -> void {
+	for (const auto precision : kPrecisions) {
+		for (const auto rounding : kRoundingModes) {
+			const uint16_t controlWord = 0x007F | precision | rounding;
+			for (const auto &operation : kArithmetic) {
+				uint16_t status = 0;
+				uint16_t expectedStatus = 0;
+				const auto result = operation.soft(a, b, controlWord, &status);
+				const auto expected = operation.hardware(a, b, controlWord, &expectedStatus);
+				if (result.mantissa != expected.mantissa || result.exponent != expected.exponent || (status & kArithmeticFlags) != (expectedStatus & kArithmeticFlags)) {
+					report(operation.name, a, b, controlWord, result, status & kArithmeticFlags, expected, expectedStatus & kArithmeticFlags);
+				}
+			}
+		}
+	}
+
+	for (const bool quiet : {false, true}) {
+		uint16_t status = 0;
+		switch (softFloat80Compare(a, b, quiet, &status)) {
+		case SoftFloat80Order::kLess:
+			status |= X87StatusWordFlag::kConditionCode0;
+			break;
+		case SoftFloat80Order::kEqual:
+			status |= X87StatusWordFlag::kConditionCode3;
+			break;
+		case SoftFloat80Order::kGreater:
+			break;
+		case SoftFloat80Order::kUnordered:
+			status |= X87StatusWordFlag::kConditionCode0 | X87StatusWordFlag::kConditionCode2 | X87StatusWordFlag::kConditionCode3;
+			break;
+		}
+		uint16_t expectedStatus = 0;
+		(quiet ? hardwareCompareQuiet : hardwareCompare)(a, b, 0x037F, &expectedStatus);
+		if ((status & kCompareFlags) != (expectedStatus & kCompareFlags)) {
+			report(quiet ? "fucom" : "fcom", a, b, 0x037F, {}, status & kCompareFlags, {}, expectedStatus & kCompareFlags);
+		}
+	}
+}
+
+// Operands of every class. Significands are often short, so that results are
+// exact or land on ties, and exponents often sit near the ends of the range
+// or of the double and single ranges the precision control does not limit.
+auto randomFloat80(std::mt19937_64 &rng) -> X87Float80 {
+	const auto sign = static_cast<uint16_t>((rng() & 1) << 15);
+	auto mantissa = rng() | kFloat80IntegerBit;
+	if ((rng() & 3) == 0) {
+		mantissa &= ~((1ULL << (rng() % 63)) - 1);
+	}
+
+	int32_t exponent;
+	switch (rng() % 16) {
+	case 0:
+		// overflow
+		exponent = kFloat80MaxExponent - 1 - static_cast<int32_t>(rng() % 4);
+		break;
+	case 1:
+		// underflow, products and quotients of these reach the denormals
+		exponent = 1 + static_cast<int32_t>(rng() % 70);
+		break;
+	case 2:
+		return X87Float80{.mantissa = mantissa & ~kFloat80IntegerBit, .exponent = sign}; // denormal or zero
+	case 3:
+		return X87Float80{.mantissa = 0, .exponent = sign};
+	case 4:
+		return X87Float80{.mantissa = kFloat80IntegerBit, .exponent = static_cast<uint16_t>(sign | kFloat80MaxExponent)};
+	case 5:
+		// quiet or signaling NaN
+		return X87Float80{.mantissa = (mantissa & ~kFloat80QuietBit) | (rng() & kFloat80QuietBit) | 1, .exponent = static_cast<uint16_t>(sign | kFloat80MaxExponent)};
+	case 6:
+		// unnormal
+		return X87Float80{.mantissa = mantissa & ~kFloat80IntegerBit, .exponent = static_cast<uint16_t>(sign | (kFloat80Bias + static_cast<int32_t>(rng() % 64) - 32))};
+	case 7:
+		// around the end of the double and single exponent ranges
+		exponent = kFloat80Bias + ((rng() & 1) != 0 ? 1 : -1) * static_cast<int32_t>((rng() & 1) != 0 ? 1022 + rng() % 60 : 126 + rng() % 30);
+		break;
+	default:
+		exponent = kFloat80Bias + static_cast<int32_t>(rng() % 129) - 64;
+		break;
+	}
+	return X87Float80{.mantissa = mantissa, .exponent = static_cast<uint16_t>(sign | exponent)};
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+	std::mt19937_64 rng(0x87);
+
+	for (size_t i = 0; i < iterations && failures < 20; i++) {
+		const auto a = randomFloat80(rng);
+		check(a, randomFloat80(rng));
+		// close operands cancel in add and sub
+		auto b = a;
+		b.mantissa ^= rng() & ((1ULL << (rng() % 64)) - 1);
+		check(a, b);
+	}
+
+	if (failures != 0) {
+		std::printf("%zu results differ\n", failures);
+		return 1;
+	}
+	std::printf("all results match\n");
+	return 0;
+}
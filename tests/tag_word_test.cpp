@@ -0,0 +1,151 @@
+// Host check of the tag word the native arithmetic handlers leave behind,
+// links against x87core.
+//
+//   x87tagtest
+//
+// Runs fadd, fsub, fsubr, fmul, fdiv and fdivr in their register, f32, f64
+// and integer forms through the wrappers the dispatch slots use, on operands
+// whose results are zeros, infinities, NaNs, denormals and normal values. The
+// tag of the destination must classify the register as stored, or be valid
+// with lazy tags, and the tags of the other registers must not change. Exits
+// with 1 on any difference.
+
+#include "FPRounding.h"
+#include "X87.h"
+#include "X87State.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace {
+
+using RegisterHandler = void (*)(X87State *, uint32_t, uint32_t, bool);
+using Float32Handler = void (*)(X87State *, uint32_t);
+using Float64Handler = void (*)(X87State *, uint64_t);
+using IntegerHandler = void (*)(X87State *, int32_t);
+
+struct Operation {
+	const char *name;
+	RegisterHandler registers;
+	Float32Handler float32;
+	Float64Handler float64;
+	IntegerHandler integer;
+};
+
+#define X87_TAG_OPERATION(NAME, INTEGER)                                                          \
+	{                                                                                         \
+		#NAME, fpEnvironmentHandler<X87HandlerId::x87_##NAME##_ST, &x87_##NAME##_ST_fast>(),   \
+			fpEnvironmentHandler<X87HandlerId::x87_##NAME##_f32, &x87_##NAME##_f32_fast>(), \
+			fpEnvironmentHandler<X87HandlerId::x87_##NAME##_f64, &x87_##NAME##_f64_fast>(), \
+			fpEnvironmentHandler<X87HandlerId::x87_##INTEGER, &x87_##INTEGER##_fast>()      \
+	}
+
+const Operation kOperations[] = {
+	X87_TAG_OPERATION(fadd, fiadd),
+	X87_TAG_OPERATION(fsub, fisub),
+	X87_TAG_OPERATION(fsubr, fisubr),
+	X87_TAG_OPERATION(fmul, fimul),
+	X87_TAG_OPERATION(fdiv, fidiv),
+	X87_TAG_OPERATION(fdivr, fidivr),
+};
+
+#undef X87_TAG_OPERATION
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+const double kDoubles[] = {0.0, -0.0, 1.0, 3.0, -0.5, kInfinity, -kInfinity, kNaN, 0x1p-1000, 0x1p-1070, 0x1p-1022, 0x1p1000, 1e308};
+const float kFloats[] = {0.0f, -0.0f, 1.0f, 3.0f, -0.5f, std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(), 0x1p-149f, 0x1p100f};
+const int32_t kIntegers[] = {0, 1, 3, -7, std::numeric_limits<int32_t>::min()};
+
+size_t failures = 0;
+size_t seen[4] = {};
+
+auto registerTag(const X87State &state, uint32_t regIdx) -> int {
+	return (state.tagWord >> (regIdx * 2)) & 3;
+}
+
+// ST(0) = a and ST(1) = b, the other registers empty.
+auto makeState(double a, double b) -> X87State {
+	X87State state;
+	state.controlWord = 0x037F;
+	state.push();
+	state.setStFast(0, b);
+	state.push();
+	state.setStFast(0, a);
+	return state;
+}
+
+auto check(const char *name, const X87State &before, const X87State &after, uint32_t stOffset, double a, double b) -> void {
+	const uint32_t regIdx = after.getStIndex(stOffset);
+#if defined(X87_LAZY_TAG_WORD)
+	const auto expected = static_cast<int>(X87TagState::kValid);
+#elif defined(X87_CONVERT_TO_FP80)
+	const auto expected = static_cast<int>(classifyTag(after.st[regIdx]));
+#else
+	const auto expected = static_cast<int>(classifyTag(after.st[regIdx].ieee754));
+#endif
+	const auto tag = registerTag(after, regIdx);
+	seen[tag]++;
+
+	const uint16_t others = ~(3 << (regIdx * 2));
+	if ((tag != expected || (after.tagWord & others) != (before.tagWord & others)) && failures++ < 20) {
+		std::printf("%s %a, %a: tag word %04x, tag of ST(%u) %d, expected %d with the others %04x\n", name, a, b, after.tagWord, stOffset, tag, expected,
+		            before.tagWord & others);
+	}
+}
+
+} // namespace
+
+int main() {
+	for (const auto &operation : kOperations) {
+		for (const auto a : kDoubles) {
+			for (const auto b : kDoubles) {
+				// ST(0) = ST(0) op ST(1) and ST(1) = ST(1) op ST(0)
+				for (const uint32_t destination : {0u, 1u}) {
+					const auto before = makeState(a, b);
+					auto state = before;
+					operation.registers(&state, destination, 1 - destination, false);
+					check(operation.name, before, state, destination, a, b);
+				}
+
+				const auto before = makeState(a, 0);
+				auto state = before;
+				operation.float64(&state, std::bit_cast<uint64_t>(b));
+				check(operation.name, before, state, 0, a, b);
+			}
+
+			for (const auto b : kFloats) {
+				const auto before = makeState(a, 0);
+				auto state = before;
+				operation.float32(&state, std::bit_cast<uint32_t>(b));
+				check(operation.name, before, state, 0, a, b);
+			}
+
+			for (const auto b : kIntegers) {
+				const auto before = makeState(a, 0);
+				auto state = before;
+				operation.integer(&state, b);
+				check(operation.name, before, state, 0, a, b);
+			}
+		}
+	}
+
+#if !defined(X87_LAZY_TAG_WORD)
+	// every classification has to come up for the check to mean anything
+	if (seen[static_cast<int>(X87TagState::kValid)] == 0 || seen[static_cast<int>(X87TagState::kZero)] == 0 ||
+	    seen[static_cast<int>(X87TagState::kSpecial)] == 0) {
+		std::printf("results were not zero, special and valid\n");
+		failures++;
+	}
+#endif
+
+	if (failures != 0) {
+		std::printf("%zu tag words differ\n", failures);
+		return 1;
+	}
+	std::printf("all tag words match\n");
+	return 0;
+}
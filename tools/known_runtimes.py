@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Adds rosetta runtimes to a table of known runtimes the loader looks up.
+
+  known_runtimes.py [--samples] RUNTIME_DIRECTORY KNOWN_RUNTIMES_HPP
+
+Every file in RUNTIME_DIRECTORY is searched for the signatures of
+loader/offset_finder.cpp. Runtimes where every signature matches exactly once
+are merged, by size, into the entries already in KNOWN_RUNTIMES_HPP, which is
+rewritten sorted by size if its entries changed. Run it on
+loader/known_runtimes.hpp to add runtimes to the table checked in. With
+--samples the header defines ROSETTA_KNOWN_RUNTIME_SAMPLES instead, which is
+how the build adds the runtimes of ROSETTA_X87_RUNTIME_SAMPLES without
+touching the source tree.
+"""
+
+import os
+import re
+import sys
+
+# Must match the signatures in runtimeSignatures.
+EXPORTS_FETCH = bytes([0x62, 0x06, 0x40, 0xF9, 0x63, 0x12, 0x40, 0xB9])
+SVC_CALL = bytes([0xB0, 0x18, 0x80, 0xD2, 0x01, 0x10, 0x00, 0xD4, 0xE1, 0x37, 0x9F, 0x9A, 0xC0, 0x03, 0x5F, 0xD6])
+
+ENTRY_RE = re.compile(r"X\((0x[0-9A-Fa-f]+), (0x[0-9A-Fa-f]+), (0x[0-9A-Fa-f]+)\)(?: /\* (.*?) \*/)?")
+
+
+def find_unique(data, signature):
+    """The word aligned offset of the only match of signature, or None."""
+    matches = []
+    offset = data.find(signature)
+    while offset != -1:
+        if offset % 4 == 0:
+            matches.append(offset)
+        offset = data.find(signature, offset + 1)
+    return matches[0] if len(matches) == 1 else None
+
+
+def read_entries(path):
+    """Entries by (size, offsets), with the comment of each."""
+    if not os.path.exists(path):
+        return {}
+    with open(path) as file:
+        return {(int(size, 16), int(exports, 16), int(svc, 16)): comment for size, exports, svc, comment in ENTRY_RE.findall(file.read())}
+
+
+def format_entries(entries, macro):
+    lines = [
+        "#pragma once",
+        "",
+        "// Runtimes the loader knows the offsets of, kept with tools/known_runtimes.py.",
+        "// An entry is used for a runtime of its size, any size for 0, whose",
+        "// signatures lie at its offsets.",
+        "//",
+        "// X(size, exports fetch offset, svc call entry offset)",
+        f"#define {macro}(X)" + (" \\" if entries else ""),
+    ]
+    keys = sorted(entries)
+    for index, key in enumerate(keys):
+        comment = f" /* {entries[key]} */" if entries[key] else ""
+        suffix = " \\" if index + 1 < len(keys) else ""
+        lines.append(f"\tX(0x{key[0]:X}, 0x{key[1]:X}, 0x{key[2]:X}){comment}{suffix}")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    args = sys.argv[1:]
+    samples = "--samples" in args
+    args = [arg for arg in args if arg != "--samples"]
+    if len(args) != 2:
+        sys.exit(__doc__)
+    directory, header = args
+
+    entries = read_entries(header)
+    for name in sorted(os.listdir(directory)):
+        path = os.path.join(directory, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as file:
+            data = file.read()
+
+        exports = find_unique(data, EXPORTS_FETCH)
+        svc = find_unique(data, SVC_CALL)
+        if exports is None or svc is None:
+            print(f"known_runtimes: {path}: signatures missing or ambiguous, skipped", file=sys.stderr)
+            continue
+        entries.setdefault((len(data), exports, svc), "")
+
+    # an unchanged header keeps its timestamp, so nothing is rebuilt
+    text = format_entries(entries, "ROSETTA_KNOWN_RUNTIME_SAMPLES" if samples else "ROSETTA_KNOWN_RUNTIMES")
+    if os.path.exists(header):
+        with open(header) as file:
+            if file.read() == text:
+                return
+    with open(header, "w") as file:
+        file.write(text)
+
+
+if __name__ == "__main__":
+    main()
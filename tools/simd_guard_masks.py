@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""Derives the SIMDGuard register masks from the disassembled runtime.
+
+  simd_guard_masks.py --write OBJDUMP RUNTIME X87_H SIMD_GUARD_MASKS_H
+  simd_guard_masks.py --check OBJDUMP RUNTIME X87_H SIMD_GUARD_MASKS_H
+
+Every handler in X87_HANDLER_LIST is disassembled together with everything it
+calls, and the registers it writes form its clobber set. --write regenerates
+SIMDGuardMasks.h from a runtime built with ROSETTA_X87_SIMD_GUARD_ANALYZE (the
+guards save nothing there, so only the handler bodies are seen). --check runs
+on regular builds and fails when a handler clobbers a register its mask does
+not cover. Masks that were not generated yet (the seed values checked in
+before the first arm64 run) only produce warnings.
+"""
+
+import re
+import subprocess
+import sys
+
+# Every vector register may hold guest state.
+VECTOR_CANDIDATES = (1 << 32) - 1
+
+# The call sites of these handlers additionally keep x0-x7 live. This is what
+# the hand picked SIMDGuardAndX0X7 / SIMDGuardFullAndX0X7 guards covered.
+GPR_CANDIDATES = 0xFF
+GPR_HANDLERS = {
+    "x87_fbstp",
+    "x87_fcos",
+    "x87_fprem",
+    "x87_fprem1",
+    "x87_fptan",
+    "x87_fsin",
+    "x87_fsincos",
+}
+
+NO_DESTINATION = {
+    "b", "bl", "blr", "br", "ret", "cbz", "cbnz", "tbz", "tbnz",
+    "cmp", "cmn", "tst", "fcmp", "fcmpe", "ccmp", "ccmn", "fccmp", "fccmpe",
+    "nop", "prfm", "prfum", "msr", "dmb", "dsb", "isb", "hint", "brk", "udf",
+    "stp", "stnp", "str", "strb", "strh", "stur", "sturb", "sturh", "stlr",
+    "stlrb", "stlrh", "st1", "st2", "st3", "st4",
+}
+
+# loads writing every register of their destination list
+MULTI_DESTINATION = {"ldp", "ldnp", "ldpsw", "ldaxp", "ldxp", "ld1", "ld2", "ld3", "ld4", "ld1r", "ld2r", "ld3r", "ld4r"}
+
+FUNCTION_RE = re.compile(r"^([0-9a-f]+) <(.+)>:$")
+INSTRUCTION_RE = re.compile(r"^\s*[0-9a-f]+:\s+(?:(?:[0-9a-f]{2} ){4}\s*)?([a-z][\w.]*)\s*(.*)$")
+CALL_TARGET_RE = re.compile(r"<([^>+]+)(?:\+0x[0-9a-f]+)?>")
+HANDLER_RE = re.compile(r"X\(([^,]+), (x87_\w+), \(")
+
+GENERATED_MARKER = "// Generated by tools/simd_guard_masks.py"
+
+
+def parse_register(operand):
+    """Returns ("v", n), ("x", n) or None for a single operand."""
+    operand = operand.strip().lstrip("{").rstrip("}").strip()
+    match = re.match(r"^([qdshbv])(\d+)(?:\.\w+)?(?:\[\d+\])?$", operand)
+    if match:
+        return "v", int(match.group(2))
+    match = re.match(r"^([xw])(\d+)$", operand)
+    if match:
+        return "x", int(match.group(2))
+    return None
+
+
+def split_operands(text):
+    # drop trailing comments and call target annotations
+    text = text.split("//")[0].split(";")[0]
+    operands, depth, current = [], 0, ""
+    for char in text:
+        if char in "[{":
+            depth += 1
+        elif char in "]}":
+            depth -= 1
+        if char == "," and depth == 0:
+            operands.append(current.strip())
+            current = ""
+        else:
+            current += char
+    if current.strip():
+        operands.append(current.strip())
+    return operands
+
+
+def instruction_writes(mnemonic, text):
+    """Registers written by one instruction, as a list of ("v"|"x", n)."""
+    operands = split_operands(text)
+    writes = []
+    if mnemonic.startswith("b.") or mnemonic in NO_DESTINATION:
+        pass
+    elif mnemonic in ("stxr", "stlxr", "stxp", "stlxp", "stxrb", "stlxrb", "stxrh", "stlxrh"):
+        writes.append(parse_register(operands[0]))
+    elif mnemonic in MULTI_DESTINATION:
+        for operand in operands:
+            if operand.startswith("["):
+                break
+            if operand.startswith("{"):
+                writes.extend(("v", int(index)) for index in re.findall(r"\bv(\d+)", operand))
+            else:
+                writes.append(parse_register(operand))
+    elif mnemonic == "svc":
+        writes.extend([("x", 0), ("x", 1)])
+    elif operands:
+        writes.append(parse_register(operands[0]))
+
+    # pre/post indexed addressing writes the base register back
+    for index, operand in enumerate(operands):
+        if operand.startswith("[") and (operand.endswith("!") or index + 1 < len(operands)):
+            writes.append(parse_register(operand.strip("[]!").split(",")[0]))
+
+    return [write for write in writes if write is not None]
+
+
+def disassemble(objdump, binary):
+    output = subprocess.run([objdump, "-d", "--no-show-raw-insn", binary], check=True, capture_output=True, text=True).stdout
+
+    functions = {}
+    current = None
+    for line in output.splitlines():
+        match = FUNCTION_RE.match(line)
+        if match:
+            current = {"vector": 0, "gpr": 0, "calls": set(), "indirect": False}
+            functions[match.group(2).lstrip("_")] = current
+            continue
+
+        match = INSTRUCTION_RE.match(line)
+        if current is None or not match:
+            continue
+
+        mnemonic, text = match.group(1), match.group(2)
+        if not mnemonic.startswith("b."):
+            # Apple syntax puts the arrangement on the mnemonic (ld1.2d)
+            mnemonic = mnemonic.split(".")[0]
+        if mnemonic == "bl":
+            target = CALL_TARGET_RE.search(text)
+            if target:
+                current["calls"].add(target.group(1).lstrip("_"))
+            else:
+                current["indirect"] = True
+            continue
+        if mnemonic in ("blr", "blraa", "blraaz", "blrab", "blrabz"):
+            current["indirect"] = True
+            continue
+
+        for kind, index in instruction_writes(mnemonic, text):
+            if kind == "v":
+                current["vector"] |= 1 << index
+            elif index < 32:
+                current["gpr"] |= 1 << index
+
+    return functions
+
+
+def clobbers(functions, name, memo, active):
+    """Vector and general register masks written by name and its callees."""
+    if name in memo:
+        return memo[name]
+    function = functions.get(name)
+    if function is None or function["indirect"]:
+        # unknown code may write anything
+        return VECTOR_CANDIDATES, (1 << 31) - 1
+
+    active.add(name)
+    vector, gpr = function["vector"], function["gpr"]
+    for callee in function["calls"]:
+        if callee in active:
+            continue
+        callee_vector, callee_gpr = clobbers(functions, callee, memo, active)
+        vector |= callee_vector
+        gpr |= callee_gpr
+    active.discard(name)
+
+    memo[name] = vector, gpr
+    return vector, gpr
+
+
+def read_handlers(x87_h):
+    with open(x87_h) as file:
+        text = file.read()
+    body = text[text.index("#define X87_HANDLER_LIST(X)"):]
+    body = body[:body.index("\n\n")]
+    return [(ret.strip(), name) for ret, name in HANDLER_RE.findall(body)]
+
+
+def required_masks(functions, handlers):
+    memo = {}
+    masks = {}
+    for ret, name in handlers:
+        symbol = name + "_fast"
+        if symbol not in functions:
+            sys.exit(f"simd_guard_masks: {symbol} not found in the disassembly")
+        vector, gpr = clobbers(functions, symbol, memo, set())
+        # the exact implementation (FP80 builds) shares the handler's mask
+        if name + "_exact" in functions:
+            exact_vector, exact_gpr = clobbers(functions, name + "_exact", memo, set())
+            vector |= exact_vector
+            gpr |= exact_gpr
+        gpr_candidates = GPR_CANDIDATES if name in GPR_HANDLERS else 0
+        if ret != "void":
+            # return value registers
+            gpr_candidates &= ~0x3
+        masks[name] = vector & VECTOR_CANDIDATES, gpr & gpr_candidates
+    return masks
+
+
+def read_masks(path):
+    with open(path) as file:
+        return {name: (int(vector, 16), int(gpr, 16)) for name, vector, gpr in re.findall(r"X\((x87_\w+), (0x[0-9A-Fa-f]+), (0x[0-9A-Fa-f]+)\)", file.read())}
+
+
+def is_generated(path):
+    with open(path) as file:
+        return GENERATED_MARKER in file.read()
+
+
+def write_masks(path, handlers, masks):
+    lines = [
+        "#pragma once",
+        "",
+        f"{GENERATED_MARKER} from a runtime built with",
+        "// ROSETTA_X87_SIMD_GUARD_ANALYZE, do not edit.",
+        "//",
+        "// X(handler, vector registers q0-q31, general registers x0-x17)",
+        "#define X87_SIMD_GUARD_MASKS(X) \\",
+    ]
+    for index, (_, name) in enumerate(handlers):
+        vector, gpr = masks[name]
+        suffix = " \\" if index + 1 < len(handlers) else ""
+        lines.append(f"\tX({name}, 0x{vector:08X}, 0x{gpr:05X}){suffix}")
+    with open(path, "w") as file:
+        file.write("\n".join(lines) + "\n")
+
+
+def main():
+    if len(sys.argv) != 6 or sys.argv[1] not in ("--write", "--check"):
+        sys.exit(__doc__)
+    mode, objdump, binary, x87_h, masks_h = sys.argv[1:]
+
+    handlers = read_handlers(x87_h)
+    required = required_masks(disassemble(objdump, binary), handlers)
+
+    if mode == "--write":
+        write_masks(masks_h, handlers, required)
+        return
+
+    current = read_masks(masks_h)
+    failed = False
+    for _, name in handlers:
+        vector, gpr = current.get(name, (0, 0))
+        missing_vector = required[name][0] & ~vector
+        missing_gpr = required[name][1] & ~gpr
+        if missing_vector or missing_gpr:
+            registers = [f"q{i}" for i in range(32) if missing_vector >> i & 1] + [f"x{i}" for i in range(32) if missing_gpr >> i & 1]
+            print(f"simd_guard_masks: {name} clobbers unsaved {' '.join(registers)}", file=sys.stderr)
+            failed = True
+
+    if failed and not is_generated(masks_h):
+        print("simd_guard_masks: SIMDGuardMasks.h holds seed values, rebuild with -DROSETTA_X87_SIMD_GUARD_ANALYZE=ON to generate it", file=sys.stderr)
+    elif failed:
+        sys.exit("simd_guard_masks: rebuild with -DROSETTA_X87_SIMD_GUARD_ANALYZE=ON to regenerate SIMDGuardMasks.h")
+
+
+if __name__ == "__main__":
+    main()